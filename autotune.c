@@ -0,0 +1,379 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "autotune.h"
+
+#define PROFILE_VERSION 1
+#define PROFILE_DIR "speaker-compensation-filter"
+#define MIN_BLOCK_SIZE 32
+#define MAX_TUNE_CHANNELS 2
+#define WARMUP_QUANTA 4
+#define MEASURE_QUANTA 8
+#define MEASURE_ROUNDS 3
+
+struct tune_buffers {
+    struct delay_line *delay_lines[MAX_TUNE_CHANNELS];
+    float *outputs[MAX_TUNE_CHANNELS];
+    float *input;
+};
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void cpu_model(char *model, size_t size) {
+    snprintf(model, size, "unknown");
+
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (!file) {
+        return;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char *value = strchr(line, ':');
+        if (value && strncmp(line, "model name", 10) == 0) {
+            value++;
+            while (*value == ' ' || *value == '\t') {
+                value++;
+            }
+            value[strcspn(value, "\n")] = '\0';
+            snprintf(model, size, "%s", value);
+            break;
+        }
+    }
+
+    fclose(file);
+}
+
+static void free_buffers(struct tune_buffers *buffers) {
+    for (int ch = 0; ch < MAX_TUNE_CHANNELS; ch++) {
+        delay_line_free(buffers->delay_lines[ch]);
+        free(buffers->outputs[ch]);
+    }
+    free(buffers->input);
+}
+
+static int init_buffers(struct tune_buffers *buffers, int order, int quantum) {
+    memset(buffers, 0, sizeof(*buffers));
+
+    buffers->input = malloc(sizeof(float) * quantum);
+    if (!buffers->input) {
+        return -1;
+    }
+
+    unsigned int seed = 1;
+    for (int i = 0; i < quantum; i++) {
+        buffers->input[i] = (float) rand_r(&seed) / RAND_MAX - 0.5f;
+    }
+
+    for (int ch = 0; ch < MAX_TUNE_CHANNELS; ch++) {
+        buffers->delay_lines[ch] = delay_line_init((size_t) (order + quantum) * 2);
+        buffers->outputs[ch] = malloc(sizeof(float) * quantum);
+        if (!buffers->delay_lines[ch] || !buffers->outputs[ch]) {
+            free_buffers(buffers);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Returns ns per sample and channel, or a negative value when the engine cannot run. */
+static double measure(const struct fir_filter *filter, struct tune_buffers *buffers, int quantum,
+                      int num_channels, enum convolver_engine engine, int block_size) {
+    struct convolver *conv = convolver_init_engine(filter, block_size, num_channels, engine);
+    if (!conv) {
+        return -1.0;
+    }
+
+    const struct delay_line *delay_lines[MAX_TUNE_CHANNELS];
+    for (int ch = 0; ch < num_channels; ch++) {
+        delay_lines[ch] = buffers->delay_lines[ch];
+    }
+
+    double best = -1.0;
+
+    for (int round = 0; round < MEASURE_ROUNDS; round++) {
+        const int quanta = round == 0 ? WARMUP_QUANTA : MEASURE_QUANTA;
+        const double start = now_ns();
+
+        for (int q = 0; q < quanta; q++) {
+            for (int ch = 0; ch < num_channels; ch++) {
+                delay_line_append_samples(buffers->delay_lines[ch], buffers->input, quantum);
+            }
+            convolver_apply(conv, delay_lines, quantum, buffers->outputs);
+        }
+
+        const double elapsed = (now_ns() - start) / ((double) quanta * quantum * num_channels);
+        if (round > 0 && (best < 0.0 || elapsed < best)) {
+            best = elapsed;
+        }
+    }
+
+    convolver_free(conv);
+    return best;
+}
+
+static int largest_block(int quantum) {
+    int block = 1;
+    while (quantum % (block * 2) == 0) {
+        block *= 2;
+    }
+    return block;
+}
+
+static int tune_rate(const struct fir_filter *filter, int quantum, int num_channels,
+                     struct autotune_rate *result) {
+    struct tune_buffers buffers;
+    if (init_buffers(&buffers, filter->order, quantum) != 0) {
+        fprintf(stderr, "Failed to allocate memory for tuning buffers\n");
+        return -1;
+    }
+
+    result->rate = filter->rate;
+    result->order = filter->order;
+    result->engine = CONVOLVER_ENGINE_DIRECT;
+    result->block_size = quantum;
+    result->ns_per_sample = measure(filter, &buffers, quantum, num_channels,
+                                    CONVOLVER_ENGINE_DIRECT, quantum);
+
+    /* Uniform blocks must divide the quantum; the partitioned head is only bounded by it. The
+     * pipelined engine moves work off the measured thread, so timing it here would flatter it. */
+    const int max_block = largest_block(quantum);
+    for (int block = MIN_BLOCK_SIZE; block <= quantum; block *= 2) {
+        for (int e = CONVOLVER_ENGINE_FFT; e <= CONVOLVER_ENGINE_NONUNIFORM; e++) {
+            const enum convolver_engine engine = (enum convolver_engine) e;
+            if (engine == CONVOLVER_ENGINE_FFT && block > max_block) {
+                continue;
+            }
+
+            const double ns = measure(filter, &buffers, quantum, num_channels, engine, block);
+            if (ns >= 0.0 && (result->ns_per_sample < 0.0 || ns < result->ns_per_sample)) {
+                result->engine = engine;
+                result->block_size = block;
+                result->ns_per_sample = ns;
+            }
+        }
+    }
+
+    free_buffers(&buffers);
+    return result->ns_per_sample >= 0.0 ? 0 : -1;
+}
+
+int autotune_run(const struct fir_bank *bank, int quantum, int num_channels, const char *kernel,
+                 struct autotune_profile *profile) {
+    if (!bank || !profile || quantum <= 0 || bank->num_filters > AUTOTUNE_MAX_RATES) {
+        fprintf(stderr, "Invalid autotune parameters\n");
+        return -1;
+    }
+
+    if (num_channels > MAX_TUNE_CHANNELS) {
+        num_channels = MAX_TUNE_CHANNELS;
+    }
+    if (num_channels < 1) {
+        num_channels = 1;
+    }
+
+    struct autotune_rate candidate[AUTOTUNE_MAX_RATES];
+    double best_total = -1.0;
+
+    for (int k = 0; k < fir_kernel_count(); k++) {
+        const char *name = fir_kernel_name_at(k);
+        if ((kernel && strcmp(kernel, name) != 0) || fir_kernel_select(name) != 0) {
+            continue;
+        }
+
+        double total = 0.0;
+        int ok = 1;
+        for (int i = 0; i < bank->num_filters && ok; i++) {
+            ok = tune_rate(&bank->filters[i], quantum, num_channels, &candidate[i]) == 0;
+            total += candidate[i].ns_per_sample;
+        }
+
+        if (ok && (best_total < 0.0 || total < best_total)) {
+            best_total = total;
+            snprintf(profile->kernel, sizeof(profile->kernel), "%s", name);
+            memcpy(profile->rates, candidate, sizeof(candidate[0]) * bank->num_filters);
+        }
+    }
+
+    fir_kernel_select(NULL);
+
+    if (best_total < 0.0) {
+        fprintf(stderr, "Autotuning found no usable kernel\n");
+        return -1;
+    }
+
+    profile->quantum = quantum;
+    profile->precision = bank->num_filters > 0 ? bank->filters[0].precision : FIR_PRECISION_FP32;
+    profile->num_rates = bank->num_filters;
+    return 0;
+}
+
+const struct autotune_rate *autotune_find_rate(const struct autotune_profile *profile, int rate) {
+    for (int i = 0; i < profile->num_rates; i++) {
+        if (profile->rates[i].rate == rate) {
+            return &profile->rates[i];
+        }
+    }
+    return NULL;
+}
+
+static int kernel_available(const char *name) {
+    for (int k = 0; k < fir_kernel_count(); k++) {
+        if (strcmp(fir_kernel_name_at(k), name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int autotune_load(const char *path, const struct fir_bank *bank, int quantum,
+                  struct autotune_profile *profile) {
+    if (!path || !bank || !profile) {
+        return -1;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+
+    char expected_cpu[128];
+    char line[256];
+    int version = 0;
+    int cpu_matches = 0;
+    int has_precision = 0;
+
+    cpu_model(expected_cpu, sizeof(expected_cpu));
+    memset(profile, 0, sizeof(*profile));
+
+    while (fgets(line, sizeof(line), file)) {
+        char name[AUTOTUNE_NAME_LENGTH];
+        struct autotune_rate entry;
+
+        line[strcspn(line, "\n")] = '\0';
+
+        if (strncmp(line, "cpu ", 4) == 0) {
+            cpu_matches = strcmp(line + 4, expected_cpu) == 0;
+        } else if (sscanf(line, "version %d", &version) == 1 ||
+                   sscanf(line, "quantum %d", &profile->quantum) == 1) {
+            continue;
+        } else if (sscanf(line, "precision %31s", name) == 1) {
+            has_precision = fir_precision_from_name(name, &profile->precision) == 0;
+        } else if (sscanf(line, "kernel %31s", name) == 1) {
+            snprintf(profile->kernel, sizeof(profile->kernel), "%s", name);
+        } else if (sscanf(line, "rate %d order %d engine %31s block %d ns %lf", &entry.rate,
+                          &entry.order, name, &entry.block_size, &entry.ns_per_sample) == 5) {
+            if (profile->num_rates >= AUTOTUNE_MAX_RATES ||
+                convolver_engine_from_name(name, &entry.engine) != 0) {
+                fclose(file);
+                return -1;
+            }
+            profile->rates[profile->num_rates++] = entry;
+        }
+    }
+
+    fclose(file);
+
+    /* The 16-bit kernels move half the coefficient bytes, which shifts the engine choices. */
+    if (version != PROFILE_VERSION || !cpu_matches || profile->quantum != quantum ||
+        !kernel_available(profile->kernel) || !has_precision ||
+        (bank->num_filters > 0 && profile->precision != bank->filters[0].precision)) {
+        return -1;
+    }
+
+    for (int i = 0; i < bank->num_filters; i++) {
+        const struct autotune_rate *entry = autotune_find_rate(profile, bank->filters[i].rate);
+        if (!entry || entry->order != bank->filters[i].order) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int make_dirs(const char *path) {
+    char buffer[4096];
+    snprintf(buffer, sizeof(buffer), "%s", path);
+
+    for (char *p = buffer + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(buffer, 0755) != 0 && errno != EEXIST) {
+                return -1;
+            }
+            *p = '/';
+        }
+    }
+
+    return 0;
+}
+
+int autotune_save(const char *path, const struct autotune_profile *profile) {
+    if (!path || !profile) {
+        return -1;
+    }
+
+    if (make_dirs(path) != 0) {
+        fprintf(stderr, "Failed to create directory for %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to write %s: %s\n", tmp_path, strerror(errno));
+        return -1;
+    }
+
+    char cpu[128];
+    cpu_model(cpu, sizeof(cpu));
+
+    fprintf(file, "version %d\n", PROFILE_VERSION);
+    fprintf(file, "cpu %s\n", cpu);
+    fprintf(file, "quantum %d\n", profile->quantum);
+    fprintf(file, "precision %s\n", fir_precision_name(profile->precision));
+    fprintf(file, "kernel %s\n", profile->kernel);
+    for (int i = 0; i < profile->num_rates; i++) {
+        const struct autotune_rate *entry = &profile->rates[i];
+        fprintf(file, "rate %d order %d engine %s block %d ns %.3f\n", entry->rate, entry->order,
+                convolver_engine_name(entry->engine), entry->block_size, entry->ns_per_sample);
+    }
+
+    if (fclose(file) != 0 || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Failed to save tuning profile %s: %s\n", path, strerror(errno));
+        remove(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+char *autotune_profile_path(int quantum) {
+    const char *cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char *path = NULL;
+    int length;
+
+    if (cache && cache[0] == '/') {
+        length = asprintf(&path, "%s/%s/profile-%d", cache, PROFILE_DIR, quantum);
+    } else if (home && home[0]) {
+        length = asprintf(&path, "%s/.cache/%s/profile-%d", home, PROFILE_DIR, quantum);
+    } else {
+        return NULL;
+    }
+
+    return length < 0 ? NULL : path;
+}
@@ -0,0 +1,41 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "fir.h"
+#include "convolver.h"
+
+#define AUTOTUNE_MAX_RATES 16
+#define AUTOTUNE_NAME_LENGTH 32
+
+struct autotune_rate {
+    int rate;
+    int order;
+    enum convolver_engine engine;
+    int block_size;
+    double ns_per_sample;
+};
+
+struct autotune_profile {
+    int quantum;
+    enum fir_precision precision;
+    char kernel[AUTOTUNE_NAME_LENGTH];
+    int num_rates;
+    struct autotune_rate rates[AUTOTUNE_MAX_RATES];
+};
+
+/* Benchmarks every kernel and engine per filter; kernel limits the search to one kernel. */
+int autotune_run(const struct fir_bank *bank, int quantum, int num_channels, const char *kernel,
+                 struct autotune_profile *profile);
+
+/* Fails unless the file was written for this CPU, quantum, set of filters and their precision. */
+int autotune_load(const char *path, const struct fir_bank *bank, int quantum,
+                  struct autotune_profile *profile);
+
+int autotune_save(const char *path, const struct autotune_profile *profile);
+
+/* $XDG_CACHE_HOME/speaker-compensation-filter/profile-<quantum>, or under ~/.cache; free() it. */
+char *autotune_profile_path(int quantum);
+
+const struct autotune_rate *autotune_find_rate(const struct autotune_profile *profile, int rate);
+
+#endif
@@ -0,0 +1,1081 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "fir.h"
+#include "convolver.h"
+#include "fir_quality.h"
+#include "multirate.h"
+
+#define MAX_LIST 32
+#define MAX_BENCH_CHANNELS 64
+#define MAX_BENCH_QUANTUM 8192
+#define DEFAULT_SECONDS 0.2
+#define WARMUP_QUANTA 8
+#define CHECK_QUANTA "1,7,61,257,1021"
+#define CHECK_BLOCK_QUANTA 3
+#define CHECK_WRAPS 2
+#define CHECK_MAX_LENGTH (1 << 17)
+#define CHECK_IMPULSE_SPACING 1013
+#define CHECK_REFERENCE_QUANTUM 256
+#define CHECK_FFT_BLOCK_SIZE 64
+#define CHECK_FLOOR_DB (-200.0)
+#define CHECK_DIRECT_LIMIT_DB (-120.0)
+#define CHECK_FFT_LIMIT_DB (-110.0)
+
+#if defined(__clang__)
+#define COMPILER_VERSION __VERSION__
+#else
+#define COMPILER_VERSION "gcc " __VERSION__
+#endif
+
+enum output_format {
+    FORMAT_TEXT,
+    FORMAT_CSV,
+    FORMAT_JSON,
+};
+
+struct bench_options {
+    const char *kernels[MAX_LIST];
+    int num_kernels;
+    int rates[MAX_LIST];
+    int num_rates;
+    int quanta[MAX_LIST];
+    int num_quanta;
+    int channels[MAX_LIST];
+    int num_channels;
+    enum convolver_engine engine;
+    int block_size;
+    double seconds;
+    enum output_format format;
+    const char *coefficients;
+    struct fir_quality qualities[MAX_LIST];
+    int num_qualities;
+    int multirate;
+    enum fir_precision precisions[FIR_NUM_PRECISIONS];
+    int num_precisions;
+    int check;
+    enum convolver_engine check_engines[CONVOLVER_NUM_ENGINES];
+    int num_check_engines;
+    int check_blocks;
+};
+
+struct bench_result {
+    const char *kernel;
+    const char *quality;
+    const char *precision;
+    int rate;
+    int order;
+    int factor;
+    double error_db;
+    double delay_ms;
+    int quantum;
+    int channels;
+    double ns_per_sample;
+    double rtf;
+    double cycles_per_tap;
+};
+
+enum check_input {
+    CHECK_NOISE,
+    CHECK_IMPULSES,
+};
+
+struct check_result {
+    const char *kernel;
+    const char *engine;
+    const char *quality;
+    const char *precision;
+    int rate;
+    int order;
+    const char *input;
+    int quantum;
+    int channels;
+    double error_db;
+    double cycles_per_tap;
+    int passed;
+};
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Reference cycles from the TSC; other architectures report no cycle count. */
+static int read_cycles(unsigned long long *cycles) {
+#if defined(__x86_64__) || defined(__i386__)
+    *cycles = __rdtsc();
+    return 1;
+#else
+    *cycles = 0;
+    return 0;
+#endif
+}
+
+/* Error allowed against the scalar reference, relative to the largest possible output. */
+static double check_limit_db(enum convolver_engine engine) {
+    return engine == CONVOLVER_ENGINE_DIRECT ? CHECK_DIRECT_LIMIT_DB : CHECK_FFT_LIMIT_DB;
+}
+
+/* Runs the multirate path when there is one, the full-rate convolver otherwise. */
+static void apply(struct convolver *conv, struct multirate *mr, const struct delay_line *const *lines,
+                  int quantum, float *const *outputs) {
+    if (mr) {
+        multirate_apply(mr, lines, quantum, outputs);
+    } else {
+        convolver_apply(conv, lines, quantum, outputs);
+    }
+}
+
+static int run_case(const struct fir_filter *filter, const struct fir_filter *base,
+                    const struct bench_options *options, int quantum, int num_channels, const float *input,
+                    struct bench_result *result) {
+    const int block_size = options->block_size > 0 ? options->block_size : quantum;
+    struct convolver *conv = NULL;
+    struct multirate *mr = NULL;
+    int history = filter->order;
+
+    if (base) {
+        mr = multirate_init(base, filter->rate, block_size, num_channels);
+        history = mr ? multirate_history(mr) : 0;
+    } else {
+        conv = convolver_init_engine(filter, block_size, num_channels, options->engine);
+    }
+    if (!conv && !mr) {
+        return -1;
+    }
+
+    struct delay_line *delay_lines[MAX_BENCH_CHANNELS] = {0};
+    float *outputs[MAX_BENCH_CHANNELS] = {0};
+    int ret = -1;
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        delay_lines[ch] = delay_line_init((size_t) (history + quantum) * 2);
+        outputs[ch] = malloc(sizeof(float) * quantum);
+        if (!delay_lines[ch] || !outputs[ch]) {
+            fprintf(stderr, "Failed to allocate memory for benchmark buffers\n");
+            goto out;
+        }
+    }
+
+    const struct delay_line *const *lines = (const struct delay_line *const *) delay_lines;
+
+    for (int q = 0; q < WARMUP_QUANTA; q++) {
+        for (int ch = 0; ch < num_channels; ch++) {
+            delay_line_append_samples(delay_lines[ch], input, quantum);
+        }
+        apply(conv, mr, lines, quantum, outputs);
+    }
+
+    const double budget = options->seconds * 1e9;
+    const double start = now_ns();
+    unsigned long long cycles_start, cycles_end;
+    const int have_cycles = read_cycles(&cycles_start);
+    long long quanta = 0;
+    double elapsed;
+
+    /* Check the clock every few quanta so small quanta are not dominated by clock_gettime. */
+    do {
+        for (int q = 0; q < 16; q++) {
+            for (int ch = 0; ch < num_channels; ch++) {
+                delay_line_append_samples(delay_lines[ch], input, quantum);
+            }
+            apply(conv, mr, lines, quantum, outputs);
+        }
+        quanta += 16;
+        elapsed = now_ns() - start;
+    } while (elapsed < budget);
+
+    read_cycles(&cycles_end);
+
+    const double samples = (double) quanta * quantum * num_channels;
+
+    result->kernel = fir_kernel_name();
+    result->rate = filter->rate;
+    result->order = base ? base->order : filter->order;
+    result->factor = mr ? multirate_factor(mr) : 1;
+    result->quantum = quantum;
+    result->channels = num_channels;
+    result->ns_per_sample = elapsed / samples;
+    result->rtf = (elapsed / 1e9) / ((double) quanta * quantum / filter->rate);
+    result->cycles_per_tap =
+        have_cycles ? (double) (cycles_end - cycles_start) / (samples * result->order) : -1.0;
+    ret = 0;
+
+out:
+    for (int ch = 0; ch < num_channels; ch++) {
+        delay_line_free(delay_lines[ch]);
+        free(outputs[ch]);
+    }
+    convolver_free(conv);
+    multirate_free(mr);
+    return ret;
+}
+
+/* The impulse response of the multirate path, long enough to hold all of it, as a filter. */
+static struct fir_filter *measure_multirate(const struct fir_filter *base, int rate) {
+    struct multirate *mr = multirate_init(base, rate, 64, 1);
+    if (!mr) {
+        return NULL;
+    }
+
+    const int order = 2 * multirate_latency(mr) + 1;
+    struct delay_line *delay_line = delay_line_init((size_t) multirate_history(mr) + order);
+    float *response = malloc(sizeof(float) * order);
+    float *taps = malloc(sizeof(float) * order);
+    struct fir_filter *filter = NULL;
+
+    if (delay_line && response && taps) {
+        const struct delay_line *lines[] = {delay_line};
+        float *outputs[] = {response};
+
+        memset(taps, 0, sizeof(float) * order);
+        taps[0] = 1.0f;
+        delay_line_append_samples(delay_line, taps, order);
+        multirate_apply(mr, lines, order, outputs);
+
+        /* Coefficients run from the oldest sample, so the response goes in reversed. */
+        for (int i = 0; i < order; i++) {
+            taps[order - 1 - i] = response[i];
+        }
+        const struct fir_filter measured = {.rate = rate, .coeffs = taps, .order = order};
+        filter = fir_filter_clone(&measured);
+    }
+
+    delay_line_free(delay_line);
+    free(response);
+    free(taps);
+    multirate_free(mr);
+    return filter;
+}
+
+static void print_header(const struct bench_options *options) {
+    switch (options->format) {
+        case FORMAT_TEXT:
+            printf("engine: %s, compiler: %s\n", convolver_engine_name(options->engine), COMPILER_VERSION);
+            printf("%-18s %-10s %4s %7s %6s %6s %7s %7s %7s %4s %12s %10s %10s\n", "kernel", "quality", "prec",
+                   "rate", "order", "factor", "err dB", "delay", "quantum", "ch", "ns/sample", "rtf", "cycles/tap");
+            break;
+        case FORMAT_CSV:
+            printf("kernel,engine,quality,precision,rate,order,factor,error_db,delay_ms,quantum,channels,ns_per_sample,rtf,"
+                   "cycles_per_tap,compiler\n");
+            break;
+        case FORMAT_JSON:
+            break;
+    }
+}
+
+static void print_result(const struct bench_options *options, const struct bench_result *result) {
+    const char *engine = convolver_engine_name(options->engine);
+
+    switch (options->format) {
+        case FORMAT_TEXT:
+            printf("%-18s %-10s %4s %7d %6d %6d %7.3f %7.2f %7d %4d %12.3f %10.5f %10.4f\n", result->kernel,
+                   result->quality, result->precision, result->rate, result->order, result->factor, result->error_db, result->delay_ms,
+                   result->quantum, result->channels, result->ns_per_sample, result->rtf, result->cycles_per_tap);
+            break;
+        case FORMAT_CSV:
+            printf("%s,%s,%s,%s,%d,%d,%d,%.4f,%.3f,%d,%d,%.4f,%.6f,%.5f,\"%s\"\n", result->kernel, engine,
+                   result->quality, result->precision, result->rate, result->order, result->factor, result->error_db, result->delay_ms,
+                   result->quantum, result->channels, result->ns_per_sample, result->rtf, result->cycles_per_tap,
+                   COMPILER_VERSION);
+            break;
+        case FORMAT_JSON:
+            printf("{\"kernel\":\"%s\",\"engine\":\"%s\",\"quality\":\"%s\",\"precision\":\"%s\",\"rate\":%d,\"order\":%d,"
+                   "\"factor\":%d,\"error_db\":%.4f,\"delay_ms\":%.3f,\"quantum\":%d,\"channels\":%d,"
+                   "\"ns_per_sample\":%.4f,\"rtf\":%.6f,\"cycles_per_tap\":%.5f,\"compiler\":\"%s\"}\n",
+                   result->kernel, engine, result->quality, result->precision, result->rate, result->order,
+                   result->factor,
+                   result->error_db,
+                   result->delay_ms, result->quantum, result->channels, result->ns_per_sample, result->rtf,
+                   result->cycles_per_tap, COMPILER_VERSION);
+            break;
+    }
+    fflush(stdout);
+}
+
+static void print_usage(const char *name) {
+    printf("Usage: %s [options]\n"
+           "  -k, --kernel LIST    comma-separated kernels, or \"all\" (default: detected kernel)\n"
+           "  -r, --rate LIST      comma-separated sample rates (default: all)\n"
+           "  -q, --quantum LIST   comma-separated quantum sizes (default: 32,64,...,8192)\n"
+           "  -c, --channels LIST  comma-separated channel counts (default: 1,2,8)\n"
+           "  -e, --engine NAME    direct, fft, nonuniform or pipelined (default: direct)\n"
+           "  -b, --block N        convolver block size (default: the quantum)\n"
+           "  -t, --time SECONDS   measuring time per case (default: %.1f)\n"
+           "  -f, --format FORMAT  text, csv or json (default: text)\n"
+           "      --coefficients FILE  load filters from a coefficient file\n"
+           "      --quality LIST       comma-separated quality tiers, or \"all\" (default: full)\n"
+           "      --multirate          also run each rate through the multirate path where possible\n"
+           "      --precision LIST     comma-separated coefficient storage: fp32, fp16, bf16, or \"all\"\n"
+           "                           (default: fp32)\n"
+           "      --check              instead of timing, compare every kernel with the scalar one on\n"
+           "                           noise and impulses (default kernels, engines and precisions:\n"
+           "                           all, quanta: %s, and 1, 4 and 16 blocks for the FFT\n"
+           "                           engines, channels: 1,3); fails on errors above the engine's limit\n"
+           "  -h, --help           show this help\n",
+           name, DEFAULT_SECONDS, CHECK_QUANTA);
+}
+
+static int parse_int_list(const char *arg, int *values, int max_values, int min, int max) {
+    char *copy = strdup(arg);
+    char *saveptr = NULL;
+    int count = 0;
+
+    if (!copy) {
+        return -1;
+    }
+
+    for (char *token = strtok_r(copy, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+        char *end;
+        const long value = strtol(token, &end, 10);
+
+        if (*end != '\0' || value < min || value > max || count >= max_values) {
+            free(copy);
+            return -1;
+        }
+        values[count++] = (int) value;
+    }
+
+    free(copy);
+    return count;
+}
+
+static int parse_kernel_list(char *arg, struct bench_options *options) {
+    char *saveptr = NULL;
+
+    options->num_kernels = 0;
+
+    if (strcmp(arg, "all") == 0) {
+        for (int i = 0; i < fir_kernel_count() && i < MAX_LIST; i++) {
+            options->kernels[options->num_kernels++] = fir_kernel_name_at(i);
+        }
+        return 0;
+    }
+
+    for (char *token = strtok_r(arg, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+        if (options->num_kernels >= MAX_LIST) {
+            return -1;
+        }
+        options->kernels[options->num_kernels++] = token;
+    }
+
+    return options->num_kernels > 0 ? 0 : -1;
+}
+
+static int parse_quality_list(char *arg, struct bench_options *options) {
+    char *saveptr = NULL;
+
+    options->num_qualities = 0;
+
+    if (strcmp(arg, "all") == 0) {
+        for (int i = 0; i < fir_quality_count() && i < MAX_LIST; i++) {
+            fir_quality_from_name(fir_quality_name_at(i), &options->qualities[options->num_qualities++]);
+        }
+        return 0;
+    }
+
+    for (char *token = strtok_r(arg, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+        if (options->num_qualities >= MAX_LIST ||
+            fir_quality_from_name(token, &options->qualities[options->num_qualities]) != 0) {
+            return -1;
+        }
+        options->num_qualities++;
+    }
+
+    return options->num_qualities > 0 ? 0 : -1;
+}
+
+static int parse_precision_list(char *arg, struct bench_options *options) {
+    char *saveptr = NULL;
+
+    options->num_precisions = 0;
+
+    if (strcmp(arg, "all") == 0) {
+        for (int i = 0; i < FIR_NUM_PRECISIONS; i++) {
+            options->precisions[options->num_precisions++] = (enum fir_precision) i;
+        }
+        return 0;
+    }
+
+    for (char *token = strtok_r(arg, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+        if (options->num_precisions >= FIR_NUM_PRECISIONS ||
+            fir_precision_from_name(token, &options->precisions[options->num_precisions]) != 0) {
+            return -1;
+        }
+        options->num_precisions++;
+    }
+
+    return options->num_precisions > 0 ? 0 : -1;
+}
+
+static int parse_options(int argc, char **argv, struct bench_options *options) {
+    enum { OPT_COEFFICIENTS = 256, OPT_QUALITY, OPT_MULTIRATE, OPT_PRECISION, OPT_CHECK };
+    static const struct option long_options[] = {
+        {"kernel", required_argument, NULL, 'k'},
+        {"rate", required_argument, NULL, 'r'},
+        {"quantum", required_argument, NULL, 'q'},
+        {"channels", required_argument, NULL, 'c'},
+        {"engine", required_argument, NULL, 'e'},
+        {"block", required_argument, NULL, 'b'},
+        {"time", required_argument, NULL, 't'},
+        {"format", required_argument, NULL, 'f'},
+        {"coefficients", required_argument, NULL, OPT_COEFFICIENTS},
+        {"quality", required_argument, NULL, OPT_QUALITY},
+        {"multirate", no_argument, NULL, OPT_MULTIRATE},
+        {"precision", required_argument, NULL, OPT_PRECISION},
+        {"check", no_argument, NULL, OPT_CHECK},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    memset(options, 0, sizeof(*options));
+    options->engine = CONVOLVER_ENGINE_DIRECT;
+    options->seconds = DEFAULT_SECONDS;
+    options->format = FORMAT_TEXT;
+
+    const int default_channels[] = {1, 2, 8};
+    for (int i = 0; i < 3; i++) {
+        options->channels[options->num_channels++] = default_channels[i];
+    }
+    for (int quantum = 32; quantum <= MAX_BENCH_QUANTUM; quantum *= 2) {
+        options->quanta[options->num_quanta++] = quantum;
+    }
+
+    int quanta_given = 0, channels_given = 0, engine_given = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "k:r:q:c:e:b:t:f:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'k':
+                if (parse_kernel_list(optarg, options) != 0) {
+                    fprintf(stderr, "Invalid kernel list: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'r':
+                options->num_rates = parse_int_list(optarg, options->rates, MAX_LIST, 1, 1000000);
+                if (options->num_rates <= 0) {
+                    fprintf(stderr, "Invalid rate list: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'q':
+                options->num_quanta = parse_int_list(optarg, options->quanta, MAX_LIST, 1, MAX_BENCH_QUANTUM);
+                if (options->num_quanta <= 0) {
+                    fprintf(stderr, "Invalid quantum list: %s\n", optarg);
+                    return -1;
+                }
+                quanta_given = 1;
+                break;
+            case 'c':
+                options->num_channels = parse_int_list(optarg, options->channels, MAX_LIST, 1,
+                                                       MAX_BENCH_CHANNELS);
+                if (options->num_channels <= 0) {
+                    fprintf(stderr, "Invalid channel list: %s\n", optarg);
+                    return -1;
+                }
+                channels_given = 1;
+                break;
+            case 'e':
+                if (convolver_engine_from_name(optarg, &options->engine) != 0) {
+                    fprintf(stderr, "Unknown engine: %s\n", optarg);
+                    return -1;
+                }
+                engine_given = 1;
+                break;
+            case 'b':
+                options->block_size = atoi(optarg);
+                if (options->block_size < 1) {
+                    fprintf(stderr, "Invalid block size: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 't':
+                options->seconds = atof(optarg);
+                if (options->seconds <= 0.0) {
+                    fprintf(stderr, "Invalid measuring time: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'f':
+                if (strcmp(optarg, "text") == 0) {
+                    options->format = FORMAT_TEXT;
+                } else if (strcmp(optarg, "csv") == 0) {
+                    options->format = FORMAT_CSV;
+                } else if (strcmp(optarg, "json") == 0) {
+                    options->format = FORMAT_JSON;
+                } else {
+                    fprintf(stderr, "Unknown output format: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_COEFFICIENTS:
+                options->coefficients = optarg;
+                break;
+            case OPT_QUALITY:
+                if (parse_quality_list(optarg, options) != 0) {
+                    fprintf(stderr, "Invalid quality list: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_MULTIRATE:
+                options->multirate = 1;
+                break;
+            case OPT_PRECISION:
+                if (parse_precision_list(optarg, options) != 0) {
+                    fprintf(stderr, "Invalid precision list: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_CHECK:
+                options->check = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    /* Odd quanta and channel counts reach the remainder loops of the kernels. */
+    if (options->check) {
+        if (options->num_kernels == 0) {
+            char all[] = "all";
+            parse_kernel_list(all, options);
+        }
+        if (!quanta_given) {
+            options->num_quanta = parse_int_list(CHECK_QUANTA, options->quanta, MAX_LIST, 1, MAX_BENCH_QUANTUM);
+            options->check_blocks = 1;
+        }
+        if (engine_given) {
+            options->check_engines[options->num_check_engines++] = options->engine;
+        } else {
+            for (int i = 0; i < CONVOLVER_NUM_ENGINES; i++) {
+                options->check_engines[options->num_check_engines++] = (enum convolver_engine) i;
+            }
+        }
+        if (options->num_precisions == 0) {
+            for (int i = 0; i < FIR_NUM_PRECISIONS; i++) {
+                options->precisions[options->num_precisions++] = (enum fir_precision) i;
+            }
+        }
+        if (!channels_given) {
+            options->channels[0] = 1;
+            options->channels[1] = 3;
+            options->num_channels = 2;
+        }
+    }
+    if (options->num_kernels == 0) {
+        options->kernels[options->num_kernels++] = fir_kernel_name();
+    }
+    if (options->num_qualities == 0) {
+        options->qualities[options->num_qualities++] = (struct fir_quality) {FIR_PHASE_LINEAR, 1};
+    }
+    if (options->num_precisions == 0) {
+        options->precisions[options->num_precisions++] = FIR_PRECISION_FP32;
+    }
+
+    return 0;
+}
+
+static int rate_selected(const struct bench_options *options, int rate) {
+    if (options->num_rates == 0) {
+        return 1;
+    }
+    for (int i = 0; i < options->num_rates; i++) {
+        if (options->rates[i] == rate) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Runs every quantum and channel count for one filter and path, base NULL for the full rate. */
+static int run_cases(const struct fir_filter *filter, const struct fir_filter *base,
+                     const struct bench_options *options, const float *input, const char *quality,
+                     double error_db, double delay_ms) {
+    int status = 0;
+
+    for (int q = 0; q < options->num_quanta; q++) {
+        for (int c = 0; c < options->num_channels; c++) {
+            struct bench_result result;
+
+            if (run_case(filter, base, options, options->quanta[q], options->channels[c], input, &result) != 0) {
+                fprintf(stderr, "Skipping rate %d, quantum %d, %d channels\n", filter->rate, options->quanta[q],
+                        options->channels[c]);
+                status = 1;
+                continue;
+            }
+            result.quality = quality;
+            result.precision = fir_precision_name(filter->precision);
+            result.error_db = error_db;
+            result.delay_ms = delay_ms;
+            print_result(options, &result);
+        }
+    }
+    return status;
+}
+
+/* The filter as the kernels see it at its precision: each tap rounded to the stored width. */
+static struct fir_filter *round_filter(const struct fir_filter *filter, enum fir_precision precision) {
+    float *taps = malloc(sizeof(float) * filter->order);
+    if (!taps) {
+        return NULL;
+    }
+
+    for (int i = 0; i < filter->order; i++) {
+        taps[i] = fir_precision_round(filter->coeffs[i], precision);
+    }
+    const struct fir_filter rounded = {.rate = filter->rate, .coeffs = taps, .order = filter->order};
+    struct fir_filter *result = fir_filter_clone(&rounded);
+    free(taps);
+    return result;
+}
+
+/* Runs filter f of a tier at full rate and, if asked, through the multirate path. */
+static int run_filter(const struct fir_bank *tier, int f, const struct fir_filter *ref,
+                      const struct bench_options *options, const float *input, const char *quality) {
+    const struct fir_filter *filter = &tier->filters[f];
+    struct fir_filter *rounded = round_filter(filter, filter->precision);
+    if (!rounded) {
+        fprintf(stderr, "Failed to allocate memory for the %s error\n", fir_precision_name(filter->precision));
+        return -1;
+    }
+
+    const double error_db = fir_filter_response_error(rounded, ref);
+    const double delay_ms = 1e3 * fir_filter_peak(filter) / filter->rate;
+    int status = run_cases(filter, NULL, options, input, quality, error_db, delay_ms);
+    fir_filter_free(rounded);
+
+    const struct fir_filter *base = options->multirate ? multirate_find_base(tier, filter->rate) : NULL;
+    if (!base) {
+        return status;
+    }
+
+    /* The multirate path is judged by its measured impulse response against the stock filter. */
+    struct fir_filter *measured = measure_multirate(base, filter->rate);
+    if (!measured) {
+        fprintf(stderr, "Failed to measure the multirate path for rate %d\n", filter->rate);
+        return -1;
+    }
+    const double multirate_error_db = fir_filter_response_error(measured, ref);
+    const double multirate_delay_ms = 1e3 * fir_filter_peak(measured) / filter->rate;
+    fir_filter_free(measured);
+
+    if (run_cases(filter, base, options, input, quality, multirate_error_db, multirate_delay_ms) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+/* One filter fed from per-channel inputs in quanta, the last one as short as the input leaves. */
+static int stream_filter(const struct fir_filter *filter, enum convolver_engine engine, int block_size,
+                         int quantum, int num_channels, float *const *inputs, int length,
+                         float *const *outputs, unsigned long long *cycles) {
+    struct convolver *conv = convolver_init_engine(filter, block_size, num_channels, engine);
+    if (!conv) {
+        return -1;
+    }
+
+    /* Lines only as long as the engine needs, so the input wraps each of them several times. */
+    const size_t size = (size_t) convolver_history(conv) + quantum;
+    struct delay_line *delay_lines[MAX_BENCH_CHANNELS] = {0};
+    int ret = -1;
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        delay_lines[ch] = delay_line_init(size);
+        if (!delay_lines[ch]) {
+            goto out;
+        }
+    }
+
+    const struct delay_line *const *lines = (const struct delay_line *const *) delay_lines;
+    *cycles = 0;
+
+    for (int done = 0; done < length; done += quantum) {
+        const int count = length - done < quantum ? length - done : quantum;
+        float *chunk[MAX_BENCH_CHANNELS];
+        unsigned long long before, after;
+
+        for (int ch = 0; ch < num_channels; ch++) {
+            delay_line_append_samples(delay_lines[ch], inputs[ch] + done, count);
+            chunk[ch] = outputs[ch] + done;
+        }
+        read_cycles(&before);
+        convolver_apply(conv, lines, count, chunk);
+        read_cycles(&after);
+        *cycles += after - before;
+    }
+    ret = 0;
+
+out:
+    for (int ch = 0; ch < num_channels; ch++) {
+        delay_line_free(delay_lines[ch]);
+    }
+    convolver_free(conv);
+    return ret;
+}
+
+static void fill_check_input(enum check_input kind, float *const *inputs, int num_channels, int length) {
+    for (int ch = 0; ch < num_channels; ch++) {
+        unsigned int seed = (unsigned int) ch + 1;
+
+        for (int i = 0; i < length; i++) {
+            if (kind == CHECK_NOISE) {
+                inputs[ch][i] = (float) rand_r(&seed) / RAND_MAX - 0.5f;
+            } else {
+                inputs[ch][i] = (i + 7 * ch) % CHECK_IMPULSE_SPACING == 0 ? 1.0f : 0.0f;
+            }
+        }
+    }
+}
+
+/* The worst deviation from the reference, relative to the largest output the filter can produce. */
+static double check_error_db(const struct fir_filter *reference, float *const *inputs, float *const *expected,
+                             float *const *outputs, int num_channels, int length) {
+    double gain = 0.0, peak = 0.0, error = 0.0;
+
+    for (int i = 0; i < reference->order; i++) {
+        gain += fabs(reference->coeffs[i]);
+    }
+    for (int ch = 0; ch < num_channels; ch++) {
+        for (int i = 0; i < length; i++) {
+            const double deviation = fabs((double) outputs[ch][i] - expected[ch][i]);
+
+            peak = fmax(peak, fabs(inputs[ch][i]));
+            /* Also catches NaN, which fmax would drop. */
+            error = deviation > error || deviation != deviation ? deviation : error;
+        }
+    }
+    if (error != error) {
+        return 0.0;
+    }
+    return error > 0.0 ? fmax(20.0 * log10(error / (gain * peak)), CHECK_FLOOR_DB) : CHECK_FLOOR_DB;
+}
+
+static void print_check_header(const struct bench_options *options) {
+    switch (options->format) {
+        case FORMAT_TEXT:
+            printf("compiler: %s, limits: %.0f dB direct, %.0f dB FFT engines\n", COMPILER_VERSION,
+                   check_limit_db(CONVOLVER_ENGINE_DIRECT), check_limit_db(CONVOLVER_ENGINE_FFT));
+            printf("%-18s %-10s %-10s %4s %7s %6s %-8s %7s %4s %8s %10s %s\n", "kernel", "engine", "quality",
+                   "prec", "rate", "order", "input", "quantum", "ch", "err dB", "cycles/tap", "result");
+            break;
+        case FORMAT_CSV:
+            printf("kernel,engine,quality,precision,rate,order,input,quantum,channels,error_db,cycles_per_tap,"
+                   "passed,compiler\n");
+            break;
+        case FORMAT_JSON:
+            break;
+    }
+}
+
+static void print_check_result(const struct bench_options *options, const struct check_result *result) {
+    const char *engine = result->engine;
+
+    switch (options->format) {
+        case FORMAT_TEXT:
+            printf("%-18s %-10s %-10s %4s %7d %6d %-8s %7d %4d %8.1f %10.4f %s\n", result->kernel, engine,
+                   result->quality, result->precision, result->rate, result->order, result->input,
+                   result->quantum, result->channels, result->error_db, result->cycles_per_tap,
+                   result->passed ? "ok" : "FAIL");
+            break;
+        case FORMAT_CSV:
+            printf("%s,%s,%s,%s,%d,%d,%s,%d,%d,%.2f,%.5f,%d,\"%s\"\n", result->kernel, engine, result->quality,
+                   result->precision, result->rate, result->order, result->input, result->quantum,
+                   result->channels, result->error_db, result->cycles_per_tap, result->passed,
+                   COMPILER_VERSION);
+            break;
+        case FORMAT_JSON:
+            printf("{\"kernel\":\"%s\",\"engine\":\"%s\",\"quality\":\"%s\",\"precision\":\"%s\",\"rate\":%d,"
+                   "\"order\":%d,\"input\":\"%s\",\"quantum\":%d,\"channels\":%d,\"error_db\":%.2f,"
+                   "\"cycles_per_tap\":%.5f,\"passed\":%s,\"compiler\":\"%s\"}\n",
+                   result->kernel, engine, result->quality, result->precision, result->rate, result->order,
+                   result->input, result->quantum, result->channels, result->error_db, result->cycles_per_tap,
+                   result->passed ? "true" : "false", COMPILER_VERSION);
+            break;
+    }
+    fflush(stdout);
+}
+
+static int check_block_size(const struct bench_options *options, enum convolver_engine engine) {
+    if (options->block_size > 0) {
+        return options->block_size;
+    }
+    return engine == CONVOLVER_ENGINE_DIRECT ? MAX_BENCH_QUANTUM : CHECK_FFT_BLOCK_SIZE;
+}
+
+/* The uniform FFT engine filters quanta that are not whole blocks directly instead. */
+static int check_quanta(const struct bench_options *options, enum convolver_engine engine, int *quanta) {
+    int count = options->num_quanta;
+
+    memcpy(quanta, options->quanta, sizeof(int) * count);
+    if (options->check_blocks && engine != CONVOLVER_ENGINE_DIRECT) {
+        int quantum = check_block_size(options, engine);
+        for (int i = 0; i < CHECK_BLOCK_QUANTA && quantum <= MAX_BENCH_QUANTUM; i++, quantum *= 4) {
+            quanta[count++] = quantum;
+        }
+    }
+    return count;
+}
+
+/*
+ * The 16-bit tables only feed the direct-form kernels, which the uniform FFT engine also runs on
+ * quanta that are not whole blocks; the FFT segments and the nonuniform head keep FP32 taps.
+ */
+static int reads_rounded_taps(enum convolver_engine engine, int block_size, int quantum) {
+    return engine == CONVOLVER_ENGINE_DIRECT || (engine == CONVOLVER_ENGINE_FFT && quantum % block_size != 0);
+}
+
+/*
+ * Runs every engine and kernel over one filter against the scalar kernel on the taps each path
+ * sees at its precision, for each quantum and channel count. expected holds two sets of buffers:
+ * the stored taps and the rounded ones. Returns 1 if any case fails, -1 if it cannot run.
+ */
+static int check_filter(const struct fir_filter *filter, const struct bench_options *options,
+                        enum check_input kind, float *const *inputs, float *(*expected)[MAX_BENCH_CHANNELS],
+                        float *const *outputs, const char *quality) {
+    int quanta[MAX_LIST + CHECK_BLOCK_QUANTA];
+    int max_quantum = 0, max_channels = 0, status = 0;
+
+    for (int e = 0; e < options->num_check_engines; e++) {
+        const int num_quanta = check_quanta(options, options->check_engines[e], quanta);
+        for (int q = 0; q < num_quanta; q++) {
+            max_quantum = quanta[q] > max_quantum ? quanta[q] : max_quantum;
+        }
+    }
+    for (int c = 0; c < options->num_channels; c++) {
+        max_channels = options->channels[c] > max_channels ? options->channels[c] : max_channels;
+    }
+
+    const int length = CHECK_WRAPS * (2 * filter->order + max_quantum) + CHECK_IMPULSE_SPACING;
+    const int num_references = filter->precision == FIR_PRECISION_FP32 ? 1 : 2;
+    struct fir_filter *references[2] = {
+        round_filter(filter, FIR_PRECISION_FP32),
+        round_filter(filter, filter->precision),
+    };
+    unsigned long long cycles;
+
+    if (!references[0] || !references[1] || length > CHECK_MAX_LENGTH || fir_kernel_select("scalar") != 0) {
+        fprintf(stderr, "Cannot build the reference for rate %d\n", filter->rate);
+        status = -1;
+        goto out;
+    }
+    fill_check_input(kind, inputs, max_channels, length);
+    for (int r = 0; r < num_references; r++) {
+        if (stream_filter(references[r], CONVOLVER_ENGINE_DIRECT, MAX_BENCH_QUANTUM, CHECK_REFERENCE_QUANTUM,
+                          max_channels, inputs, length, expected[r], &cycles) != 0) {
+            fprintf(stderr, "Cannot run the reference for rate %d\n", filter->rate);
+            status = -1;
+            goto out;
+        }
+    }
+
+    for (int e = 0; e < options->num_check_engines && status >= 0; e++) {
+        const enum convolver_engine engine = options->check_engines[e];
+        const int block_size = check_block_size(options, engine);
+        const int num_quanta = check_quanta(options, engine, quanta);
+
+        for (int k = 0; k < options->num_kernels && status >= 0; k++) {
+            if (fir_kernel_select(options->kernels[k]) != 0) {
+                continue;
+            }
+            for (int q = 0; q < num_quanta && status >= 0; q++) {
+                /* At FP32 both sets of taps are the same, so there is one reference. A shorter last
+                 * chunk would leave the uniform FFT path, so whole-block runs there stop short of it. */
+                const int rounded = reads_rounded_taps(engine, block_size, quanta[q]);
+                const int r = rounded ? num_references - 1 : 0;
+                const int run =
+                    engine == CONVOLVER_ENGINE_FFT && !rounded ? length - length % quanta[q] : length;
+
+                for (int c = 0; c < options->num_channels; c++) {
+                    struct check_result result = {
+                        .kernel = fir_kernel_name(),
+                        .engine = convolver_engine_name(engine),
+                        .quality = quality,
+                        .precision = fir_precision_name(filter->precision),
+                        .rate = filter->rate,
+                        .order = filter->order,
+                        .input = kind == CHECK_NOISE ? "noise" : "impulses",
+                        .quantum = quanta[q],
+                        .channels = options->channels[c],
+                    };
+
+                    if (stream_filter(filter, engine, block_size, result.quantum, result.channels, inputs,
+                                      run, outputs, &cycles) != 0) {
+                        fprintf(stderr, "Cannot run rate %d, quantum %d, %d channels\n", filter->rate,
+                                result.quantum, result.channels);
+                        status = -1;
+                        break;
+                    }
+                    result.error_db = check_error_db(references[r], inputs, expected[r], outputs,
+                                                     result.channels, run);
+                    result.cycles_per_tap =
+                        (double) cycles / ((double) run * result.channels * filter->order);
+                    result.passed = result.error_db <= check_limit_db(engine);
+                    if (!result.passed && status == 0) {
+                        status = 1;
+                    }
+                    print_check_result(options, &result);
+                }
+            }
+        }
+    }
+
+out:
+    fir_filter_free(references[0]);
+    fir_filter_free(references[1]);
+    return status;
+}
+
+/* The --check mode: returns the exit status, 1 if any kernel strays from the reference. */
+static int run_checks(const struct bench_options *options, struct fir_bank *const *tiers,
+                      char (*tier_names)[32]) {
+    float *buffers[4][MAX_BENCH_CHANNELS] = {{0}};
+    int max_channels = 0, status = 0;
+
+    for (int c = 0; c < options->num_channels; c++) {
+        max_channels = options->channels[c] > max_channels ? options->channels[c] : max_channels;
+    }
+    for (int b = 0; b < 4; b++) {
+        for (int ch = 0; ch < max_channels; ch++) {
+            buffers[b][ch] = malloc(sizeof(float) * CHECK_MAX_LENGTH);
+            if (!buffers[b][ch]) {
+                fprintf(stderr, "Failed to allocate memory for the check buffers\n");
+                status = 1;
+                goto out;
+            }
+        }
+    }
+
+    for (int k = 0; k < options->num_kernels; k++) {
+        if (fir_kernel_select(options->kernels[k]) != 0) {
+            fprintf(stderr, "Kernel %s is not available on this CPU\n", options->kernels[k]);
+            status = 1;
+        }
+    }
+    print_check_header(options);
+
+    for (int t = 0; t < options->num_qualities; t++) {
+        for (int p = 0; p < options->num_precisions; p++) {
+            if (fir_bank_set_precision(tiers[t], options->precisions[p]) != 0) {
+                status = 1;
+                continue;
+            }
+
+            for (int f = 0; f < tiers[t]->num_filters; f++) {
+                if (!rate_selected(options, tiers[t]->filters[f].rate)) {
+                    continue;
+                }
+                for (int kind = CHECK_NOISE; kind <= CHECK_IMPULSES; kind++) {
+                    if (check_filter(&tiers[t]->filters[f], options, (enum check_input) kind, buffers[0],
+                                     &buffers[1], buffers[3], tier_names[t]) != 0) {
+                        status = 1;
+                    }
+                }
+            }
+        }
+    }
+
+out:
+    for (int b = 0; b < 4; b++) {
+        for (int ch = 0; ch < max_channels; ch++) {
+            free(buffers[b][ch]);
+        }
+    }
+    return status;
+}
+
+static void free_tiers(struct fir_bank **tiers, int count) {
+    for (int i = 0; i < count; i++) {
+        fir_bank_free(tiers[i]);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    struct bench_options options;
+
+    if (parse_options(argc, argv, &options) != 0) {
+        return 1;
+    }
+
+    struct fir_bank *bank = fir_bank_load(options.coefficients);
+    float *input = malloc(sizeof(float) * MAX_BENCH_QUANTUM);
+    if (!bank || !input) {
+        fprintf(stderr, "Failed to initialize benchmark\n");
+        fir_bank_free(bank);
+        free(input);
+        return 1;
+    }
+
+    /* Every tier is derived from the stock bank, which stays the reference for the error. */
+    struct fir_bank *tiers[MAX_LIST] = {0};
+    char tier_names[MAX_LIST][32];
+    for (int t = 0; t < options.num_qualities; t++) {
+        fir_quality_format(&options.qualities[t], tier_names[t], sizeof(tier_names[t]));
+        tiers[t] = fir_bank_reduce(bank, &options.qualities[t]);
+        if (!tiers[t]) {
+            fprintf(stderr, "Failed to build %s quality filters\n", tier_names[t]);
+            free_tiers(tiers, t);
+            fir_bank_free(bank);
+            free(input);
+            return 1;
+        }
+    }
+
+    unsigned int seed = 1;
+    for (int i = 0; i < MAX_BENCH_QUANTUM; i++) {
+        input[i] = (float) rand_r(&seed) / RAND_MAX - 0.5f;
+    }
+
+    if (options.check) {
+        const int status = run_checks(&options, tiers, tier_names);
+        free_tiers(tiers, options.num_qualities);
+        fir_bank_free(bank);
+        free(input);
+        return status;
+    }
+
+    int status = 0;
+    print_header(&options);
+
+    for (int k = 0; k < options.num_kernels; k++) {
+        if (fir_kernel_select(options.kernels[k]) != 0) {
+            fprintf(stderr, "Kernel %s is not available on this CPU\n", options.kernels[k]);
+            status = 1;
+            continue;
+        }
+
+        for (int t = 0; t < options.num_qualities; t++) {
+            for (int p = 0; p < options.num_precisions; p++) {
+                if (fir_bank_set_precision(tiers[t], options.precisions[p]) != 0) {
+                    status = 1;
+                    continue;
+                }
+
+                for (int f = 0; f < tiers[t]->num_filters; f++) {
+                    if (rate_selected(&options, tiers[t]->filters[f].rate) &&
+                        run_filter(tiers[t], f, &bank->filters[f], &options, input, tier_names[t]) != 0) {
+                        status = 1;
+                    }
+                }
+            }
+        }
+    }
+
+    free_tiers(tiers, options.num_qualities);
+    fir_bank_free(bank);
+    free(input);
+    return status;
+}
@@ -0,0 +1,1077 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "convolver.h"
+#include "fft.h"
+
+#define SPECTRUM_STRIDE_MULTIPLE 16
+#define FFT_COST_PER_BUTTERFLY 5
+#define MIN_FFT_BLOCK_SIZE 32
+#define MAX_FFT_BLOCK_SIZE 1024
+#define PARTITIONS_PER_SEGMENT 4
+#define MAX_SEGMENTS 16
+#define PIPELINE_MIN_BLOCK 256
+#define PIPELINE_DEPTH 4
+#define SPECTRA_VERSION 1
+
+struct fft_segment {
+    int block_size;
+    int offset;
+    int num_partitions;
+    int bins;
+    int stride;
+
+    /* Both halves of one allocation, or of a shared mapping of shared_size bytes. */
+    const float *filter_re;
+    const float *filter_im;
+    const void *shared;
+    size_t shared_size;
+};
+
+struct segment_state {
+    struct fft_plan *plan;
+
+    float *fdl_re;
+    float *fdl_im;
+    int fdl_head;
+    int primed;
+
+    float *acc_re;
+    float *acc_im;
+    float *time_buf;
+};
+
+/* One block of a tail segment: its input windows copied out of the delay lines, then its output. */
+struct tail_job {
+    int prime;
+    float *input;
+    float *output;
+};
+
+/*
+ * Jobs of one channel's tail segment, queued by the thread filtering the channel. Jobs run in
+ * order, each on whichever of the helper and the producer claims it first, and the segment
+ * state belongs to that thread until done counts the job; claimed is done + 1 while one runs.
+ * The producer never waits for the helper: a block whose job is still running is worked out
+ * from the delay line instead, and a queue dropped while a job runs stays draining until the
+ * helper is done with the state.
+ */
+struct tail_queue {
+    struct tail_job jobs[PIPELINE_DEPTH];
+    atomic_uint issued;
+    atomic_uint claimed;
+    atomic_uint done;
+    unsigned int consumed;
+    size_t next_start;
+    int primed;
+    int draining;
+};
+
+struct convolver_channel {
+    struct segment_state segments[MAX_SEGMENTS];
+    struct tail_queue tails[MAX_SEGMENTS];
+    float *tail_ring;
+    float *direct_block;
+    size_t position;
+    int idle;
+};
+
+struct convolver {
+    const struct fir_filter *filter;
+    enum convolver_engine engine;
+    int block_size;
+
+    int head_taps;
+    struct fft_segment segments[MAX_SEGMENTS];
+    int num_segments;
+    size_t tail_mask;
+
+    struct convolver_channel *channels;
+    int num_channels;
+
+    /* Segments from first_tail on run on the helper thread in the pipelined engine. */
+    int first_tail;
+    pthread_t helper;
+    int helper_started;
+    atomic_uint wake_seq;
+    atomic_int stop;
+};
+
+static int pipeline_priority;
+static int share_spectra = 1;
+
+void convolver_set_pipeline_priority(int priority) {
+    pipeline_priority = priority;
+}
+
+void convolver_set_shared_spectra(int enable) {
+    share_spectra = enable;
+}
+
+static void futex_wait(atomic_uint *addr, unsigned int expected) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake_all(atomic_uint *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static float *alloc_spectrum(size_t count) {
+    return fir_memory_alloc(sizeof(float) * count);
+}
+
+static int log2_int(int value) {
+    int bits = 0;
+    while ((1 << bits) < value) {
+        bits++;
+    }
+    return bits;
+}
+
+static int floor_pow2(int value) {
+    int result = 1;
+    while (result * 2 <= value) {
+        result *= 2;
+    }
+    return result;
+}
+
+/* Costs are in multiply-accumulates per output sample. */
+static long segment_cost(int block_size, int num_partitions) {
+    const long fft_size = 2L * block_size;
+    const long fft_cost = 2 * FFT_COST_PER_BUTTERFLY * (fft_size / 4) * log2_int(fft_size);
+    const long mac_cost = (long) num_partitions * (block_size + 1) * 4;
+    return (fft_cost + mac_cost) / block_size;
+}
+
+struct segment_layout {
+    int head_taps;
+    int block_size[MAX_SEGMENTS];
+    int num_partitions[MAX_SEGMENTS];
+    int num_segments;
+};
+
+/*
+ * Direct-form head of one block, then segments whose block size doubles while each starts at
+ * least one block after its tap offset; every segment's output is therefore ready before it is
+ * due, whatever the quantum.
+ */
+static void plan_nonuniform(int order, int block_size, struct segment_layout *layout) {
+    int block = floor_pow2(block_size);
+    if (block < MIN_FFT_BLOCK_SIZE) {
+        block = MIN_FFT_BLOCK_SIZE;
+    }
+
+    layout->head_taps = block < order ? block : order;
+    layout->num_segments = 0;
+
+    int covered = layout->head_taps;
+    while (covered < order && layout->num_segments < MAX_SEGMENTS) {
+        const int remaining = (order - covered + block - 1) / block;
+        int partitions = remaining;
+
+        if (block < MAX_FFT_BLOCK_SIZE && remaining > PARTITIONS_PER_SEGMENT &&
+            layout->num_segments < MAX_SEGMENTS - 1) {
+            partitions = PARTITIONS_PER_SEGMENT;
+        }
+
+        layout->block_size[layout->num_segments] = block;
+        layout->num_partitions[layout->num_segments] = partitions;
+        layout->num_segments++;
+
+        covered += partitions * block;
+        if (block < MAX_FFT_BLOCK_SIZE) {
+            block *= 2;
+        }
+    }
+}
+
+static long nonuniform_cost(const struct segment_layout *layout) {
+    long cost = layout->head_taps;
+    for (int i = 0; i < layout->num_segments; i++) {
+        cost += segment_cost(layout->block_size[i], layout->num_partitions[i]);
+    }
+    return cost;
+}
+
+static enum convolver_engine select_engine(int order, int block_size) {
+    long best_cost = order;
+    enum convolver_engine best = CONVOLVER_ENGINE_DIRECT;
+
+    if (block_size >= MIN_FFT_BLOCK_SIZE && (block_size & (block_size - 1)) == 0) {
+        const long cost = segment_cost(block_size, (order + block_size - 1) / block_size);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = CONVOLVER_ENGINE_FFT;
+        }
+    }
+
+    struct segment_layout layout;
+    plan_nonuniform(order, block_size, &layout);
+    if (nonuniform_cost(&layout) < best_cost) {
+        best = CONVOLVER_ENGINE_NONUNIFORM;
+    }
+
+    return best;
+}
+
+struct spectra_source {
+    const struct fft_segment *seg;
+    const struct fir_filter *filter;
+};
+
+/* Fills the real parts of every partition, then the imaginary ones after them. */
+static int compute_spectra(void *data, void *context) {
+    const struct spectra_source *source = context;
+    const struct fft_segment *seg = source->seg;
+    const int fft_size = seg->block_size * 2;
+    const int order = source->filter->order;
+    const size_t spectra = (size_t) seg->num_partitions * seg->stride;
+    float *filter_re = data;
+    float *filter_im = filter_re + spectra;
+
+    struct fft_plan *plan = fft_plan_init(fft_size);
+    float *kernel = alloc_spectrum(fft_size);
+
+    if (!plan || !kernel) {
+        fprintf(stderr, "Failed to allocate memory for FFT convolver\n");
+        fft_plan_free(plan);
+        free(kernel);
+        return -1;
+    }
+
+    /* The time-domain kernel is reversed, so partition p holds the taps acting on delays
+     * [offset + pB, offset + pB + B). */
+    const float scale = 1.0f / (float) fft_size;
+
+    for (int p = 0; p < seg->num_partitions; p++) {
+        memset(kernel, 0, sizeof(float) * fft_size);
+
+        for (int j = 0; j < seg->block_size; j++) {
+            const int delay = seg->offset + p * seg->block_size + j;
+            if (delay < order) {
+                kernel[j] = source->filter->coeffs[order - 1 - delay] * scale;
+            }
+        }
+
+        fft_forward(plan, kernel, filter_re + (size_t) p * seg->stride, filter_im + (size_t) p * seg->stride);
+    }
+
+    fft_plan_free(plan);
+    free(kernel);
+
+    return 0;
+}
+
+/* Identifies the spectra by the taps they cover, so other filters with the same tail share them. */
+static uint64_t spectra_key(const struct fft_segment *seg, const struct fir_filter *filter) {
+    const int first = filter->order - seg->offset - seg->num_partitions * seg->block_size;
+    const int start = first > 0 ? first : 0;
+    const int layout[] = {SPECTRA_VERSION, seg->block_size, seg->num_partitions, seg->stride, first};
+
+    uint64_t key = fir_hash(FIR_HASH_INIT, layout, sizeof(layout));
+    return fir_hash(key, filter->coeffs + start, sizeof(float) * (filter->order - seg->offset - start));
+}
+
+static int segment_init(struct fft_segment *seg, const struct fir_filter *filter,
+                        int offset, int block_size, int num_partitions) {
+    seg->block_size = block_size;
+    seg->offset = offset;
+    seg->num_partitions = num_partitions;
+    seg->bins = block_size + 1;
+    seg->stride = (seg->bins + SPECTRUM_STRIDE_MULTIPLE - 1) /
+                  SPECTRUM_STRIDE_MULTIPLE * SPECTRUM_STRIDE_MULTIPLE;
+
+    const size_t spectra = (size_t) num_partitions * seg->stride;
+    struct spectra_source source = {seg, filter};
+
+    if (share_spectra && fir_share_dir()) {
+        const uint64_t key = spectra_key(seg, filter);
+        char name[64];
+
+        snprintf(name, sizeof(name), "spectra-%016llx", (unsigned long long) key);
+        seg->shared_size = sizeof(float) * spectra * 2;
+        /* The spectra always come from the FP32 taps, whatever the filter's direct precision. */
+        seg->shared = fir_share_map(name, key, FIR_PRECISION_FP32, filter->order, seg->shared_size,
+                                    compute_spectra, &source);
+        if (seg->shared) {
+            seg->filter_re = seg->shared;
+            seg->filter_im = seg->filter_re + spectra;
+            return 0;
+        }
+    }
+
+    float *storage = alloc_spectrum(spectra * 2);
+    if (!storage) {
+        fprintf(stderr, "Failed to allocate memory for FFT convolver\n");
+        return -1;
+    }
+    seg->filter_re = storage;
+    seg->filter_im = storage + spectra;
+    return compute_spectra(storage, &source);
+}
+
+static void segment_free(struct fft_segment *seg) {
+    if (seg->shared) {
+        fir_share_unmap(seg->shared, seg->shared_size);
+    } else {
+        free((void *) seg->filter_re);
+    }
+    memset(seg, 0, sizeof(*seg));
+}
+
+static int segment_state_init(struct segment_state *state, const struct fft_segment *seg) {
+    const size_t spectra = (size_t) seg->num_partitions * seg->stride;
+
+    state->plan = fft_plan_init(seg->block_size * 2);
+    state->fdl_re = alloc_spectrum(spectra);
+    state->fdl_im = alloc_spectrum(spectra);
+    state->acc_re = alloc_spectrum(seg->stride);
+    state->acc_im = alloc_spectrum(seg->stride);
+    state->time_buf = alloc_spectrum((size_t) seg->block_size * 2);
+
+    if (!state->plan || !state->fdl_re || !state->fdl_im || !state->acc_re ||
+        !state->acc_im || !state->time_buf) {
+        fprintf(stderr, "Failed to allocate memory for FFT convolver state\n");
+        return -1;
+    }
+
+    state->fdl_head = 0;
+    state->primed = 0;
+
+    return 0;
+}
+
+static void segment_state_free(struct segment_state *state) {
+    fft_plan_free(state->plan);
+    free(state->fdl_re);
+    free(state->fdl_im);
+    free(state->acc_re);
+    free(state->acc_im);
+    free(state->time_buf);
+    memset(state, 0, sizeof(*state));
+}
+
+static void transform_window(const struct fft_segment *seg, struct segment_state *state,
+                             const float *window, int slot) {
+    fft_forward(state->plan, window,
+                state->fdl_re + (size_t) slot * seg->stride,
+                state->fdl_im + (size_t) slot * seg->stride);
+}
+
+/*
+ * The newest input window of the block of outputs starting at the sample at points to.
+ * fir_filter_apply's outputs stop one sample short of the newest input, so the windows are
+ * taken one sample earlier to keep the engines aligned.
+ */
+static const float *segment_window(const struct fft_segment *seg, const float *at) {
+    return at - 1 - seg->offset - seg->block_size;
+}
+
+/*
+ * Computes the segment's contribution to one block of outputs from the newest input window of
+ * each channel, for every channel at once, so each partition spectrum is fetched once per block.
+ * Results land in each state's time_buf + block_size.
+ */
+static void segment_process(const struct fft_segment *seg, struct segment_state *const *states,
+                            int num_channels, const float *const *windows) {
+    const int block = seg->block_size;
+    const int partitions = seg->num_partitions;
+    const int bins = seg->bins;
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        struct segment_state *state = states[ch];
+        const float *newest = windows[ch];
+
+        if (!state->primed) {
+            for (int p = 0; p < partitions; p++) {
+                transform_window(seg, state, newest - p * block, (state->fdl_head + p) % partitions);
+            }
+            state->primed = 1;
+        } else {
+            state->fdl_head = (state->fdl_head + partitions - 1) % partitions;
+            transform_window(seg, state, newest, state->fdl_head);
+        }
+
+        memset(state->acc_re, 0, sizeof(float) * bins);
+        memset(state->acc_im, 0, sizeof(float) * bins);
+    }
+
+    for (int p = 0; p < partitions; p++) {
+        const float *restrict h_re = seg->filter_re + (size_t) p * seg->stride;
+        const float *restrict h_im = seg->filter_im + (size_t) p * seg->stride;
+
+        for (int ch = 0; ch < num_channels; ch++) {
+            struct segment_state *state = states[ch];
+            const size_t slot = (size_t) ((state->fdl_head + p) % partitions) * seg->stride;
+            const float *restrict x_re = state->fdl_re + slot;
+            const float *restrict x_im = state->fdl_im + slot;
+            float *restrict acc_re = state->acc_re;
+            float *restrict acc_im = state->acc_im;
+
+            for (int k = 0; k < bins; k++) {
+                acc_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+                acc_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+            }
+        }
+    }
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        struct segment_state *state = states[ch];
+        fft_inverse(state->plan, state->acc_re, state->acc_im, state->time_buf);
+    }
+}
+
+static void run_tail_job(const struct fft_segment *seg, struct segment_state *state, struct tail_job *job) {
+    const size_t history = job->prime ? (size_t) (seg->num_partitions - 1) * seg->block_size : 0;
+    const float *window = job->input + history;
+
+    /* Blocks worked out from the delay line never reached the state, so it may be stale. */
+    if (job->prime) {
+        state->primed = 0;
+    }
+    segment_process(seg, &state, 1, &window);
+    memcpy(job->output, state->time_buf + seg->block_size, sizeof(float) * seg->block_size);
+}
+
+/* Claims the oldest job that is not done, unless it is already running. */
+static struct tail_job *claim_tail_job(struct tail_queue *queue) {
+    unsigned int done = atomic_load_explicit(&queue->done, memory_order_acquire);
+
+    if (done == atomic_load_explicit(&queue->issued, memory_order_acquire) ||
+        !atomic_compare_exchange_strong_explicit(&queue->claimed, &done, done + 1,
+                                                 memory_order_acq_rel, memory_order_relaxed)) {
+        return NULL;
+    }
+    return &queue->jobs[done % PIPELINE_DEPTH];
+}
+
+static void finish_tail_job(struct tail_queue *queue) {
+    atomic_fetch_add_explicit(&queue->done, 1, memory_order_release);
+}
+
+static int tail_job_done(struct tail_queue *queue, unsigned int index) {
+    return (int) (atomic_load_explicit(&queue->done, memory_order_acquire) - index) > 0;
+}
+
+/*
+ * Producer only: drops the queued jobs and unprimes the segment. Returns 0, leaving the queue
+ * draining, while the helper still runs a job and so holds the state.
+ */
+static int cancel_tail_jobs(struct tail_queue *queue, struct segment_state *state) {
+    const unsigned int issued = atomic_load_explicit(&queue->issued, memory_order_relaxed);
+    unsigned int done = atomic_load_explicit(&queue->done, memory_order_acquire);
+
+    queue->consumed = issued;
+    queue->next_start = 0;
+    queue->primed = 0;
+
+    while (done != issued) {
+        if (atomic_compare_exchange_strong_explicit(&queue->claimed, &done, issued,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            atomic_store_explicit(&queue->done, issued, memory_order_release);
+            break;
+        }
+        /* The exchange left claimed in done; one past done means a job is running. */
+        if (done == atomic_load_explicit(&queue->done, memory_order_acquire) + 1) {
+            queue->draining = 1;
+            return 0;
+        }
+        done = atomic_load_explicit(&queue->done, memory_order_acquire);
+    }
+
+    state->primed = 0;
+    queue->draining = 0;
+    return 1;
+}
+
+static void cancel_channel_tails(struct convolver *conv, struct convolver_channel *channel) {
+    for (int i = conv->first_tail; i < conv->num_segments; i++) {
+        cancel_tail_jobs(&channel->tails[i], &channel->segments[i]);
+    }
+}
+
+/* The segment's block at at summed straight from the delay line, leaving its state alone. */
+static const float *direct_tail_block(const struct convolver *conv, const struct fft_segment *seg,
+                                      struct convolver_channel *channel, const struct delay_line *line,
+                                      const float *at) {
+    const int last = conv->filter->order - seg->offset;
+    const int span = seg->num_partitions * seg->block_size;
+    const int first = last > span ? last - span : 0;
+    struct delay_line view = *line;
+
+    view.index = (size_t) (at - line->buffer) + seg->block_size;
+    fir_filter_apply_segment(conv->filter, &view, first, last - first, seg->block_size, channel->direct_block);
+    return channel->direct_block;
+}
+
+/*
+ * The segment's output block starting at t: from its job, run here if the helper has not begun
+ * it, or computed here when none was queued. Never waits on the helper.
+ */
+static const float *collect_tail_block(const struct convolver *conv, const struct fft_segment *seg,
+                                       struct convolver_channel *channel, int segment,
+                                       const struct delay_line *line, size_t t, const float *at) {
+    struct tail_queue *queue = &channel->tails[segment];
+    struct segment_state *state = &channel->segments[segment];
+
+    if (queue->draining && !cancel_tail_jobs(queue, state)) {
+        return direct_tail_block(conv, seg, channel, line, at);
+    }
+
+    if (queue->consumed != atomic_load_explicit(&queue->issued, memory_order_relaxed)) {
+        const unsigned int index = queue->consumed++;
+        struct tail_job *job = &queue->jobs[index % PIPELINE_DEPTH];
+
+        if (!tail_job_done(queue, index)) {
+            struct tail_job *next = claim_tail_job(queue);
+            if (next) {
+                run_tail_job(seg, state, next);
+                finish_tail_job(queue);
+            }
+        }
+        /* Still running on the helper, which leaves the state as the next job expects it. */
+        return tail_job_done(queue, index) ? job->output : direct_tail_block(conv, seg, channel, line, at);
+    }
+
+    /* A job consumed earlier may still be running, and then the state is not ours to touch; it
+     * misses this block, so the next job primes it afresh. */
+    queue->next_start = t + seg->block_size;
+    if (!tail_job_done(queue, queue->consumed - 1)) {
+        queue->primed = 0;
+        return direct_tail_block(conv, seg, channel, line, at);
+    }
+
+    const float *window = segment_window(seg, at);
+    if (!queue->primed) {
+        state->primed = 0;
+    }
+    segment_process(seg, &state, 1, &window);
+    queue->primed = 1;
+    return state->time_buf + seg->block_size;
+}
+
+/* A slot is free once its job is consumed and done; a consumed job may still be running. */
+static int tail_slot_free(struct tail_queue *queue) {
+    const unsigned int issued = atomic_load_explicit(&queue->issued, memory_order_relaxed);
+    return issued - queue->consumed < PIPELINE_DEPTH &&
+           issued - atomic_load_explicit(&queue->done, memory_order_acquire) < PIPELINE_DEPTH;
+}
+
+/*
+ * Queues every tail block whose windows are in the delay line once the outputs up to end are
+ * written, as far as the queues hold, copying the windows out so the lines may change under the
+ * helper. Returns whether anything was queued.
+ */
+static int issue_tail_jobs(struct convolver *conv, struct convolver_channel *channel,
+                           const struct delay_line *line, size_t position, size_t end) {
+    int queued = 0;
+
+    for (int i = conv->first_tail; i < conv->num_segments; i++) {
+        const struct fft_segment *seg = &conv->segments[i];
+        struct tail_queue *queue = &channel->tails[i];
+        const size_t block = seg->block_size;
+
+        if (queue->draining) {
+            continue;
+        }
+        if (queue->next_start < position) {
+            queue->next_start = (position + block - 1) / block * block;
+        }
+
+        while (queue->next_start + block <= end + seg->offset + 1 && tail_slot_free(queue)) {
+            const unsigned int index = atomic_load_explicit(&queue->issued, memory_order_relaxed);
+            struct tail_job *job = &queue->jobs[index % PIPELINE_DEPTH];
+            const size_t back = end + 1 + seg->offset + block - queue->next_start;
+            const float *window = line->buffer + line->index - back;
+
+            job->prime = !queue->primed;
+            const size_t history = job->prime ? (size_t) (seg->num_partitions - 1) * block : 0;
+            memcpy(job->input, window - history, sizeof(float) * (history + 2 * block));
+            atomic_store_explicit(&queue->issued, index + 1, memory_order_release);
+
+            queue->primed = 1;
+            queue->next_start += block;
+            queued = 1;
+        }
+    }
+    return queued;
+}
+
+static void *helper_main(void *arg) {
+    struct convolver *conv = arg;
+    unsigned int seq = atomic_load_explicit(&conv->wake_seq, memory_order_acquire);
+
+    fir_flush_denormals();
+    while (!atomic_load_explicit(&conv->stop, memory_order_acquire)) {
+        int ran = 0;
+
+        for (int ch = 0; ch < conv->num_channels; ch++) {
+            struct convolver_channel *channel = &conv->channels[ch];
+
+            for (int i = conv->first_tail; i < conv->num_segments; i++) {
+                struct tail_job *job = claim_tail_job(&channel->tails[i]);
+                if (job) {
+                    run_tail_job(&conv->segments[i], &channel->segments[i], job);
+                    finish_tail_job(&channel->tails[i]);
+                    ran = 1;
+                }
+            }
+        }
+
+        if (!ran) {
+            futex_wait(&conv->wake_seq, seq);
+            seq = atomic_load_explicit(&conv->wake_seq, memory_order_acquire);
+        }
+    }
+
+    return NULL;
+}
+
+static void wake_helper(struct convolver *conv) {
+    atomic_fetch_add_explicit(&conv->wake_seq, 1, memory_order_release);
+    futex_wake_all(&conv->wake_seq);
+}
+
+static void apply_uniform(struct convolver *conv, struct convolver_channel *channels, int n,
+                          const struct delay_line *const *delay_lines, int count,
+                          float *const *outputs) {
+    const struct fft_segment *seg = &conv->segments[0];
+
+    if (count % seg->block_size != 0) {
+        fir_filter_apply_multi(conv->filter, delay_lines, n, count, outputs);
+        for (int ch = 0; ch < n; ch++) {
+            channels[ch].segments[0].primed = 0;
+        }
+        return;
+    }
+
+    struct segment_state *states[CONVOLVER_MAX_CHANNELS];
+    const float *windows[CONVOLVER_MAX_CHANNELS] = {NULL};
+
+    for (int ch = 0; ch < n; ch++) {
+        states[ch] = &channels[ch].segments[0];
+    }
+
+    for (int offset = 0; offset < count; offset += seg->block_size) {
+        for (int ch = 0; ch < n; ch++) {
+            const struct delay_line *line = delay_lines[ch];
+            windows[ch] = segment_window(seg, line->buffer + line->index - count + offset);
+        }
+
+        segment_process(seg, states, n, windows);
+
+        for (int ch = 0; ch < n; ch++) {
+            memcpy(outputs[ch] + offset, states[ch]->time_buf + seg->block_size,
+                   sizeof(float) * seg->block_size);
+        }
+    }
+}
+
+static void apply_nonuniform(struct convolver *conv, struct convolver_channel *channels, int n,
+                             const struct delay_line *const *delay_lines, int count,
+                             float *const *outputs) {
+    const int order = conv->filter->order;
+    const int first_block = conv->segments[0].block_size;
+    const size_t position = channels[0].position;
+
+    struct segment_state *states[CONVOLVER_MAX_CHANNELS];
+    const float *at[CONVOLVER_MAX_CHANNELS] = {NULL};
+
+    for (int ch = 0; ch < n; ch++) {
+        fir_filter_apply_segment(conv->filter, delay_lines[ch], order - conv->head_taps,
+                                 conv->head_taps, count, outputs[ch]);
+    }
+
+    int done = 0;
+    while (done < count) {
+        const size_t t = position + done;
+
+        for (int ch = 0; ch < n; ch++) {
+            at[ch] = delay_lines[ch]->buffer + delay_lines[ch]->index - count + done;
+        }
+
+        for (int i = 0; i < conv->num_segments; i++) {
+            const struct fft_segment *seg = &conv->segments[i];
+            if (t % seg->block_size != 0) {
+                continue;
+            }
+
+            const float *windows[CONVOLVER_MAX_CHANNELS];
+            for (int ch = 0; ch < n; ch++) {
+                states[ch] = &channels[ch].segments[i];
+                windows[ch] = segment_window(seg, at[ch]);
+            }
+
+            if (i < conv->first_tail) {
+                segment_process(seg, states, n, windows);
+            }
+
+            for (int ch = 0; ch < n; ch++) {
+                const float *result = i < conv->first_tail ? states[ch]->time_buf + seg->block_size :
+                                      collect_tail_block(conv, seg, &channels[ch], i, delay_lines[ch], t,
+                                                         at[ch]);
+                float *ring = channels[ch].tail_ring + (t & conv->tail_mask);
+                for (int j = 0; j < seg->block_size; j++) {
+                    ring[j] += result[j];
+                }
+            }
+        }
+
+        int chunk = first_block - (int) (t % first_block);
+        if (chunk > count - done) {
+            chunk = count - done;
+        }
+
+        for (int ch = 0; ch < n; ch++) {
+            float *ring = channels[ch].tail_ring + (t & conv->tail_mask);
+            float *output = outputs[ch] + done;
+            for (int j = 0; j < chunk; j++) {
+                output[j] += ring[j];
+                ring[j] = 0.0f;
+            }
+        }
+
+        done += chunk;
+    }
+
+    int queued = 0;
+    for (int ch = 0; ch < n; ch++) {
+        if (conv->first_tail < conv->num_segments) {
+            queued |= issue_tail_jobs(conv, &channels[ch], delay_lines[ch], position, position + count);
+        }
+        channels[ch].position = position + count;
+    }
+    if (queued) {
+        wake_helper(conv);
+    }
+}
+
+void convolver_apply_channels(struct convolver *conv, int first_channel, int num_channels,
+                              const struct delay_line *const *delay_lines, int count,
+                              float *const *outputs) {
+    if (!conv || !delay_lines || !outputs || count <= 0 || first_channel < 0 ||
+        num_channels <= 0 || first_channel + num_channels > conv->num_channels) {
+        return;
+    }
+
+    struct convolver_channel *channels = conv->channels + first_channel;
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        channels[ch].idle = 0;
+    }
+
+    switch (conv->engine) {
+        case CONVOLVER_ENGINE_FFT:
+            apply_uniform(conv, channels, num_channels, delay_lines, count, outputs);
+            break;
+        case CONVOLVER_ENGINE_NONUNIFORM:
+        case CONVOLVER_ENGINE_PIPELINED:
+            apply_nonuniform(conv, channels, num_channels, delay_lines, count, outputs);
+            break;
+        case CONVOLVER_ENGINE_DIRECT:
+        default:
+            fir_filter_apply_multi(conv->filter, delay_lines, num_channels, count, outputs);
+            break;
+    }
+}
+
+void convolver_apply(struct convolver *conv, const struct delay_line *const *delay_lines,
+                     int count, float *const *outputs) {
+    if (conv) {
+        convolver_apply_channels(conv, 0, conv->num_channels, delay_lines, count, outputs);
+    }
+}
+
+void convolver_reset(struct convolver *conv) {
+    if (!conv) {
+        return;
+    }
+
+    for (int ch = 0; ch < conv->num_channels; ch++) {
+        struct convolver_channel *channel = &conv->channels[ch];
+
+        cancel_channel_tails(conv, channel);
+        for (int i = 0; i < conv->first_tail; i++) {
+            channel->segments[i].primed = 0;
+        }
+
+        /* Restarting the block clock at zero puts every segment on a boundary, so all of them
+         * re-prime from the delay line before the next output is due. */
+        channel->position = 0;
+        if (channel->tail_ring) {
+            memset(channel->tail_ring, 0, sizeof(float) * (conv->tail_mask + 1));
+        }
+    }
+}
+
+void convolver_skip_channels(struct convolver *conv, int first_channel, int num_channels, int count) {
+    if (!conv || count <= 0 || first_channel < 0 || num_channels <= 0 ||
+        first_channel + num_channels > conv->num_channels) {
+        return;
+    }
+
+    for (int ch = first_channel; ch < first_channel + num_channels; ch++) {
+        struct convolver_channel *channel = &conv->channels[ch];
+
+        /* Zeros in give zeros out, so the state only has to be dropped once; the clock keeps
+         * running so channels sharing a group stay on the same partition boundaries. */
+        if (!channel->idle) {
+            cancel_channel_tails(conv, channel);
+            for (int i = 0; i < conv->first_tail; i++) {
+                channel->segments[i].primed = 0;
+            }
+            if (channel->tail_ring) {
+                memset(channel->tail_ring, 0, sizeof(float) * (conv->tail_mask + 1));
+            }
+            channel->idle = 1;
+        }
+        channel->position += count;
+    }
+}
+
+/* Priming reads every partition's window, and the last partition may run past the filter. */
+int convolver_history(const struct convolver *conv) {
+    const struct fir_filter *filter = conv->filter;
+    /* Unfolded padded taps run from padded_order samples back, over the zeros ahead of the taps. */
+    int history = filter->padded_coeffs && !filter->folded_coeffs && filter->padded_order > filter->order
+                      ? filter->padded_order : filter->order;
+
+    for (int i = 0; i < conv->num_segments; i++) {
+        const struct fft_segment *seg = &conv->segments[i];
+        const int reach = seg->offset + seg->num_partitions * seg->block_size + 1;
+        history = reach > history ? reach : history;
+    }
+    return history;
+}
+
+enum convolver_engine convolver_get_engine(const struct convolver *conv) {
+    return conv->engine;
+}
+
+const char *convolver_engine_name(enum convolver_engine engine) {
+    switch (engine) {
+        case CONVOLVER_ENGINE_FFT:
+            return "fft";
+        case CONVOLVER_ENGINE_NONUNIFORM:
+            return "nonuniform";
+        case CONVOLVER_ENGINE_PIPELINED:
+            return "pipelined";
+        case CONVOLVER_ENGINE_DIRECT:
+        default:
+            return "direct";
+    }
+}
+
+int convolver_engine_from_name(const char *name, enum convolver_engine *engine) {
+    for (int i = 0; i < CONVOLVER_NUM_ENGINES; i++) {
+        if (name && strcmp(name, convolver_engine_name((enum convolver_engine) i)) == 0) {
+            *engine = (enum convolver_engine) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void convolver_free(struct convolver *conv) {
+    if (!conv) {
+        return;
+    }
+
+    if (conv->helper_started) {
+        atomic_store_explicit(&conv->stop, 1, memory_order_release);
+        wake_helper(conv);
+        pthread_join(conv->helper, NULL);
+    }
+
+    if (conv->channels) {
+        for (int ch = 0; ch < conv->num_channels; ch++) {
+            for (int i = 0; i < conv->num_segments; i++) {
+                segment_state_free(&conv->channels[ch].segments[i]);
+                for (int j = 0; j < PIPELINE_DEPTH; j++) {
+                    free(conv->channels[ch].tails[i].jobs[j].input);
+                    free(conv->channels[ch].tails[i].jobs[j].output);
+                }
+            }
+            free(conv->channels[ch].tail_ring);
+            free(conv->channels[ch].direct_block);
+        }
+        free(conv->channels);
+    }
+
+    for (int i = 0; i < conv->num_segments; i++) {
+        segment_free(&conv->segments[i]);
+    }
+
+    free(conv);
+}
+
+/* A helper without its real-time priority would leave the data thread computing tails itself. */
+static int start_helper(struct convolver *conv) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+    if (pipeline_priority > 0) {
+        struct sched_param param = {.sched_priority = pipeline_priority};
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+    }
+
+    const int err = pthread_create(&conv->helper, &attr, helper_main, conv);
+    pthread_attr_destroy(&attr);
+
+    if (err == EPERM && pipeline_priority > 0) {
+        fprintf(stderr, "Cannot run the pipelined convolver helper at SCHED_FIFO priority %d: %s\n",
+                pipeline_priority, strerror(err));
+        return -1;
+    }
+    if (err != 0) {
+        fprintf(stderr, "Failed to create convolver helper thread: %s\n", strerror(err));
+        return -1;
+    }
+
+    conv->helper_started = 1;
+    return 0;
+}
+
+static int init_segments(struct convolver *conv) {
+    const int order = conv->filter->order;
+    struct segment_layout layout;
+
+    if (conv->engine == CONVOLVER_ENGINE_FFT) {
+        layout.head_taps = 0;
+        layout.num_segments = 1;
+        layout.block_size[0] = conv->block_size;
+        layout.num_partitions[0] = (order + conv->block_size - 1) / conv->block_size;
+    } else {
+        plan_nonuniform(order, conv->block_size, &layout);
+    }
+
+    conv->head_taps = layout.head_taps;
+    conv->first_tail = layout.num_segments;
+
+    int offset = layout.head_taps;
+    int largest = 0;
+
+    for (int i = 0; i < layout.num_segments; i++) {
+        if (conv->engine == CONVOLVER_ENGINE_PIPELINED && layout.block_size[i] >= PIPELINE_MIN_BLOCK &&
+            conv->first_tail > i) {
+            conv->first_tail = i;
+        }
+        conv->num_segments = i + 1;
+        if (segment_init(&conv->segments[i], conv->filter, offset,
+                         layout.block_size[i], layout.num_partitions[i]) != 0) {
+            return -1;
+        }
+        offset += layout.block_size[i] * layout.num_partitions[i];
+        if (layout.block_size[i] > largest) {
+            largest = layout.block_size[i];
+        }
+    }
+
+    const size_t ring_size = (size_t) largest * 2;
+    conv->tail_mask = ring_size - 1;
+
+    for (int ch = 0; ch < conv->num_channels; ch++) {
+        struct convolver_channel *channel = &conv->channels[ch];
+
+        for (int i = 0; i < conv->num_segments; i++) {
+            if (segment_state_init(&channel->segments[i], &conv->segments[i]) != 0) {
+                return -1;
+            }
+        }
+
+        if (conv->engine != CONVOLVER_ENGINE_FFT) {
+            channel->tail_ring = alloc_spectrum(ring_size);
+            if (!channel->tail_ring) {
+                fprintf(stderr, "Failed to allocate memory for convolver output ring\n");
+                return -1;
+            }
+        }
+        channel->position = 0;
+
+        /* A job holds the windows that prime the whole segment, not just the newest one. */
+        for (int i = conv->first_tail; i < conv->num_segments; i++) {
+            const struct fft_segment *seg = &conv->segments[i];
+
+            for (int j = 0; j < PIPELINE_DEPTH; j++) {
+                struct tail_job *job = &channel->tails[i].jobs[j];
+                job->input = alloc_spectrum((size_t) (seg->num_partitions + 1) * seg->block_size);
+                job->output = alloc_spectrum(seg->block_size);
+                if (!job->input || !job->output) {
+                    fprintf(stderr, "Failed to allocate memory for convolver pipeline\n");
+                    return -1;
+                }
+            }
+        }
+        if (conv->first_tail < conv->num_segments) {
+            channel->direct_block = alloc_spectrum(largest);
+            if (!channel->direct_block) {
+                fprintf(stderr, "Failed to allocate memory for convolver pipeline\n");
+                return -1;
+            }
+        }
+    }
+
+    return conv->first_tail < conv->num_segments ? start_helper(conv) : 0;
+}
+
+struct convolver *convolver_init_engine(const struct fir_filter *filter, int block_size,
+                                       int num_channels, enum convolver_engine engine) {
+    if (!filter || block_size <= 0 || num_channels <= 0 || num_channels > CONVOLVER_MAX_CHANNELS) {
+        fprintf(stderr, "Invalid convolver parameters\n");
+        return NULL;
+    }
+
+    if (engine == CONVOLVER_ENGINE_FFT &&
+        (block_size < MIN_FFT_BLOCK_SIZE || (block_size & (block_size - 1)) != 0)) {
+        fprintf(stderr, "Invalid FFT block size: %d\n", block_size);
+        return NULL;
+    }
+
+    struct convolver *conv = calloc(1, sizeof(struct convolver));
+    if (!conv) {
+        fprintf(stderr, "Failed to allocate memory for convolver\n");
+        return NULL;
+    }
+
+    conv->channels = calloc(num_channels, sizeof(struct convolver_channel));
+    if (!conv->channels) {
+        fprintf(stderr, "Failed to allocate memory for convolver channels\n");
+        free(conv);
+        return NULL;
+    }
+
+    conv->filter = filter;
+    conv->block_size = block_size;
+    conv->num_channels = num_channels;
+    conv->engine = engine;
+
+    if (conv->engine != CONVOLVER_ENGINE_DIRECT && init_segments(conv) != 0) {
+        convolver_free(conv);
+        return NULL;
+    }
+
+    return conv;
+}
+
+struct convolver *convolver_init(const struct fir_filter *filter, int block_size, int num_channels) {
+    if (!filter || block_size <= 0) {
+        fprintf(stderr, "Invalid convolver parameters\n");
+        return NULL;
+    }
+
+    return convolver_init_engine(filter, block_size, num_channels,
+                                 select_engine(filter->order, block_size));
+}
@@ -0,0 +1,70 @@
+#ifndef CONVOLVER_H
+#define CONVOLVER_H
+
+#include "fir.h"
+
+#define CONVOLVER_MAX_CHANNELS 64
+
+enum convolver_engine {
+    CONVOLVER_ENGINE_DIRECT,
+    CONVOLVER_ENGINE_FFT,
+    CONVOLVER_ENGINE_NONUNIFORM,
+    CONVOLVER_ENGINE_PIPELINED,
+};
+
+#define CONVOLVER_NUM_ENGINES 4
+
+/*
+ * CONVOLVER_ENGINE_PIPELINED is the nonuniform layout with its segments of 256 taps and more
+ * computed on a helper thread per convolver, ahead of the quantum they are due in, so the work
+ * spreads evenly over small quanta. The caller never waits on the helper: a block it has not
+ * started is computed in place, and one it is still running is summed from the delay line.
+ * The cost model never picks it. Helpers run SCHED_FIFO at this priority when above 0, and
+ * building the convolver fails if that is refused; set it before building convolvers.
+ */
+void convolver_set_pipeline_priority(int priority);
+
+/*
+ * With a shared directory set (see fir_share_set_dir), FFT segment spectra are kept there and
+ * mapped by every convolver with the same taps, in this and other processes, instead of being
+ * transformed again. On by default; turn it off around convolvers that are only tried out.
+ */
+void convolver_set_shared_spectra(int enable);
+
+struct convolver;
+
+struct convolver *convolver_init(const struct fir_filter *filter, int block_size, int num_channels);
+
+/* Skips the cost model; the FFT engine needs a power-of-two block_size of at least 32. */
+struct convolver *convolver_init_engine(const struct fir_filter *filter, int block_size,
+                                       int num_channels, enum convolver_engine engine);
+
+void convolver_free(struct convolver *conv);
+
+void convolver_apply(struct convolver *conv, const struct delay_line *const *delay_lines,
+                     int count, float *const *outputs);
+
+/* Processes channels [first_channel, first_channel + num_channels); disjoint ranges may run concurrently. */
+void convolver_apply_channels(struct convolver *conv, int first_channel, int num_channels,
+                              const struct delay_line *const *delay_lines, int count,
+                              float *const *outputs);
+
+void convolver_reset(struct convolver *conv);
+
+/*
+ * Stands in for convolver_apply_channels when the delay lines hold only zeros over the filter
+ * and the count new samples, so the output is zeros; writes nothing. Segments re-prime from the
+ * delay lines once the channels are applied again.
+ */
+void convolver_skip_channels(struct convolver *conv, int first_channel, int num_channels, int count);
+
+/* Input samples read behind the newest one; the delay lines need count + convolver_history(). */
+int convolver_history(const struct convolver *conv);
+
+enum convolver_engine convolver_get_engine(const struct convolver *conv);
+
+const char *convolver_engine_name(enum convolver_engine engine);
+
+int convolver_engine_from_name(const char *name, enum convolver_engine *engine);
+
+#endif
@@ -0,0 +1,165 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "fir.h"
+
+#define MAX_EXPORT_FILTERS 64
+
+/* Reads whitespace or comma separated taps; '#' starts a comment that runs to the end of the line. */
+static float *read_taps(const char *path, int *order) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return NULL;
+    }
+
+    size_t capacity = 4096;
+    size_t count = 0;
+    float *taps = malloc(sizeof(float) * capacity);
+    char line[256];
+
+    while (taps && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "#\n")] = '\0';
+
+        char *saveptr = NULL;
+        for (char *token = strtok_r(line, " \t\r,", &saveptr); token;
+             token = strtok_r(NULL, " \t\r,", &saveptr)) {
+            char *end;
+            const float value = strtof(token, &end);
+
+            if (*end != '\0') {
+                fprintf(stderr, "%s: invalid coefficient \"%s\"\n", path, token);
+                free(taps);
+                fclose(file);
+                return NULL;
+            }
+
+            if (count == capacity) {
+                float *grown = realloc(taps, sizeof(float) * capacity * 2);
+                if (!grown) {
+                    free(taps);
+                    taps = NULL;
+                    break;
+                }
+                taps = grown;
+                capacity *= 2;
+            }
+            taps[count++] = value;
+        }
+    }
+
+    fclose(file);
+
+    if (!taps) {
+        fprintf(stderr, "Failed to allocate memory for %s\n", path);
+        return NULL;
+    }
+    if (count == 0) {
+        fprintf(stderr, "%s has no coefficients\n", path);
+        free(taps);
+        return NULL;
+    }
+
+    *order = (int) count;
+    return taps;
+}
+
+static void print_usage(const char *name) {
+    printf("Usage: %s [options] -o FILE [RATE:TAPS...]\n"
+           "Writes a coefficient file for --coefficients. Without RATE:TAPS pairs the\n"
+           "compiled-in filters (or those of --coefficients) are exported; TAPS is a text\n"
+           "file with one coefficient per line.\n"
+           "  -o, --output FILE         coefficient file to write\n"
+           "      --coefficients FILE   re-export an existing coefficient file\n"
+           "  -h, --help                show this help\n",
+           name);
+}
+
+int main(int argc, char *argv[]) {
+    enum { OPT_COEFFICIENTS = 256 };
+    static const struct option long_options[] = {
+        {"output", required_argument, NULL, 'o'},
+        {"coefficients", required_argument, NULL, OPT_COEFFICIENTS},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    const char *output = NULL;
+    const char *coefficients = NULL;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "o:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'o':
+                output = optarg;
+                break;
+            case OPT_COEFFICIENTS:
+                coefficients = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    const int num_pairs = argc - optind;
+    if (!output || num_pairs > MAX_EXPORT_FILTERS || (coefficients && num_pairs > 0)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    struct fir_bank *bank = NULL;
+
+    if (num_pairs == 0) {
+        bank = fir_bank_load(coefficients);
+    } else {
+        struct fir_filter filters[MAX_EXPORT_FILTERS] = {0};
+        int ok = 1;
+
+        for (int i = 0; i < num_pairs && ok; i++) {
+            const char *pair = argv[optind + i];
+            char *end;
+            const long rate = strtol(pair, &end, 10);
+
+            if (*end != ':' || rate <= 0) {
+                fprintf(stderr, "Expected RATE:TAPS, got %s\n", pair);
+                ok = 0;
+                break;
+            }
+
+            filters[i].rate = (int) rate;
+            filters[i].coeffs = read_taps(end + 1, &filters[i].order);
+            ok = filters[i].coeffs != NULL;
+        }
+
+        if (ok) {
+            bank = fir_bank_init(filters, num_pairs);
+        }
+        for (int i = 0; i < num_pairs; i++) {
+            free((void *) filters[i].coeffs);
+        }
+    }
+
+    if (!bank) {
+        return 1;
+    }
+
+    const int ret = fir_bank_export(bank, output);
+    if (ret == 0) {
+        for (int i = 0; i < bank->num_filters; i++) {
+            const struct fir_filter *filter = &bank->filters[i];
+            printf("%d Hz: %d taps%s\n", filter->rate, filter->order,
+                   filter->folded_coeffs ? ", symmetric" : "");
+        }
+        printf("Wrote %s\n", output);
+    }
+
+    fir_bank_free(bank);
+    return ret == 0 ? 0 : 1;
+}
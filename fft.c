@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "fft.h"
+#include "fir.h"
+
+struct fft_plan {
+    int size;
+    int half;
+    int *bitrev;
+    float *twiddle_re;
+    float *twiddle_im;
+    float *split_re;
+    float *split_im;
+    float *work_re;
+    float *work_im;
+};
+
+static void fft_complex(const struct fft_plan *plan, float *re, float *im, int inverse) {
+    const int n = plan->half;
+    const float *tw_re = plan->twiddle_re;
+    const float *tw_im = plan->twiddle_im;
+
+    for (int len = 2; len <= n; len <<= 1) {
+        const int half = len >> 1;
+
+        for (int i = 0; i < n; i += len) {
+            float *a_re = re + i;
+            float *a_im = im + i;
+            float *b_re = re + i + half;
+            float *b_im = im + i + half;
+
+            for (int k = 0; k < half; k++) {
+                const float wr = tw_re[k];
+                const float wi = inverse ? -tw_im[k] : tw_im[k];
+                const float tr = b_re[k] * wr - b_im[k] * wi;
+                const float ti = b_re[k] * wi + b_im[k] * wr;
+
+                b_re[k] = a_re[k] - tr;
+                b_im[k] = a_im[k] - ti;
+                a_re[k] += tr;
+                a_im[k] += ti;
+            }
+        }
+
+        tw_re += half;
+        tw_im += half;
+    }
+}
+
+void fft_forward(struct fft_plan *plan, const float *input, float *re, float *im) {
+    const int n = plan->half;
+    float *zr = plan->work_re;
+    float *zi = plan->work_im;
+
+    for (int j = 0; j < n; j++) {
+        zr[plan->bitrev[j]] = input[2 * j];
+        zi[plan->bitrev[j]] = input[2 * j + 1];
+    }
+
+    fft_complex(plan, zr, zi, 0);
+
+    re[0] = zr[0] + zi[0];
+    im[0] = 0.0f;
+    re[n] = zr[0] - zi[0];
+    im[n] = 0.0f;
+
+    for (int k = 1; k < n; k++) {
+        const float ar = zr[k];
+        const float ai = zi[k];
+        const float br = zr[n - k];
+        const float bi = -zi[n - k];
+
+        const float er = 0.5f * (ar + br);
+        const float ei = 0.5f * (ai + bi);
+        /* -i * (a - b) / 2 */
+        const float odd_re = 0.5f * (ai - bi);
+        const float odd_im = -0.5f * (ar - br);
+
+        const float wr = plan->split_re[k];
+        const float wi = plan->split_im[k];
+
+        re[k] = er + wr * odd_re - wi * odd_im;
+        im[k] = ei + wr * odd_im + wi * odd_re;
+    }
+}
+
+void fft_inverse(struct fft_plan *plan, const float *re, const float *im, float *output) {
+    const int n = plan->half;
+    float *zr = plan->work_re;
+    float *zi = plan->work_im;
+
+    for (int k = 0; k < n; k++) {
+        const float ar = re[k];
+        const float ai = im[k];
+        const float br = re[n - k];
+        const float bi = -im[n - k];
+
+        const float er = ar + br;
+        const float ei = ai + bi;
+        const float dr = ar - br;
+        const float di = ai - bi;
+
+        /* conj(w) * (a - b), then multiplied by i */
+        const float wr = plan->split_re[k];
+        const float wi = plan->split_im[k];
+        const float odd_re = wr * dr + wi * di;
+        const float odd_im = wr * di - wi * dr;
+
+        const int j = plan->bitrev[k];
+        zr[j] = er - odd_im;
+        zi[j] = ei + odd_re;
+    }
+
+    fft_complex(plan, zr, zi, 1);
+
+    for (int j = 0; j < n; j++) {
+        output[2 * j] = zr[j];
+        output[2 * j + 1] = zi[j];
+    }
+}
+
+int fft_plan_size(const struct fft_plan *plan) {
+    return plan->size;
+}
+
+void fft_plan_free(struct fft_plan *plan) {
+    if (plan) {
+        free(plan->bitrev);
+        free(plan->twiddle_re);
+        free(plan->twiddle_im);
+        free(plan->split_re);
+        free(plan->split_im);
+        free(plan->work_re);
+        free(plan->work_im);
+        free(plan);
+    }
+}
+
+struct fft_plan *fft_plan_init(int size) {
+    if (size < 4 || (size & (size - 1)) != 0) {
+        fprintf(stderr, "Invalid FFT size: %d\n", size);
+        return NULL;
+    }
+
+    struct fft_plan *plan = calloc(1, sizeof(struct fft_plan));
+    if (!plan) {
+        fprintf(stderr, "Failed to allocate memory for FFT plan\n");
+        return NULL;
+    }
+
+    const int n = size / 2;
+    plan->size = size;
+    plan->half = n;
+    plan->bitrev = fir_memory_alloc(sizeof(int) * n);
+    plan->twiddle_re = fir_memory_alloc(sizeof(float) * n);
+    plan->twiddle_im = fir_memory_alloc(sizeof(float) * n);
+    plan->split_re = fir_memory_alloc(sizeof(float) * n);
+    plan->split_im = fir_memory_alloc(sizeof(float) * n);
+    plan->work_re = fir_memory_alloc(sizeof(float) * n);
+    plan->work_im = fir_memory_alloc(sizeof(float) * n);
+
+    if (!plan->bitrev || !plan->twiddle_re || !plan->twiddle_im || !plan->split_re ||
+        !plan->split_im || !plan->work_re || !plan->work_im) {
+        fprintf(stderr, "Failed to allocate memory for FFT tables\n");
+        fft_plan_free(plan);
+        return NULL;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < n) {
+        bits++;
+    }
+
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        plan->bitrev[i] = r;
+    }
+
+    /* Per-stage twiddles stored back to back so every butterfly loop reads them contiguously. */
+    int offset = 0;
+    for (int len = 2; len <= n; len <<= 1) {
+        for (int k = 0; k < len / 2; k++) {
+            const double angle = -2.0 * M_PI * k / len;
+            plan->twiddle_re[offset + k] = (float) cos(angle);
+            plan->twiddle_im[offset + k] = (float) sin(angle);
+        }
+        offset += len / 2;
+    }
+
+    for (int k = 0; k < n; k++) {
+        const double angle = -2.0 * M_PI * k / size;
+        plan->split_re[k] = (float) cos(angle);
+        plan->split_im[k] = (float) sin(angle);
+    }
+
+    return plan;
+}
@@ -0,0 +1,18 @@
+#ifndef FFT_H
+#define FFT_H
+
+struct fft_plan;
+
+/* Real-input FFT of a power-of-two size; spectra hold size / 2 + 1 bins as split re/im. */
+struct fft_plan *fft_plan_init(int size);
+
+void fft_plan_free(struct fft_plan *plan);
+
+int fft_plan_size(const struct fft_plan *plan);
+
+void fft_forward(struct fft_plan *plan, const float *input, float *re, float *im);
+
+/* Unnormalized: the output is scaled by the transform size. */
+void fft_inverse(struct fft_plan *plan, const float *re, const float *im, float *output);
+
+#endif
@@ -1,5 +1,8 @@
+#include <stdio.h>
+
 #include "fir.h"
 
+#ifndef FIR_NO_BUILTIN_COEFFICIENTS
 extern const float FIR_COEFF_44100[];
 extern const float FIR_COEFF_88200[];
 extern const float FIR_COEFF_176400[];
@@ -7,11 +10,26 @@ extern const float FIR_COEFF_48000[];
 extern const float FIR_COEFF_96000[];
 extern const float FIR_COEFF_192000[];
 
-const struct fir_filter FIR_FILTERS[] = {
-    {44100, FIR_COEFF_44100, 4095},
-    {88200, FIR_COEFF_88200, 8191},
-    {176400, FIR_COEFF_176400, 16383},
-    {48000, FIR_COEFF_48000, 4095},
-    {96000, FIR_COEFF_96000, 8191},
-    {192000, FIR_COEFF_192000, 16383}
+const struct fir_filter FIR_FILTERS[FIR_NUM_FILTERS] = {
+    {.rate = 44100, .coeffs = FIR_COEFF_44100, .order = 4095},
+    {.rate = 88200, .coeffs = FIR_COEFF_88200, .order = 8191},
+    {.rate = 176400, .coeffs = FIR_COEFF_176400, .order = 16383},
+    {.rate = 48000, .coeffs = FIR_COEFF_48000, .order = 4095},
+    {.rate = 96000, .coeffs = FIR_COEFF_96000, .order = 8191},
+    {.rate = 192000, .coeffs = FIR_COEFF_192000, .order = 16383}
 };
+#endif
+
+struct fir_bank *fir_bank_load(const char *path) {
+    if (path) {
+        return fir_bank_map(path);
+    }
+
+#ifdef FIR_NO_BUILTIN_COEFFICIENTS
+    fprintf(stderr, "Built without compiled-in coefficients, a coefficient file is required\n");
+    return NULL;
+#else
+    struct fir_bank *bank = fir_bank_share(FIR_FILTERS, FIR_NUM_FILTERS);
+    return bank ? bank : fir_bank_init(FIR_FILTERS, FIR_NUM_FILTERS);
+#endif
+}
@@ -1,89 +1,496 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
-#include <immintrin.h>
+#include <math.h>
 #include <assert.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#include <pmmintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
 
 #include "fir.h"
+#include "fir_kernels.h"
+
+#define SYMMETRY_TOLERANCE 1e-6f
+#define MULTI_APPLY_BATCH 8
+#define DEFAULT_L1_CACHE_SIZE 32768
+#define HUGE_PAGE_SIZE (2u << 20)
+#define HUGE_PAGE_MIN_BYTES (256u << 10)
+
+/*
+ * Coefficient file: a header and one entry per filter, then each filter's padded layout
+ * (see struct fir_filter) as native floats, starting on a page boundary so mapping the file
+ * only faults in the rates that are used.
+ */
+#define COEFF_FILE_MAGIC "FIRCOEFS"
+#define COEFF_FILE_VERSION 1
+#define COEFF_FILE_BYTE_ORDER 0x01020304u
+#define COEFF_FILE_ALIGNMENT 4096
+#define COEFF_FILE_SYMMETRIC 0x1u
+#define COEFF_FILE_MAX_FILTERS 64
+#define COEFF_FILE_MAX_ORDER (1 << 20)
+
+struct coeff_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t alignment;
+    uint32_t padding;
+    uint32_t num_filters;
+    uint32_t reserved;
+};
+
+struct coeff_file_entry {
+    uint32_t rate;
+    uint32_t order;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t count;
+};
+
+/* Files in the shared directory: this header, padded to keep the data aligned, then the data. */
+#define SHARED_FILE_MAGIC "FIRSHARE"
+#define SHARED_FILE_VERSION 2
+#define SHARED_FILE_HEADER_SIZE FIR_COEFF_ALIGNMENT
+
+struct shared_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t key;
+    uint64_t size;
+    uint64_t checksum;
+    uint32_t precision;
+    uint32_t order;
+};
+
+static const struct fir_kernel *active_kernel;
+static int realtime_memory;
+static char *share_dir;
+
+/* In order of preference; the broadcast and tiled variants are only used when selected by name. */
+static const struct fir_kernel *const fir_kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    &FIR_KERNEL_AVX512,
+    &FIR_KERNEL_AVX2,
+    &FIR_KERNEL_SSE,
+#elif defined(__aarch64__)
+    &FIR_KERNEL_NEON,
+#endif
+    &FIR_KERNEL_SCALAR,
+#if defined(__x86_64__) || defined(__i386__)
+    &FIR_KERNEL_AVX512_BROADCAST,
+    &FIR_KERNEL_AVX2_BROADCAST,
+    &FIR_KERNEL_AVX512_TILED,
+    &FIR_KERNEL_AVX2_TILED,
+#endif
+};
+
+#define NUM_FIR_KERNELS ((int) (sizeof(fir_kernels) / sizeof(fir_kernels[0])))
 
-#define SIMD_WIDTH_AVX512 16
-#define OUTPUT_UNROLL_FACTOR 4
+static int kernel_supported(const struct fir_kernel *kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (kernel == &FIR_KERNEL_AVX512 || kernel == &FIR_KERNEL_AVX512_BROADCAST ||
+        kernel == &FIR_KERNEL_AVX512_TILED) {
+        return __builtin_cpu_supports("avx512f") != 0;
+    }
+    if (kernel == &FIR_KERNEL_AVX2 || kernel == &FIR_KERNEL_AVX2_BROADCAST ||
+        kernel == &FIR_KERNEL_AVX2_TILED) {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+               __builtin_cpu_supports("f16c");
+    }
+    if (kernel == &FIR_KERNEL_SSE) {
+        return __builtin_cpu_supports("sse2") != 0;
+    }
+#elif defined(__aarch64__)
+    if (kernel == &FIR_KERNEL_NEON) {
+        return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+    }
+#endif
+    return kernel == &FIR_KERNEL_SCALAR;
+}
 
-static void fir_filter_apply_scalar(int len, const float *coeff, int count,
-                                    const float *samples, float *output) {
-    for (int i = 0; i < count; i++) {
-        float sum = 0.0f;
-        for (int j = 0; j < len; j++) {
-            sum += coeff[j] * samples[i + j];
+static const struct fir_kernel *select_kernel(void) {
+    for (int i = 0; i < NUM_FIR_KERNELS; i++) {
+        if (kernel_supported(fir_kernels[i])) {
+            return fir_kernels[i];
         }
-        output[i] = sum;
     }
+    return &FIR_KERNEL_SCALAR;
 }
 
-static void fir_filter_apply_avx512(int len, const float *coeff, int count,
-                                    const float *samples, float *output) {
-    const int vectorized_len = (len / SIMD_WIDTH_AVX512) * SIMD_WIDTH_AVX512;
-    const int vectorized_count = (count / OUTPUT_UNROLL_FACTOR) * OUTPUT_UNROLL_FACTOR;
+static const struct fir_kernel *get_kernel(void) {
+    if (!active_kernel) {
+        active_kernel = select_kernel();
+    }
+    return active_kernel;
+}
 
-    for (int i = 0; i < vectorized_count; i += OUTPUT_UNROLL_FACTOR) {
-        __m512 sum_vec0 = _mm512_setzero_ps();
-        __m512 sum_vec1 = _mm512_setzero_ps();
-        __m512 sum_vec2 = _mm512_setzero_ps();
-        __m512 sum_vec3 = _mm512_setzero_ps();
+static int l1_cache_size(void) {
+    static int size;
 
-        for (int j = 0; j < vectorized_len; j += SIMD_WIDTH_AVX512) {
-            __m512 coeff_vec = _mm512_loadu_ps(&coeff[j]);
+    if (!size) {
+        const long detected = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+        size = detected > 0 ? (int) detected : DEFAULT_L1_CACHE_SIZE;
+    }
+    return size;
+}
+
+int fir_tile_taps(int taps, int count, int streams) {
+    const int size = l1_cache_size() / (int) sizeof(float);
+
+    /* Filters whose taps and windows already fit in L1 gain nothing from tiling. */
+    if (taps + streams * (taps + count) <= size) {
+        return taps > count ? taps : count;
+    }
+
+    /* A block of taps plus streams windows of a block of taps and a tile of outputs each. */
+    const int block = size / 2 / (1 + 2 * streams) / FIR_COEFF_PADDING * FIR_COEFF_PADDING;
+    return block > FIR_COEFF_PADDING ? block : FIR_COEFF_PADDING;
+}
 
-            __m512 samples_vec0 = _mm512_loadu_ps(&samples[i + 0 + j]);
-            __m512 samples_vec1 = _mm512_loadu_ps(&samples[i + 1 + j]);
-            __m512 samples_vec2 = _mm512_loadu_ps(&samples[i + 2 + j]);
-            __m512 samples_vec3 = _mm512_loadu_ps(&samples[i + 3 + j]);
+const char *fir_kernel_name(void) {
+    return get_kernel()->name;
+}
+
+void fir_flush_denormals(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    const unsigned int csr = _mm_getcsr();
+    const unsigned int flush = _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON;
 
-            sum_vec0 = _mm512_fmadd_ps(coeff_vec, samples_vec0, sum_vec0);
-            sum_vec1 = _mm512_fmadd_ps(coeff_vec, samples_vec1, sum_vec1);
-            sum_vec2 = _mm512_fmadd_ps(coeff_vec, samples_vec2, sum_vec2);
-            sum_vec3 = _mm512_fmadd_ps(coeff_vec, samples_vec3, sum_vec3);
+    if ((csr & flush) != flush) {
+        _mm_setcsr(csr | flush);
+    }
+#elif defined(__aarch64__)
+    /* FPCR.FZ flushes both denormal inputs and results for single precision. */
+    unsigned long fpcr;
+    __asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+    if (!(fpcr & (1ul << 24))) {
+        __asm__ volatile("msr fpcr, %0" : : "r"(fpcr | (1ul << 24)));
+    }
+#endif
+}
+
+int fir_kernel_count(void) {
+    int count = 0;
+    for (int i = 0; i < NUM_FIR_KERNELS; i++) {
+        count += kernel_supported(fir_kernels[i]);
+    }
+    return count;
+}
+
+const char *fir_kernel_name_at(int index) {
+    for (int i = 0; i < NUM_FIR_KERNELS; i++) {
+        if (kernel_supported(fir_kernels[i]) && index-- == 0) {
+            return fir_kernels[i]->name;
         }
+    }
+    return NULL;
+}
 
-        float sum0 = _mm512_reduce_add_ps(sum_vec0);
-        float sum1 = _mm512_reduce_add_ps(sum_vec1);
-        float sum2 = _mm512_reduce_add_ps(sum_vec2);
-        float sum3 = _mm512_reduce_add_ps(sum_vec3);
+int fir_kernel_select(const char *name) {
+    if (!name) {
+        active_kernel = select_kernel();
+        return 0;
+    }
 
-        for (int j = vectorized_len; j < len; j++) {
-            float c = coeff[j];
-            sum0 += c * samples[i + 0 + j];
-            sum1 += c * samples[i + 1 + j];
-            sum2 += c * samples[i + 2 + j];
-            sum3 += c * samples[i + 3 + j];
+    for (int i = 0; i < NUM_FIR_KERNELS; i++) {
+        if (strcmp(fir_kernels[i]->name, name) == 0) {
+            if (!kernel_supported(fir_kernels[i])) {
+                fprintf(stderr, "FIR kernel %s is not supported on this CPU\n", name);
+                return -1;
+            }
+            active_kernel = fir_kernels[i];
+            return 0;
         }
+    }
 
-        output[i + 0] = sum0;
-        output[i + 1] = sum1;
-        output[i + 2] = sum2;
-        output[i + 3] = sum3;
+    fprintf(stderr, "Unknown FIR kernel: %s\n", name);
+    return -1;
+}
+
+void fir_memory_set_realtime(int enable) {
+    realtime_memory = enable;
+}
+
+/* mlock also faults the range in, which covers read-only mappings that cannot be written. */
+static void lock_memory(const void *ptr, size_t size) {
+    static int warned;
+
+    if (mlock(ptr, size) != 0 && !warned) {
+        fprintf(stderr, "Failed to lock filter memory (%s), raise RLIMIT_MEMLOCK to keep it resident\n",
+                strerror(errno));
+        warned = 1;
+    }
+}
+
+/* Writing every page faults it in even when it cannot be locked. */
+static void prefault_memory(void *ptr, size_t size) {
+    memset(ptr, 0, size);
+    lock_memory(ptr, size);
+}
+
+void *fir_memory_alloc(size_t size) {
+    void *ptr = NULL;
+
+    size = size > 0 ? size : 1;
+    /* Large buffers get whole huge pages of their own; the rest would mostly waste them. */
+    if (realtime_memory && size >= HUGE_PAGE_MIN_BYTES) {
+        const size_t rounded = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+        if (posix_memalign(&ptr, HUGE_PAGE_SIZE, rounded) == 0) {
+            madvise(ptr, rounded, MADV_HUGEPAGE);
+            size = rounded;
+        } else {
+            ptr = NULL;
+        }
+    }
+    if (!ptr && posix_memalign(&ptr, FIR_COEFF_ALIGNMENT, size) != 0) {
+        return NULL;
+    }
+
+    if (realtime_memory) {
+        prefault_memory(ptr, size);
+    } else {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+int fir_share_set_dir(const char *path) {
+    char *copy = NULL;
+
+    if (path) {
+        if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Failed to create shared directory %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+        copy = strdup(path);
+        if (!copy) {
+            return -1;
+        }
+    }
+
+    free(share_dir);
+    share_dir = copy;
+    return 0;
+}
+
+const char *fir_share_dir(void) {
+    return share_dir;
+}
+
+uint64_t fir_hash(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
     }
+    return hash;
+}
+
+static int shared_header_matches(const struct shared_file_header *header,
+                                 const struct shared_file_header *want) {
+    return memcmp(header->magic, want->magic, sizeof(header->magic)) == 0 &&
+           header->version == want->version && header->byte_order == want->byte_order &&
+           header->key == want->key && header->size == want->size &&
+           header->precision == want->precision && header->order == want->order;
+}
 
-    for (int i = vectorized_count; i < count; i++) {
-        __m512 sum_vec = _mm512_setzero_ps();
+/* The header is read and checked before anything is mapped, and the data must match its checksum. */
+static const void *map_shared_file(const char *path, const struct shared_file_header *want) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
 
-        for (int j = 0; j < vectorized_len; j += SIMD_WIDTH_AVX512) {
-            __m512 coeff_vec = _mm512_loadu_ps(&coeff[j]);
-            __m512 samples_vec = _mm512_loadu_ps(&samples[i + j]);
-            sum_vec = _mm512_fmadd_ps(coeff_vec, samples_vec, sum_vec);
+    const size_t bytes = SHARED_FILE_HEADER_SIZE + want->size;
+    struct shared_file_header header;
+    struct stat st;
+    char *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size == bytes &&
+        pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+        shared_header_matches(&header, want)) {
+        map = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (fir_hash(FIR_HASH_INIT, map + SHARED_FILE_HEADER_SIZE, want->size) != header.checksum) {
+        munmap(map, bytes);
+        return NULL;
+    }
+    if (realtime_memory) {
+        lock_memory(map, bytes);
+    }
+    return map + SHARED_FILE_HEADER_SIZE;
+}
+
+/*
+ * Filled in under a unique name and linked into place, so nobody maps a partial file. When
+ * another instance linked its copy first, that one is used; a copy that does not check out is
+ * replaced by ours.
+ */
+static const void *create_shared_file(const char *path, const struct shared_file_header *want,
+                                      int (*fill)(void *data, void *context), void *context) {
+    char *tmp_path = NULL;
+    if (asprintf(&tmp_path, "%s.XXXXXX", path) < 0) {
+        return NULL;
+    }
+
+    /* mkostemp creates the file with O_EXCL and mode 0600. */
+    const size_t bytes = SHARED_FILE_HEADER_SIZE + want->size;
+    const int fd = mkostemp(tmp_path, O_CLOEXEC);
+    char *map = MAP_FAILED;
+
+    if (fd >= 0 && ftruncate(fd, (off_t) bytes) == 0) {
+        map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to create shared file %s: %s\n", tmp_path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp_path);
         }
+        free(tmp_path);
+        return NULL;
+    }
+    close(fd);
+
+    if (fill(map + SHARED_FILE_HEADER_SIZE, context) != 0) {
+        munmap(map, bytes);
+        unlink(tmp_path);
+        free(tmp_path);
+        return NULL;
+    }
+
+    struct shared_file_header header = *want;
+    header.checksum = fir_hash(FIR_HASH_INIT, map + SHARED_FILE_HEADER_SIZE, want->size);
+    memcpy(map, &header, sizeof(header));
+    mprotect(map, bytes, PROT_READ);
+    if (realtime_memory) {
+        lock_memory(map, bytes);
+    }
+
+    const void *data = map + SHARED_FILE_HEADER_SIZE;
+    const int linked = link(tmp_path, path) == 0;
+    const int error = linked ? 0 : errno;
+    const void *other = error == EEXIST ? map_shared_file(path, want) : NULL;
+
+    if (other) {
+        munmap(map, bytes);
+        data = other;
+    } else if (error == EEXIST && rename(tmp_path, path) == 0) {
+        free(tmp_path);
+        return data;
+    } else if (!linked) {
+        fprintf(stderr, "Failed to share %s, keeping a private copy: %s\n", path, strerror(error));
+    }
+
+    unlink(tmp_path);
+    free(tmp_path);
+    return data;
+}
 
-        float sum = _mm512_reduce_add_ps(sum_vec);
+const void *fir_share_map(const char *name, uint64_t key, enum fir_precision precision, int order, size_t size,
+                          int (*fill)(void *data, void *context), void *context) {
+    char *path = NULL;
 
-        for (int j = vectorized_len; j < len; j++) {
-            sum += coeff[j] * samples[i + j];
+    if (!share_dir || size == 0 || asprintf(&path, "%s/%s", share_dir, name) < 0) {
+        return NULL;
+    }
+
+    const struct shared_file_header want = {
+        .magic = SHARED_FILE_MAGIC,
+        .version = SHARED_FILE_VERSION,
+        .byte_order = COEFF_FILE_BYTE_ORDER,
+        .key = key,
+        .size = size,
+        .precision = (uint32_t) precision,
+        .order = (uint32_t) order,
+    };
+    const void *data = map_shared_file(path, &want);
+    if (!data) {
+        data = create_shared_file(path, &want, fill, context);
+    }
+
+    free(path);
+    return data;
+}
+
+void fir_share_unmap(const void *data, size_t size) {
+    if (data) {
+        munmap((char *) data - SHARED_FILE_HEADER_SIZE, SHARED_FILE_HEADER_SIZE + size);
+    }
+}
+
+/*
+ * The kernel for the filter's 16-bit table, or NULL to run from the FP32 coefficients. Kernels
+ * without 16-bit variants take the scalar ones, so every kernel sees the same rounded taps.
+ */
+static fir_half_kernel_fn half_kernel(const struct fir_kernel *kernel, const struct fir_filter *filter) {
+    if (!filter->half_coeffs) {
+        return NULL;
+    }
+
+    const int fp16 = filter->precision == FIR_PRECISION_FP16;
+    const struct fir_half_kernels *half = fp16 ? &kernel->fp16 : &kernel->bf16;
+
+    if (!half->apply) {
+        half = fp16 ? &FIR_KERNEL_SCALAR.fp16 : &FIR_KERNEL_SCALAR.bf16;
+    }
+    return filter->folded_coeffs ? half->apply_folded : half->apply;
+}
+
+/* Half tables have the same layout as the FP32 ones, so they take the same window. */
+static void apply_half(fir_half_kernel_fn half, const struct fir_filter *filter,
+                       const struct delay_line *const *delay_lines, int num_channels, int count,
+                       float *const *outputs) {
+    const float *samples[MULTI_APPLY_BATCH];
+    const int len = filter->folded_coeffs ? filter->order : filter->padded_order;
+
+    for (int first = 0; first < num_channels; first += MULTI_APPLY_BATCH) {
+        int batch = num_channels - first;
+        if (batch > MULTI_APPLY_BATCH) {
+            batch = MULTI_APPLY_BATCH;
         }
 
-        output[i] = sum;
+        for (int ch = 0; ch < batch; ch++) {
+            const struct delay_line *delay_line = delay_lines[first + ch];
+            samples[ch] = delay_line->buffer + delay_line->index - len - count;
+        }
+
+        half(len, filter->half_coeffs, count, batch, samples, outputs + first);
     }
 }
 
+/* The kernel instance built for the filter's order, or NULL to take the generic one. */
+static fir_multi_kernel_fn fixed_kernel(const struct fir_kernel *kernel, const struct fir_filter *filter) {
+    if (!filter->padded_coeffs) {
+        return NULL;
+    }
+
+    const struct fir_fixed_kernels *fixed = &kernel->fixed[filter->fixed_order];
+    return filter->folded_coeffs ? fixed->apply_folded : fixed->apply;
+}
+
 void fir_filter_apply(const struct fir_filter *filter, const struct delay_line *delay_line,
                       int count, float *output) {
     if (!filter || !delay_line || !output || count <= 0) {
@@ -92,42 +499,201 @@ void fir_filter_apply(const struct fir_filter *filter, const struct delay_line *
 
     const float *samples = delay_line->buffer + delay_line->index - filter->order - count;
 
-#ifdef __AVX512F__
-    fir_filter_apply_avx512(filter->order, filter->coeffs, count, samples, output);
-#else
-    fir_filter_apply_scalar(filter->order, filter->coeffs, count, samples, output);
-#endif
+    const struct fir_kernel *kernel = get_kernel();
+    const fir_half_kernel_fn half = half_kernel(kernel, filter);
+    const fir_multi_kernel_fn fixed = fixed_kernel(kernel, filter);
+
+    if (half) {
+        apply_half(half, filter, &delay_line, 1, count, &output);
+    } else if (fixed) {
+        const int len = filter->folded_coeffs ? filter->order : filter->padded_order;
+        const float *coeffs = filter->folded_coeffs ? filter->folded_coeffs : filter->padded_coeffs;
+        const float *window = samples - (len - filter->order);
+
+        fixed(len, coeffs, count, 1, &window, &output);
+    } else if (filter->folded_coeffs) {
+        kernel->apply_folded(filter->order, filter->folded_coeffs, count, samples, output);
+    } else if (filter->padded_coeffs) {
+        /* The leading zeros line up with samples older than the window, so they add nothing. */
+        kernel->apply_aligned(filter->padded_order, filter->padded_coeffs, count,
+                              samples - (filter->padded_order - filter->order), output);
+    } else {
+        kernel->apply(filter->order, filter->coeffs, count, samples, output);
+    }
 }
 
-void delay_line_append_samples(const struct fir_filter *filter, struct delay_line *delay_line,
-                               const float *samples, int count) {
-    if (!filter || !delay_line || !samples || count <= 0) {
+void fir_filter_apply_multi(const struct fir_filter *filter,
+                            const struct delay_line *const *delay_lines, int num_channels,
+                            int count, float *const *outputs) {
+    if (!filter || !delay_lines || !outputs || num_channels <= 0 || count <= 0) {
         return;
     }
 
-    float *buffer_write = delay_line->buffer + delay_line->index;
-    float *buffer_mirror = buffer_write - (filter->order * 2);
-    const float *buffer_end = delay_line->buffer + delay_line->size;
+    const struct fir_kernel *kernel = get_kernel();
+    fir_multi_kernel_fn multi = filter->folded_coeffs ? kernel->apply_folded_multi : kernel->apply_multi;
+    const fir_multi_kernel_fn fixed = fixed_kernel(kernel, filter);
+    const fir_half_kernel_fn half = half_kernel(kernel, filter);
+
+    if (half) {
+        apply_half(half, filter, delay_lines, num_channels, count, outputs);
+        return;
+    }
+    if (!multi || !filter->padded_coeffs) {
+        for (int ch = 0; ch < num_channels; ch++) {
+            fir_filter_apply(filter, delay_lines[ch], count, outputs[ch]);
+        }
+        return;
+    }
+
+    const float *samples[MULTI_APPLY_BATCH];
+    const float *coeffs = filter->folded_coeffs ? filter->folded_coeffs : filter->padded_coeffs;
+    const int len = filter->folded_coeffs ? filter->order : filter->padded_order;
+
+    for (int first = 0; first < num_channels; first += MULTI_APPLY_BATCH) {
+        int batch = num_channels - first;
+        if (batch > MULTI_APPLY_BATCH) {
+            batch = MULTI_APPLY_BATCH;
+        }
+
+        for (int ch = 0; ch < batch; ch++) {
+            const struct delay_line *delay_line = delay_lines[first + ch];
+            samples[ch] = delay_line->buffer + delay_line->index - len - count;
+        }
+
+        (fixed ? fixed : multi)(len, coeffs, count, batch, samples, outputs + first);
+    }
+}
+
+void fir_filter_apply_segment(const struct fir_filter *filter, const struct delay_line *delay_line,
+                              int first_tap, int num_taps, int count, float *output) {
+    if (!filter || !delay_line || !output || count <= 0 || first_tap < 0 || num_taps <= 0 ||
+        first_tap + num_taps > filter->order) {
+        return;
+    }
+
+    const float *samples = delay_line->buffer + delay_line->index - filter->order - count + first_tap;
+
+    get_kernel()->apply(num_taps, filter->coeffs + first_tap, count, samples, output);
+}
+
+void delay_line_append_samples(struct delay_line *delay_line, const float *samples, int count) {
+    if (!delay_line || !samples || count <= 0) {
+        return;
+    }
+
+    const size_t size = delay_line->size;
+
+    /* Only the newest size samples can be kept; older ones would be overwritten anyway. */
+    if ((size_t) count > size) {
+        samples += count - size;
+        delay_line->index = size + (delay_line->index - size + count - size) % size;
+        count = (int) size;
+    }
+
+    const size_t write = delay_line->index - size;
+
+    if (delay_line->mapped) {
+        memcpy(delay_line->buffer + write, samples, sizeof(float) * count);
+    } else {
+        const size_t first = size - write < (size_t) count ? size - write : (size_t) count;
+
+        memcpy(delay_line->buffer + write, samples, sizeof(float) * first);
+        memcpy(delay_line->buffer + size + write, samples, sizeof(float) * first);
+        memcpy(delay_line->buffer, samples + first, sizeof(float) * (count - first));
+        memcpy(delay_line->buffer + size, samples + first, sizeof(float) * (count - first));
+    }
+
+    delay_line->index = size + (write + count) % size;
+}
+
+int fir_filter_detect_symmetry(const float *coeffs, int order) {
+    if (!coeffs || order <= 1) {
+        return 0;
+    }
+
+    float peak = 0.0f;
+    for (int i = 0; i < order; i++) {
+        peak = fmaxf(peak, fabsf(coeffs[i]));
+    }
+
+    /* The tables are printed with ten decimals, so mirrored taps may differ in the last digit. */
+    const float tolerance = peak * SYMMETRY_TOLERANCE;
+    for (int i = 0; i < order / 2; i++) {
+        if (fabsf(coeffs[i] - coeffs[order - 1 - i]) > tolerance) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int padded_length(int len) {
+    return (len + FIR_COEFF_PADDING - 1) / FIR_COEFF_PADDING * FIR_COEFF_PADDING;
+}
+
+static int can_fold(const struct fir_filter *filter) {
+    return filter->order >= 2 * FIR_COEFF_PADDING &&
+           fir_filter_detect_symmetry(filter->coeffs, filter->order);
+}
+
+static size_t coeff_layout_size(const struct fir_filter *filter, int folded) {
+    return padded_length(filter->order) + (folded ? fir_folded_taps(filter->order) : 0);
+}
+
+#define FIXED_ORDER_ENTRY(order) order,
+
+static const int FIXED_ORDERS[FIR_NUM_FIXED_ORDERS] = {FIR_FIXED_ORDERS(FIXED_ORDER_ENTRY)};
+
+static int fixed_order_slot(int order) {
+    for (int i = 0; i < FIR_NUM_FIXED_ORDERS; i++) {
+        if (FIXED_ORDERS[i] == order) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void attach_coeff_layout(struct fir_filter *dst, int rate, int order, int folded,
+                                const float *storage) {
+    const int padded_order = padded_length(order);
+
+    dst->rate = rate;
+    dst->order = order;
+    dst->coeffs = storage + (padded_order - order);
+    dst->padded_coeffs = storage;
+    dst->padded_order = padded_order;
+    dst->symmetric = folded;
+    dst->folded_coeffs = folded ? storage + padded_order : NULL;
+    dst->precision = FIR_PRECISION_FP32;
+    dst->half_coeffs = NULL;
+    dst->fixed_order = fixed_order_slot(order);
+}
+
+static void fill_coeff_layout(struct fir_filter *dst, const struct fir_filter *src, int folded,
+                              float *storage) {
+    const int order = src->order;
+    const int padded_order = padded_length(order);
+    const int padding = padded_order - order;
 
-    for (int i = 0; i < count; i++) {
-        *buffer_write = samples[i];
-        *buffer_mirror = samples[i];
+    memset(storage, 0, sizeof(float) * padding);
+    memcpy(storage + padding, src->coeffs, sizeof(float) * order);
 
-        buffer_write++;
-        buffer_mirror++;
+    if (folded) {
+        float *folded_coeffs = storage + padded_order;
 
-        if (buffer_write == buffer_end) {
-            buffer_write = buffer_mirror;
-            buffer_mirror = delay_line->buffer;
+        memset(folded_coeffs, 0, sizeof(float) * fir_folded_taps(order));
+        memcpy(folded_coeffs, src->coeffs, sizeof(float) * (order / 2));
+        if (order & 1) {
+            folded_coeffs[order / 2] = 0.5f * src->coeffs[order / 2];
         }
     }
 
-    delay_line->index = buffer_write - delay_line->buffer;
+    attach_coeff_layout(dst, src->rate, order, folded, storage);
 }
 
 void fir_filter_free(const struct fir_filter *filter) {
     if (filter) {
-        free((void *) filter->coeffs);
+        free((void *) filter->padded_coeffs);
         free((void *) filter);
     }
 }
@@ -143,25 +709,501 @@ struct fir_filter *fir_filter_clone(const struct fir_filter *filter) {
         return NULL;
     }
 
-    float *coeffs_copy = malloc(sizeof(float) * filter->order);
-    if (!coeffs_copy) {
+    const int folded = can_fold(filter);
+    float *storage = fir_memory_alloc(sizeof(float) * coeff_layout_size(filter, folded));
+    if (!storage) {
         fprintf(stderr, "Failed to allocate memory for FIR filter coefficients\n");
         free(new_filter);
         return NULL;
     }
 
-    memcpy(coeffs_copy, filter->coeffs, sizeof(float) * filter->order);
-
-    new_filter->order = filter->order;
-    new_filter->rate = filter->rate;
-    new_filter->coeffs = coeffs_copy;
+    fill_coeff_layout(new_filter, filter, folded, storage);
 
     return new_filter;
 }
 
+void fir_bank_free(struct fir_bank *bank) {
+    if (bank) {
+        if (bank->mapping) {
+            munmap(bank->mapping, bank->mapping_size);
+        }
+        free(bank->filters);
+        free(bank->storage);
+        free(bank->half_storage);
+        free(bank);
+    }
+}
+
+static const char *const PRECISION_NAMES[FIR_NUM_PRECISIONS] = {"fp32", "fp16", "bf16"};
+
+const char *fir_precision_name(enum fir_precision precision) {
+    return precision >= 0 && precision < FIR_NUM_PRECISIONS ? PRECISION_NAMES[precision] : "unknown";
+}
+
+int fir_precision_from_name(const char *name, enum fir_precision *precision) {
+    for (int i = 0; i < FIR_NUM_PRECISIONS; i++) {
+        if (strcmp(name, PRECISION_NAMES[i]) == 0) {
+            *precision = (enum fir_precision) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/* Round to nearest even on the dropped 16 bits; NaN keeps a mantissa bit so it stays NaN. */
+static uint16_t float_to_bf16(float value) {
+    const uint32_t bits = float_bits(value);
+
+    if ((bits & 0x7fffffff) > 0x7f800000) {
+        return (uint16_t) ((bits >> 16) | 0x40);
+    }
+    return (uint16_t) ((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+}
+
+static uint16_t float_to_fp16(float value) {
+    const uint32_t bits = float_bits(value);
+    const uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7fffffff;
+
+    if (magnitude > 0x7f800000) {
+        return sign | 0x7e00;
+    }
+    if (magnitude >= 0x477ff000) {
+        /* At or past 65520 rounds to infinity. */
+        return sign | 0x7c00;
+    }
+    if (magnitude < 0x38800000) {
+        /* Below the smallest normal half: scale into the 2^-24 subnormal steps and round. */
+        float scaled;
+        const uint32_t abs_bits = magnitude;
+        memcpy(&scaled, &abs_bits, sizeof(scaled));
+        return sign | (uint16_t) lrintf(scaled * 16777216.0f);
+    }
+
+    const uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+    return sign | (uint16_t) ((rounded - 0x38000000) >> 13);
+}
+
+float fir_precision_round(float value, enum fir_precision precision) {
+    switch (precision) {
+        case FIR_PRECISION_FP16:
+            return fir_fp16_to_float(float_to_fp16(value));
+        case FIR_PRECISION_BF16:
+            return fir_bf16_to_float(float_to_bf16(value));
+        case FIR_PRECISION_FP32:
+        default:
+            return value;
+    }
+}
+
+/* The table the direct kernels read: folded taps for symmetric filters, padded ones otherwise. */
+static int direct_taps(const struct fir_filter *filter) {
+    return filter->folded_coeffs ? fir_folded_taps(filter->order) : filter->padded_order;
+}
+
+int fir_bank_set_precision(struct fir_bank *bank, enum fir_precision precision) {
+    if (!bank || precision < 0 || precision >= FIR_NUM_PRECISIONS) {
+        fprintf(stderr, "Invalid coefficient precision\n");
+        return -1;
+    }
+
+    uint16_t *storage = NULL;
+    if (precision != FIR_PRECISION_FP32) {
+        size_t total = 0;
+        for (int i = 0; i < bank->num_filters; i++) {
+            total += direct_taps(&bank->filters[i]);
+        }
+
+        storage = fir_memory_alloc(sizeof(uint16_t) * total);
+        if (!storage) {
+            fprintf(stderr, "Failed to allocate memory for %s coefficients\n", fir_precision_name(precision));
+            return -1;
+        }
+    }
+
+    uint16_t *next = storage;
+    for (int i = 0; i < bank->num_filters; i++) {
+        struct fir_filter *filter = &bank->filters[i];
+        const float *taps = filter->folded_coeffs ? filter->folded_coeffs : filter->padded_coeffs;
+        const int count = direct_taps(filter);
+
+        filter->precision = precision;
+        filter->half_coeffs = next;
+        if (!next) {
+            continue;
+        }
+        for (int j = 0; j < count; j++) {
+            next[j] = precision == FIR_PRECISION_FP16 ? float_to_fp16(taps[j]) : float_to_bf16(taps[j]);
+        }
+        next += count;
+    }
+
+    free(bank->half_storage);
+    bank->half_storage = storage;
+    return 0;
+}
+
+struct fir_bank *fir_bank_init(const struct fir_filter *filters, int num_filters) {
+    if (!filters || num_filters <= 0) {
+        fprintf(stderr, "Invalid FIR bank size: %d\n", num_filters);
+        return NULL;
+    }
+
+    struct fir_bank *bank = calloc(1, sizeof(struct fir_bank));
+    if (!bank) {
+        fprintf(stderr, "Failed to allocate memory for FIR bank\n");
+        return NULL;
+    }
+
+    bank->filters = calloc(num_filters, sizeof(struct fir_filter));
+    if (!bank->filters) {
+        fprintf(stderr, "Failed to allocate memory for FIR bank filters\n");
+        fir_bank_free(bank);
+        return NULL;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < num_filters; i++) {
+        bank->filters[i].symmetric = can_fold(&filters[i]);
+        total += coeff_layout_size(&filters[i], bank->filters[i].symmetric);
+    }
+
+    bank->storage = fir_memory_alloc(sizeof(float) * total);
+    if (!bank->storage) {
+        fprintf(stderr, "Failed to allocate memory for FIR bank coefficients\n");
+        fir_bank_free(bank);
+        return NULL;
+    }
+    bank->num_filters = num_filters;
+
+    float *next = bank->storage;
+    for (int i = 0; i < num_filters; i++) {
+        const int folded = bank->filters[i].symmetric;
+        fill_coeff_layout(&bank->filters[i], &filters[i], folded, next);
+        next += coeff_layout_size(&filters[i], folded);
+    }
+
+    return bank;
+}
+
+static int check_coeff_entry(const struct coeff_file_entry *entry, size_t file_size) {
+    if (entry->rate == 0 || entry->rate > INT32_MAX || entry->order == 0 ||
+        entry->order > COEFF_FILE_MAX_ORDER || entry->offset % COEFF_FILE_ALIGNMENT != 0) {
+        return -1;
+    }
+
+    const int order = (int) entry->order;
+    const int folded = (entry->flags & COEFF_FILE_SYMMETRIC) != 0;
+    const size_t count = padded_length(order) + (folded ? fir_folded_taps(order) : 0);
+
+    if (folded && order < 2 * FIR_COEFF_PADDING) {
+        return -1;
+    }
+    if (entry->count != count || entry->offset > file_size ||
+        count > (file_size - entry->offset) / sizeof(float)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* A bank over the coefficient file image inside mapping, which it unmaps when freed. */
+static struct fir_bank *attach_coeff_file(const char *path, void *mapping, size_t mapping_size,
+                                          const void *image, size_t size) {
+    struct fir_bank *bank = calloc(1, sizeof(struct fir_bank));
+    if (!bank) {
+        fprintf(stderr, "Failed to allocate memory for FIR bank\n");
+        munmap(mapping, mapping_size);
+        return NULL;
+    }
+    bank->mapping = mapping;
+    bank->mapping_size = mapping_size;
+
+    const struct coeff_file_header *header = image;
+    const struct coeff_file_entry *entries = (const struct coeff_file_entry *) (header + 1);
+
+    if (size < sizeof(*header) || memcmp(header->magic, COEFF_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != COEFF_FILE_VERSION || header->byte_order != COEFF_FILE_BYTE_ORDER ||
+        header->alignment != FIR_COEFF_ALIGNMENT || header->padding != FIR_COEFF_PADDING ||
+        header->num_filters == 0 || header->num_filters > COEFF_FILE_MAX_FILTERS ||
+        sizeof(*header) + header->num_filters * sizeof(*entries) > size) {
+        fprintf(stderr, "%s is not a compatible coefficient file\n", path);
+        fir_bank_free(bank);
+        return NULL;
+    }
+
+    bank->filters = calloc(header->num_filters, sizeof(struct fir_filter));
+    if (!bank->filters) {
+        fprintf(stderr, "Failed to allocate memory for FIR bank filters\n");
+        fir_bank_free(bank);
+        return NULL;
+    }
+    bank->num_filters = (int) header->num_filters;
+
+    for (int i = 0; i < bank->num_filters; i++) {
+        const struct coeff_file_entry *entry = &entries[i];
+
+        if (check_coeff_entry(entry, size) != 0) {
+            fprintf(stderr, "%s: invalid entry %d\n", path, i);
+            fir_bank_free(bank);
+            return NULL;
+        }
+        attach_coeff_layout(&bank->filters[i], (int) entry->rate, (int) entry->order,
+                            (entry->flags & COEFF_FILE_SYMMETRIC) != 0,
+                            (const float *) ((const char *) image + entry->offset));
+    }
+
+    return bank;
+}
+
+struct fir_bank *fir_bank_map(const char *path) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open coefficient file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(struct coeff_file_header)) {
+        fprintf(stderr, "%s is not a coefficient file\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    const size_t size = (size_t) st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map coefficient file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    /* Only the taps of rates that are actually played should be read in, unless nothing may fault. */
+    if (realtime_memory) {
+        lock_memory(map, size);
+    } else {
+        madvise(map, size, MADV_RANDOM);
+    }
+
+    return attach_coeff_file(path, map, size, map, size);
+}
+
+static int write_zeros(FILE *file, size_t bytes) {
+    static const char zeros[256];
+
+    while (bytes > 0) {
+        const size_t chunk = bytes < sizeof(zeros) ? bytes : sizeof(zeros);
+        if (fwrite(zeros, 1, chunk, file) != chunk) {
+            return -1;
+        }
+        bytes -= chunk;
+    }
+    return 0;
+}
+
+/* Lays out a coefficient file for filters, folded where folded[i] is set; returns its size in bytes. */
+static uint64_t plan_coeff_file(const struct fir_filter *filters, const int *folded, int num_filters,
+                                struct coeff_file_header *header, struct coeff_file_entry *entries) {
+    *header = (struct coeff_file_header) {
+        .magic = COEFF_FILE_MAGIC,
+        .version = COEFF_FILE_VERSION,
+        .byte_order = COEFF_FILE_BYTE_ORDER,
+        .alignment = FIR_COEFF_ALIGNMENT,
+        .padding = FIR_COEFF_PADDING,
+        .num_filters = (uint32_t) num_filters,
+    };
+    uint64_t offset = sizeof(*header) + sizeof(entries[0]) * num_filters;
+
+    for (int i = 0; i < num_filters; i++) {
+        offset = (offset + COEFF_FILE_ALIGNMENT - 1) / COEFF_FILE_ALIGNMENT * COEFF_FILE_ALIGNMENT;
+        entries[i] = (struct coeff_file_entry) {
+            .rate = (uint32_t) filters[i].rate,
+            .order = (uint32_t) filters[i].order,
+            .flags = folded[i] ? COEFF_FILE_SYMMETRIC : 0,
+            .offset = offset,
+            .count = coeff_layout_size(&filters[i], folded[i]),
+        };
+        offset += entries[i].count * sizeof(float);
+    }
+
+    return offset;
+}
+
+int fir_bank_export(const struct fir_bank *bank, const char *path) {
+    if (!bank || !path || bank->num_filters <= 0 || bank->num_filters > COEFF_FILE_MAX_FILTERS) {
+        fprintf(stderr, "Invalid FIR bank for export\n");
+        return -1;
+    }
+
+    struct coeff_file_header header;
+    struct coeff_file_entry entries[COEFF_FILE_MAX_FILTERS];
+    int folded[COEFF_FILE_MAX_FILTERS];
+
+    for (int i = 0; i < bank->num_filters; i++) {
+        folded[i] = bank->filters[i].folded_coeffs != NULL;
+    }
+    plan_coeff_file(bank->filters, folded, bank->num_filters, &header, entries);
+
+    char *tmp_path = NULL;
+    if (asprintf(&tmp_path, "%s.tmp", path) < 0) {
+        return -1;
+    }
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to create %s: %s\n", tmp_path, strerror(errno));
+        free(tmp_path);
+        return -1;
+    }
+
+    int ret = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(entries, sizeof(entries[0]), bank->num_filters, file) == (size_t) bank->num_filters
+                  ? 0 : -1;
+    uint64_t written = sizeof(header) + sizeof(entries[0]) * bank->num_filters;
+
+    /* The padded and folded taps are adjacent in every bank, see coeff_layout_size. */
+    for (int i = 0; i < bank->num_filters && ret == 0; i++) {
+        const size_t bytes = entries[i].count * sizeof(float);
+
+        if (write_zeros(file, entries[i].offset - written) != 0 ||
+            fwrite(bank->filters[i].padded_coeffs, 1, bytes, file) != bytes) {
+            ret = -1;
+        }
+        written = entries[i].offset + bytes;
+    }
+
+    if (fclose(file) != 0 || ret != 0 || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Failed to write coefficient file %s: %s\n", path, strerror(errno));
+        remove(tmp_path);
+        ret = -1;
+    }
+
+    free(tmp_path);
+    return ret;
+}
+
+struct bank_source {
+    const struct fir_filter *filters;
+    const int *folded;
+    int num_filters;
+};
+
+/* The shared file starts out zeroed, which is all the padding between the layouts needs. */
+static int fill_shared_bank(void *data, void *context) {
+    const struct bank_source *source = context;
+    struct coeff_file_header header;
+    struct coeff_file_entry entries[COEFF_FILE_MAX_FILTERS];
+
+    plan_coeff_file(source->filters, source->folded, source->num_filters, &header, entries);
+    memcpy(data, &header, sizeof(header));
+    memcpy((char *) data + sizeof(header), entries, sizeof(entries[0]) * source->num_filters);
+    for (int i = 0; i < source->num_filters; i++) {
+        struct fir_filter layout;
+
+        fill_coeff_layout(&layout, &source->filters[i], source->folded[i],
+                          (float *) ((char *) data + entries[i].offset));
+    }
+    return 0;
+}
+
+struct fir_bank *fir_bank_share(const struct fir_filter *filters, int num_filters) {
+    if (!share_dir || !filters || num_filters <= 0 || num_filters > COEFF_FILE_MAX_FILTERS) {
+        return NULL;
+    }
+
+    uint64_t key = fir_hash(FIR_HASH_INIT, COEFF_FILE_MAGIC, sizeof(COEFF_FILE_MAGIC));
+    const uint32_t layout[] = {COEFF_FILE_VERSION, FIR_COEFF_ALIGNMENT, FIR_COEFF_PADDING};
+    int folded[COEFF_FILE_MAX_FILTERS];
+    int max_order = 0;
+
+    key = fir_hash(key, layout, sizeof(layout));
+    for (int i = 0; i < num_filters; i++) {
+        key = fir_hash(key, &filters[i].rate, sizeof(filters[i].rate));
+        key = fir_hash(key, &filters[i].order, sizeof(filters[i].order));
+        key = fir_hash(key, filters[i].coeffs, sizeof(float) * filters[i].order);
+        folded[i] = can_fold(&filters[i]);
+        max_order = filters[i].order > max_order ? filters[i].order : max_order;
+    }
+
+    struct coeff_file_header header;
+    struct coeff_file_entry entries[COEFF_FILE_MAX_FILTERS];
+    const size_t size = plan_coeff_file(filters, folded, num_filters, &header, entries);
+    const struct bank_source source = {filters, folded, num_filters};
+    char name[64];
+
+    /* The file holds the FP32 taps; 16-bit tables are always built privately. */
+    snprintf(name, sizeof(name), "bank-%016llx.fir", (unsigned long long) key);
+    const char *image = fir_share_map(name, key, FIR_PRECISION_FP32, max_order, size, fill_shared_bank,
+                                      (void *) &source);
+    if (!image) {
+        return NULL;
+    }
+
+    return attach_coeff_file(name, (void *) (image - SHARED_FILE_HEADER_SIZE), SHARED_FILE_HEADER_SIZE + size,
+                             image, size);
+}
+
+#if defined(__linux__)
+/* With MFD_HUGETLB in flags, bytes must be a multiple of HUGE_PAGE_SIZE. */
+static float *map_mirrored(size_t bytes, unsigned int flags) {
+    const int fd = memfd_create("fir-delay-line", MFD_CLOEXEC | flags);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (ftruncate(fd, (off_t) bytes) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    /* Huge pages can only be mapped at huge page boundaries, so reserve enough to align to one. */
+    const size_t slack = flags & MFD_HUGETLB ? HUGE_PAGE_SIZE : 0;
+    char *reserved = mmap(NULL, bytes * 2 + slack, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    char *base = reserved;
+    if (slack) {
+        base = (char *) (((uintptr_t) reserved + slack - 1) & ~(uintptr_t) (slack - 1));
+        if (base > reserved) {
+            munmap(reserved, (size_t) (base - reserved));
+        }
+        if (reserved + slack > base) {
+            munmap(base + bytes * 2, (size_t) (reserved + slack - base));
+        }
+    }
+
+    if (mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, bytes * 2);
+        close(fd);
+        return NULL;
+    }
+
+    close(fd);
+    return (float *) base;
+}
+#endif
+
 void delay_line_free(struct delay_line *delay_line) {
     if (delay_line) {
+#if defined(__linux__)
+        if (delay_line->mapped) {
+            munmap(delay_line->buffer, sizeof(float) * delay_line->size * 2);
+        } else {
+            free(delay_line->buffer);
+        }
+#else
         free(delay_line->buffer);
+#endif
         free(delay_line);
     }
 }
@@ -172,13 +1214,40 @@ struct delay_line *delay_line_init(size_t size) {
         return NULL;
     }
 
-    struct delay_line *delay_line = malloc(sizeof(struct delay_line));
+    struct delay_line *delay_line = calloc(1, sizeof(struct delay_line));
     if (!delay_line) {
         fprintf(stderr, "Failed to allocate memory for delay line\n");
         return NULL;
     }
 
-    delay_line->buffer = calloc(size, sizeof(float));
+#if defined(__linux__)
+    /* Both halves must start on a page boundary to be mapped onto the same pages. */
+    const size_t huge = HUGE_PAGE_SIZE / sizeof(float);
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE) / sizeof(float);
+
+    if (realtime_memory && sizeof(float) * size >= HUGE_PAGE_MIN_BYTES) {
+        const size_t huge_size = (size + huge - 1) / huge * huge;
+
+        delay_line->buffer = map_mirrored(sizeof(float) * huge_size, MFD_HUGETLB);
+        if (delay_line->buffer) {
+            delay_line->mapped = 1;
+            size = huge_size;
+        }
+    }
+    if (!delay_line->buffer) {
+        const size_t mapped_size = (size + page - 1) / page * page;
+
+        delay_line->buffer = map_mirrored(sizeof(float) * mapped_size, 0);
+        if (delay_line->buffer) {
+            delay_line->mapped = 1;
+            size = mapped_size;
+        }
+    }
+#endif
+
+    if (!delay_line->buffer) {
+        delay_line->buffer = calloc(size * 2, sizeof(float));
+    }
     if (!delay_line->buffer) {
         fprintf(stderr, "Failed to allocate memory for delay line buffer\n");
         free(delay_line);
@@ -186,7 +1255,10 @@ struct delay_line *delay_line_init(size_t size) {
     }
 
     delay_line->size = size;
-    delay_line->index = size - 1;
+    delay_line->index = size;
+    if (realtime_memory) {
+        prefault_memory(delay_line->buffer, sizeof(float) * size * 2);
+    }
 
     return delay_line;
 }
@@ -2,31 +2,163 @@
 #define FIR_H
 
 #include <stddef.h>
+#include <stdint.h>
 
+#define FIR_COEFF_ALIGNMENT 64
+#define FIR_COEFF_PADDING 16
+
+/* Storage of the coefficients the direct kernels read; the arithmetic stays in FP32. */
+enum fir_precision {
+    FIR_PRECISION_FP32,
+    FIR_PRECISION_FP16,
+    FIR_PRECISION_BF16,
+};
+
+#define FIR_NUM_PRECISIONS 3
+
+/*
+ * Filters built by fir_filter_clone or a fir_bank also carry padded_coeffs: the taps behind
+ * zeros up to a multiple of FIR_COEFF_PADDING, aligned to FIR_COEFF_ALIGNMENT, with coeffs
+ * pointing into it. Symmetric filters add folded_coeffs, the first half with the middle tap
+ * halved, padded the same way. A bank set to a 16-bit precision adds half_coeffs, a rounded
+ * copy of folded_coeffs if there are any and of padded_coeffs otherwise. fixed_order is 1 plus
+ * the index of order among the shipped orders the kernels are specialised for, or 0.
+ */
 struct fir_filter {
     int rate;
     const float *coeffs;
     int order;
+    int symmetric;
+    const float *padded_coeffs;
+    int padded_order;
+    const float *folded_coeffs;
+    enum fir_precision precision;
+    const uint16_t *half_coeffs;
+    int fixed_order;
 };
 
+struct fir_bank {
+    struct fir_filter *filters;
+    int num_filters;
+    float *storage;
+    uint16_t *half_storage;
+    void *mapping;
+    size_t mapping_size;
+};
+
+/*
+ * A ring of size samples stored twice back to back, so the size samples before buffer + index
+ * are always contiguous. index stays in [size, 2 * size); where possible both halves map the
+ * same memfd pages and an append is a single memcpy.
+ */
 struct delay_line {
     float *buffer;
     size_t size;
     size_t index;
+    int mapped;
 };
 
-extern const struct fir_filter FIR_FILTERS[];
+#define FIR_NUM_FILTERS 6
+
+extern const struct fir_filter FIR_FILTERS[FIR_NUM_FILTERS];
+
+const char *fir_kernel_name(void);
+
+/* Kernels usable on this CPU, indexed from 0 to fir_kernel_count() - 1. */
+int fir_kernel_count(void);
+
+const char *fir_kernel_name_at(int index);
+
+/* Not thread-safe against running filters; a NULL name restores the detected default. */
+int fir_kernel_select(const char *name);
+
+/* Treats denormal inputs and results as zero on the calling thread; cheap once already set. */
+void fir_flush_denormals(void);
+
+/*
+ * Real-time memory mode, set before any engine buffers are built: buffers from fir_memory_alloc
+ * and delay lines are then pre-faulted and locked, and large ones come from 2 MB huge pages where
+ * the system provides them, so the processing threads never fault on them.
+ */
+void fir_memory_set_realtime(int enable);
+
+/* Zeroed and aligned to FIR_COEFF_ALIGNMENT; release with free(). */
+void *fir_memory_alloc(size_t size);
+
+/*
+ * Directory through which instances on one host share read-only data as files, created if
+ * missing; NULL, the default, keeps everything private. Put it on a tmpfs such as /dev/shm and
+ * set it before loading banks or building convolvers.
+ */
+int fir_share_set_dir(const char *path);
+
+const char *fir_share_dir(void);
+
+#define FIR_HASH_INIT 0xcbf29ce484222325ull
+
+/* FNV-1a, for keys of shared data: chain calls starting from FIR_HASH_INIT. */
+uint64_t fir_hash(uint64_t hash, const void *data, size_t size);
+
+/*
+ * size bytes the file name in the shared directory holds, mapped read-only and aligned to
+ * FIR_COEFF_ALIGNMENT. The first instance to ask creates the file, filling it in with fill;
+ * later ones map it, provided it was made for the same key, precision and order and its data
+ * still matches the checksum stored with it, and otherwise replace it. Files are created with
+ * mode 0600. NULL without a shared directory, or if fill or the file fails. Release with
+ * fir_share_unmap.
+ */
+const void *fir_share_map(const char *name, uint64_t key, enum fir_precision precision, int order, size_t size,
+                          int (*fill)(void *data, void *context), void *context);
+
+void fir_share_unmap(const void *data, size_t size);
 
 void fir_filter_apply(const struct fir_filter *filter, const struct delay_line *delay_line,
                       int count, float *output);
 
-void delay_line_append_samples(const struct fir_filter *filter, struct delay_line *delay_line,
-                               const float *samples, int count);
+void fir_filter_apply_multi(const struct fir_filter *filter,
+                            const struct delay_line *const *delay_lines, int num_channels,
+                            int count, float *const *outputs);
+
+void fir_filter_apply_segment(const struct fir_filter *filter, const struct delay_line *delay_line,
+                              int first_tap, int num_taps, int count, float *output);
+
+void delay_line_append_samples(struct delay_line *delay_line, const float *samples, int count);
+
+int fir_filter_detect_symmetry(const float *coeffs, int order);
 
 void fir_filter_free(const struct fir_filter *filter);
 
 struct fir_filter *fir_filter_clone(const struct fir_filter *filter);
 
+/* One immutable allocation holding the padded coefficients of every filter, shared by all channels. */
+struct fir_bank *fir_bank_init(const struct fir_filter *filters, int num_filters);
+
+/* Maps a file written by fir_bank_export; the coefficients stay in the read-only mapping. */
+struct fir_bank *fir_bank_map(const char *path);
+
+int fir_bank_export(const struct fir_bank *bank, const char *path);
+
+/*
+ * A bank of filters kept as a coefficient file in the shared directory, which is written the
+ * first time and mapped after that; NULL without a shared directory.
+ */
+struct fir_bank *fir_bank_share(const struct fir_filter *filters, int num_filters);
+
+/* Maps path if given, otherwise the compiled-in FIR_FILTERS, shared when possible. */
+struct fir_bank *fir_bank_load(const char *path);
+
+void fir_bank_free(struct fir_bank *bank);
+
+const char *fir_precision_name(enum fir_precision precision);
+
+int fir_precision_from_name(const char *name, enum fir_precision *precision);
+
+/* The value the kernels see for a coefficient stored at precision. */
+float fir_precision_round(float value, enum fir_precision precision);
+
+/* Not thread-safe against running filters; FIR_PRECISION_FP32 drops the 16-bit tables again. */
+int fir_bank_set_precision(struct fir_bank *bank, enum fir_precision precision);
+
 struct delay_line *delay_line_init(size_t size);
 
 void delay_line_free(struct delay_line *delay_line);
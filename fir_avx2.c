@@ -0,0 +1,462 @@
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#include "fir_kernels.h"
+
+#define SIMD_WIDTH_AVX2 8
+#define BROADCAST_BLOCK_AVX2 8
+
+static inline float reduce_add_avx2(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum);
+}
+
+static inline __m256 load_coeff_avx2(const float *coeff, const int aligned) {
+    return aligned ? _mm256_load_ps(coeff) : _mm256_loadu_ps(coeff);
+}
+
+static inline void apply_avx2(int len, const float *coeff, int count,
+                              const float *samples, float *output, const int aligned) {
+    const int vectorized_len = aligned ? len : (len / SIMD_WIDTH_AVX2) * SIMD_WIDTH_AVX2;
+    const int vectorized_count = (count / OUTPUT_UNROLL_FACTOR) * OUTPUT_UNROLL_FACTOR;
+
+    for (int i = 0; i < vectorized_count; i += OUTPUT_UNROLL_FACTOR) {
+        __m256 sum_vec0 = _mm256_setzero_ps();
+        __m256 sum_vec1 = _mm256_setzero_ps();
+        __m256 sum_vec2 = _mm256_setzero_ps();
+        __m256 sum_vec3 = _mm256_setzero_ps();
+
+        for (int j = 0; j < vectorized_len; j += SIMD_WIDTH_AVX2) {
+            __m256 coeff_vec = load_coeff_avx2(&coeff[j], aligned);
+
+            __m256 samples_vec0 = _mm256_loadu_ps(&samples[i + 0 + j]);
+            __m256 samples_vec1 = _mm256_loadu_ps(&samples[i + 1 + j]);
+            __m256 samples_vec2 = _mm256_loadu_ps(&samples[i + 2 + j]);
+            __m256 samples_vec3 = _mm256_loadu_ps(&samples[i + 3 + j]);
+
+            sum_vec0 = _mm256_fmadd_ps(coeff_vec, samples_vec0, sum_vec0);
+            sum_vec1 = _mm256_fmadd_ps(coeff_vec, samples_vec1, sum_vec1);
+            sum_vec2 = _mm256_fmadd_ps(coeff_vec, samples_vec2, sum_vec2);
+            sum_vec3 = _mm256_fmadd_ps(coeff_vec, samples_vec3, sum_vec3);
+        }
+
+        float sum0 = reduce_add_avx2(sum_vec0);
+        float sum1 = reduce_add_avx2(sum_vec1);
+        float sum2 = reduce_add_avx2(sum_vec2);
+        float sum3 = reduce_add_avx2(sum_vec3);
+
+        for (int j = vectorized_len; j < len; j++) {
+            float c = coeff[j];
+            sum0 += c * samples[i + 0 + j];
+            sum1 += c * samples[i + 1 + j];
+            sum2 += c * samples[i + 2 + j];
+            sum3 += c * samples[i + 3 + j];
+        }
+
+        output[i + 0] = sum0;
+        output[i + 1] = sum1;
+        output[i + 2] = sum2;
+        output[i + 3] = sum3;
+    }
+
+    for (int i = vectorized_count; i < count; i++) {
+        __m256 sum_vec = _mm256_setzero_ps();
+
+        for (int j = 0; j < vectorized_len; j += SIMD_WIDTH_AVX2) {
+            __m256 coeff_vec = load_coeff_avx2(&coeff[j], aligned);
+            __m256 samples_vec = _mm256_loadu_ps(&samples[i + j]);
+            sum_vec = _mm256_fmadd_ps(coeff_vec, samples_vec, sum_vec);
+        }
+
+        float sum = reduce_add_avx2(sum_vec);
+
+        for (int j = vectorized_len; j < len; j++) {
+            sum += coeff[j] * samples[i + j];
+        }
+
+        output[i] = sum;
+    }
+}
+
+static void fir_filter_apply_avx2(int len, const float *coeff, int count,
+                                  const float *samples, float *output) {
+    apply_avx2(len, coeff, count, samples, output, 0);
+}
+
+static void fir_filter_apply_aligned_avx2(int len, const float *coeff, int count,
+                                          const float *samples, float *output) {
+    apply_avx2(len, coeff, count, samples, output, 1);
+}
+
+static inline __m256 fold_pair_avx2(const float *window, int len, int j, __m256i reverse) {
+    __m256 forward = _mm256_loadu_ps(&window[j]);
+    __m256 mirror = _mm256_loadu_ps(&window[len - SIMD_WIDTH_AVX2 - j]);
+    return _mm256_add_ps(forward, _mm256_permutevar8x32_ps(mirror, reverse));
+}
+
+static void fir_filter_apply_folded_avx2(int len, const float *coeff, int count,
+                                         const float *samples, float *output) {
+    const int taps = fir_folded_taps(len);
+    const int vectorized_count = (count / OUTPUT_UNROLL_FACTOR) * OUTPUT_UNROLL_FACTOR;
+    const __m256i reverse = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int i = 0; i < vectorized_count; i += OUTPUT_UNROLL_FACTOR) {
+        const float *window0 = samples + i + 0;
+        const float *window1 = samples + i + 1;
+        const float *window2 = samples + i + 2;
+        const float *window3 = samples + i + 3;
+
+        __m256 sum_vec0 = _mm256_setzero_ps();
+        __m256 sum_vec1 = _mm256_setzero_ps();
+        __m256 sum_vec2 = _mm256_setzero_ps();
+        __m256 sum_vec3 = _mm256_setzero_ps();
+
+        for (int j = 0; j < taps; j += SIMD_WIDTH_AVX2) {
+            __m256 coeff_vec = _mm256_load_ps(&coeff[j]);
+
+            sum_vec0 = _mm256_fmadd_ps(coeff_vec, fold_pair_avx2(window0, len, j, reverse), sum_vec0);
+            sum_vec1 = _mm256_fmadd_ps(coeff_vec, fold_pair_avx2(window1, len, j, reverse), sum_vec1);
+            sum_vec2 = _mm256_fmadd_ps(coeff_vec, fold_pair_avx2(window2, len, j, reverse), sum_vec2);
+            sum_vec3 = _mm256_fmadd_ps(coeff_vec, fold_pair_avx2(window3, len, j, reverse), sum_vec3);
+        }
+
+        output[i + 0] = reduce_add_avx2(sum_vec0);
+        output[i + 1] = reduce_add_avx2(sum_vec1);
+        output[i + 2] = reduce_add_avx2(sum_vec2);
+        output[i + 3] = reduce_add_avx2(sum_vec3);
+    }
+
+    for (int i = vectorized_count; i < count; i++) {
+        const float *window = samples + i;
+        __m256 sum_vec = _mm256_setzero_ps();
+
+        for (int j = 0; j < taps; j += SIMD_WIDTH_AVX2) {
+            __m256 coeff_vec = _mm256_load_ps(&coeff[j]);
+            sum_vec = _mm256_fmadd_ps(coeff_vec, fold_pair_avx2(window, len, j, reverse), sum_vec);
+        }
+
+        output[i] = reduce_add_avx2(sum_vec);
+    }
+}
+
+/* The FP32 taps come from the aligned padded layout; 16-bit ones are widened as they load. */
+static inline __m256 load_taps_avx2(const void *coeff, int j, const int precision) {
+    if (precision != FIR_PRECISION_FP32) {
+        const __m128i raw = _mm_loadu_si128((const __m128i *) ((const uint16_t *) coeff + j));
+
+        if (precision == FIR_PRECISION_FP16) {
+            return _mm256_cvtph_ps(raw);
+        }
+        /* BF16 is the top half of an FP32, so widening is a shift. */
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(raw), 16));
+    }
+    return _mm256_load_ps((const float *) coeff + j);
+}
+
+/* Sums taps first to last for up to MULTI_CHANNEL_BLOCK channels, onto the outputs if accumulate is set. */
+static inline void apply_channel_block_avx2(int len, const void *coeff, int count,
+                                            const float *const *samples, float *const *outputs,
+                                            const int channels, const int folded, const int precision,
+                                            int first, int last, int accumulate) {
+    const int vectorized_count = (count / OUTPUT_UNROLL_FACTOR) * OUTPUT_UNROLL_FACTOR;
+    const __m256i reverse = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int i = 0; i < vectorized_count; i += OUTPUT_UNROLL_FACTOR) {
+        __m256 sum_vec[MULTI_CHANNEL_BLOCK][OUTPUT_UNROLL_FACTOR];
+
+        for (int ch = 0; ch < channels; ch++) {
+            for (int u = 0; u < OUTPUT_UNROLL_FACTOR; u++) {
+                sum_vec[ch][u] = _mm256_setzero_ps();
+            }
+        }
+
+        for (int j = first; j < last; j += SIMD_WIDTH_AVX2) {
+            __m256 coeff_vec = load_taps_avx2(coeff, j, precision);
+
+            for (int ch = 0; ch < channels; ch++) {
+                for (int u = 0; u < OUTPUT_UNROLL_FACTOR; u++) {
+                    const float *window = samples[ch] + i + u;
+                    __m256 x = folded ? fold_pair_avx2(window, len, j, reverse)
+                                      : _mm256_loadu_ps(&window[j]);
+                    sum_vec[ch][u] = _mm256_fmadd_ps(coeff_vec, x, sum_vec[ch][u]);
+                }
+            }
+        }
+
+        for (int ch = 0; ch < channels; ch++) {
+            for (int u = 0; u < OUTPUT_UNROLL_FACTOR; u++) {
+                const float sum = reduce_add_avx2(sum_vec[ch][u]);
+                outputs[ch][i + u] = accumulate ? outputs[ch][i + u] + sum : sum;
+            }
+        }
+    }
+
+    for (int i = vectorized_count; i < count; i++) {
+        __m256 sum_vec[MULTI_CHANNEL_BLOCK];
+
+        for (int ch = 0; ch < channels; ch++) {
+            sum_vec[ch] = _mm256_setzero_ps();
+        }
+
+        for (int j = first; j < last; j += SIMD_WIDTH_AVX2) {
+            __m256 coeff_vec = load_taps_avx2(coeff, j, precision);
+
+            for (int ch = 0; ch < channels; ch++) {
+                const float *window = samples[ch] + i;
+                __m256 x = folded ? fold_pair_avx2(window, len, j, reverse)
+                                  : _mm256_loadu_ps(&window[j]);
+                sum_vec[ch] = _mm256_fmadd_ps(coeff_vec, x, sum_vec[ch]);
+            }
+        }
+
+        for (int ch = 0; ch < channels; ch++) {
+            const float sum = reduce_add_avx2(sum_vec[ch]);
+            outputs[ch][i] = accumulate ? outputs[ch][i] + sum : sum;
+        }
+    }
+}
+
+static inline void apply_multi_avx2(int len, const void *coeff, int count, int num_channels,
+                                    const float *const *samples, float *const *outputs,
+                                    const int folded, const int precision) {
+    const int taps = folded ? fir_folded_taps(len) : len;
+    int ch = 0;
+
+    for (; ch + MULTI_CHANNEL_BLOCK <= num_channels; ch += MULTI_CHANNEL_BLOCK) {
+        apply_channel_block_avx2(len, coeff, count, samples + ch, outputs + ch,
+                                 MULTI_CHANNEL_BLOCK, folded, precision, 0, taps, 0);
+    }
+
+    for (; ch < num_channels; ch++) {
+        apply_channel_block_avx2(len, coeff, count, samples + ch, outputs + ch, 1, folded, precision,
+                                 0, taps, 0);
+    }
+}
+
+static void fir_filter_apply_multi_avx2(int len, const float *coeff, int count, int num_channels,
+                                        const float *const *samples, float *const *outputs) {
+    apply_multi_avx2(len, coeff, count, num_channels, samples, outputs, 0, FIR_PRECISION_FP32);
+}
+
+static void fir_filter_apply_folded_multi_avx2(int len, const float *coeff, int count,
+                                               int num_channels, const float *const *samples,
+                                               float *const *outputs) {
+    apply_multi_avx2(len, coeff, count, num_channels, samples, outputs, 1, FIR_PRECISION_FP32);
+}
+
+/* len is known for the shipped orders, so these run constant trip counts with no tails. */
+#define DEFINE_FIXED_ORDER_AVX2(order) \
+    static void fir_filter_apply_multi_##order##_avx2(int len, const float *coeff, int count, \
+                                                      int num_channels, const float *const *samples, \
+                                                      float *const *outputs) { \
+        (void) len; \
+        apply_multi_avx2(FIR_PADDED_ORDER(order), coeff, count, num_channels, samples, outputs, 0, \
+                         FIR_PRECISION_FP32); \
+    } \
+    static void fir_filter_apply_folded_multi_##order##_avx2(int len, const float *coeff, int count, \
+                                                             int num_channels, const float *const *samples, \
+                                                             float *const *outputs) { \
+        (void) len; \
+        apply_multi_avx2(order, coeff, count, num_channels, samples, outputs, 1, FIR_PRECISION_FP32); \
+    }
+
+FIR_FIXED_ORDERS(DEFINE_FIXED_ORDER_AVX2)
+
+#define FIXED_ORDER_AVX2(order) \
+    {fir_filter_apply_multi_##order##_avx2, fir_filter_apply_folded_multi_##order##_avx2},
+
+static void fir_filter_apply_fp16_avx2(int len, const uint16_t *coeff, int count,
+                                       int num_channels, const float *const *samples,
+                                       float *const *outputs) {
+    apply_multi_avx2(len, coeff, count, num_channels, samples, outputs, 0, FIR_PRECISION_FP16);
+}
+
+static void fir_filter_apply_folded_fp16_avx2(int len, const uint16_t *coeff, int count,
+                                              int num_channels, const float *const *samples,
+                                              float *const *outputs) {
+    apply_multi_avx2(len, coeff, count, num_channels, samples, outputs, 1, FIR_PRECISION_FP16);
+}
+
+static void fir_filter_apply_bf16_avx2(int len, const uint16_t *coeff, int count,
+                                       int num_channels, const float *const *samples,
+                                       float *const *outputs) {
+    apply_multi_avx2(len, coeff, count, num_channels, samples, outputs, 0, FIR_PRECISION_BF16);
+}
+
+static void fir_filter_apply_folded_bf16_avx2(int len, const uint16_t *coeff, int count,
+                                              int num_channels, const float *const *samples,
+                                              float *const *outputs) {
+    apply_multi_avx2(len, coeff, count, num_channels, samples, outputs, 1, FIR_PRECISION_BF16);
+}
+
+/* Each tile of outputs is summed one L1-sized block of taps at a time, as in the AVX512 kernel. */
+static inline void apply_tiled_avx2(int len, const float *coeff, int count, int num_channels,
+                                    const float *const *samples, float *const *outputs, const int folded) {
+    const int taps = folded ? fir_folded_taps(len) : len;
+
+    for (int ch = 0; ch < num_channels; ch += MULTI_CHANNEL_BLOCK) {
+        const int channels = num_channels - ch < MULTI_CHANNEL_BLOCK ? num_channels - ch : MULTI_CHANNEL_BLOCK;
+        const int block = fir_tile_taps(taps, count, channels * (folded ? 2 : 1));
+
+        for (int i = 0; i < count; i += block) {
+            const int tile = count - i < block ? count - i : block;
+            const float *windows[MULTI_CHANNEL_BLOCK];
+            float *tile_outputs[MULTI_CHANNEL_BLOCK];
+
+            for (int c = 0; c < channels; c++) {
+                windows[c] = samples[ch + c] + i;
+                tile_outputs[c] = outputs[ch + c] + i;
+            }
+
+            for (int j = 0; j < taps; j += block) {
+                const int last = taps - j < block ? taps : j + block;
+
+                if (channels == MULTI_CHANNEL_BLOCK) {
+                    apply_channel_block_avx2(len, coeff, tile, windows, tile_outputs, MULTI_CHANNEL_BLOCK,
+                                             folded, FIR_PRECISION_FP32, j, last, j > 0);
+                } else {
+                    apply_channel_block_avx2(len, coeff, tile, windows, tile_outputs, 1, folded,
+                                             FIR_PRECISION_FP32, j, last, j > 0);
+                }
+            }
+        }
+    }
+}
+
+static void fir_filter_apply_tiled_avx2(int len, const float *coeff, int count,
+                                        const float *samples, float *output) {
+    apply_tiled_avx2(len, coeff, count, 1, &samples, &output, 0);
+}
+
+static void fir_filter_apply_folded_tiled_avx2(int len, const float *coeff, int count,
+                                               const float *samples, float *output) {
+    apply_tiled_avx2(len, coeff, count, 1, &samples, &output, 1);
+}
+
+static void fir_filter_apply_multi_tiled_avx2(int len, const float *coeff, int count, int num_channels,
+                                              const float *const *samples, float *const *outputs) {
+    apply_tiled_avx2(len, coeff, count, num_channels, samples, outputs, 0);
+}
+
+static void fir_filter_apply_folded_multi_tiled_avx2(int len, const float *coeff, int count,
+                                                     int num_channels, const float *const *samples,
+                                                       float *const *outputs) {
+    apply_tiled_avx2(len, coeff, count, num_channels, samples, outputs, 1);
+}
+
+static inline __m256 broadcast_window_avx2(const float *window, int len, int j, const int folded) {
+    __m256 x = _mm256_loadu_ps(&window[j]);
+    return folded ? _mm256_add_ps(x, _mm256_loadu_ps(&window[len - 1 - j])) : x;
+}
+
+static inline void broadcast_outputs_avx2(int len, int taps, const float *coeff,
+                                          const float *samples, float *output,
+                                          const int vectors, const int folded) {
+    __m256 sum_vec[BROADCAST_BLOCK_AVX2];
+
+    for (int v = 0; v < vectors; v++) {
+        sum_vec[v] = _mm256_setzero_ps();
+    }
+
+    for (int j = 0; j < taps; j++) {
+        const __m256 coeff_vec = _mm256_broadcast_ss(&coeff[j]);
+
+        for (int v = 0; v < vectors; v++) {
+            const float *window = samples + v * SIMD_WIDTH_AVX2;
+            sum_vec[v] = _mm256_fmadd_ps(coeff_vec, broadcast_window_avx2(window, len, j, folded),
+                                         sum_vec[v]);
+        }
+    }
+
+    for (int v = 0; v < vectors; v++) {
+        _mm256_storeu_ps(&output[v * SIMD_WIDTH_AVX2], sum_vec[v]);
+    }
+}
+
+static inline void apply_broadcast_avx2(int len, const float *coeff, int count,
+                                        const float *samples, float *output, const int folded) {
+    const int taps = folded ? fir_folded_taps(len) : len;
+    const int block = BROADCAST_BLOCK_AVX2 * SIMD_WIDTH_AVX2;
+    int i = 0;
+
+    for (; i + block <= count; i += block) {
+        broadcast_outputs_avx2(len, taps, coeff, samples + i, output + i,
+                               BROADCAST_BLOCK_AVX2, folded);
+    }
+    for (; i + SIMD_WIDTH_AVX2 <= count; i += SIMD_WIDTH_AVX2) {
+        broadcast_outputs_avx2(len, taps, coeff, samples + i, output + i, 1, folded);
+    }
+    for (; i < count; i++) {
+        const float *window = samples + i;
+        float sum = 0.0f;
+        for (int j = 0; j < taps; j++) {
+            sum += coeff[j] * (folded ? window[j] + window[len - 1 - j] : window[j]);
+        }
+        output[i] = sum;
+    }
+}
+
+static void fir_filter_apply_broadcast_avx2(int len, const float *coeff, int count,
+                                            const float *samples, float *output) {
+    apply_broadcast_avx2(len, coeff, count, samples, output, 0);
+}
+
+static void fir_filter_apply_folded_broadcast_avx2(int len, const float *coeff, int count,
+                                                   const float *samples, float *output) {
+    apply_broadcast_avx2(len, coeff, count, samples, output, 1);
+}
+
+const struct fir_kernel FIR_KERNEL_AVX2 = {
+    .name = "avx2",
+    .apply = fir_filter_apply_avx2,
+    .apply_aligned = fir_filter_apply_aligned_avx2,
+    .apply_folded = fir_filter_apply_folded_avx2,
+    .apply_multi = fir_filter_apply_multi_avx2,
+    .apply_folded_multi = fir_filter_apply_folded_multi_avx2,
+    .fp16 = {
+        .apply = fir_filter_apply_fp16_avx2,
+        .apply_folded = fir_filter_apply_folded_fp16_avx2,
+    },
+    .bf16 = {
+        .apply = fir_filter_apply_bf16_avx2,
+        .apply_folded = fir_filter_apply_folded_bf16_avx2,
+    },
+    .fixed = {{NULL, NULL}, FIR_FIXED_ORDERS(FIXED_ORDER_AVX2)},
+};
+
+const struct fir_kernel FIR_KERNEL_AVX2_BROADCAST = {
+    .name = "avx2-broadcast",
+    .apply = fir_filter_apply_broadcast_avx2,
+    .apply_aligned = fir_filter_apply_broadcast_avx2,
+    .apply_folded = fir_filter_apply_folded_broadcast_avx2,
+    .fp16 = {
+        .apply = fir_filter_apply_fp16_avx2,
+        .apply_folded = fir_filter_apply_folded_fp16_avx2,
+    },
+    .bf16 = {
+        .apply = fir_filter_apply_bf16_avx2,
+        .apply_folded = fir_filter_apply_folded_bf16_avx2,
+    },
+};
+
+const struct fir_kernel FIR_KERNEL_AVX2_TILED = {
+    .name = "avx2-tiled",
+    .apply = fir_filter_apply_avx2,
+    .apply_aligned = fir_filter_apply_tiled_avx2,
+    .apply_folded = fir_filter_apply_folded_tiled_avx2,
+    .apply_multi = fir_filter_apply_multi_tiled_avx2,
+    .apply_folded_multi = fir_filter_apply_folded_multi_tiled_avx2,
+    .fp16 = {
+        .apply = fir_filter_apply_fp16_avx2,
+        .apply_folded = fir_filter_apply_folded_fp16_avx2,
+    },
+    .bf16 = {
+        .apply = fir_filter_apply_bf16_avx2,
+        .apply_folded = fir_filter_apply_folded_bf16_avx2,
+    },
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef FIR_KERNELS_H
+#define FIR_KERNELS_H
+
+#include "fir.h"
+
+#define OUTPUT_UNROLL_FACTOR 4
+#define MULTI_CHANNEL_BLOCK 2
+
+typedef void (*fir_kernel_fn)(int len, const float *coeff, int count,
+                              const float *samples, float *output);
+
+typedef void (*fir_multi_kernel_fn)(int len, const float *coeff, int count, int num_channels,
+                                    const float *const *samples, float *const *outputs);
+
+/* 16-bit coefficients in the padded or folded layout, widened to FP32 as they are loaded. */
+typedef void (*fir_half_kernel_fn)(int len, const uint16_t *coeff, int count, int num_channels,
+                                   const float *const *samples, float *const *outputs);
+
+struct fir_half_kernels {
+    fir_half_kernel_fn apply;
+    fir_half_kernel_fn apply_folded;
+};
+
+/*
+ * Orders of the shipped tables, which get kernel instances with the length as a constant. The
+ * folded form runs over the order itself and the padded one over the order rounded up to
+ * FIR_COEFF_PADDING.
+ */
+#define FIR_FIXED_ORDERS(X) X(4095) X(8191) X(16383)
+
+#define FIR_COUNT_FIXED_ORDER(order) + 1
+#define FIR_NUM_FIXED_ORDERS (0 FIR_FIXED_ORDERS(FIR_COUNT_FIXED_ORDER))
+
+#define FIR_PADDED_ORDER(order) (((order) + FIR_COEFF_PADDING - 1) / FIR_COEFF_PADDING * FIR_COEFF_PADDING)
+
+/* Slot 0 is for every other order and stays empty, so such filters take the generic kernels. */
+struct fir_fixed_kernels {
+    fir_multi_kernel_fn apply;
+    fir_multi_kernel_fn apply_folded;
+};
+
+struct fir_kernel {
+    const char *name;
+    fir_kernel_fn apply;
+    fir_kernel_fn apply_aligned;
+    fir_kernel_fn apply_folded;
+    fir_multi_kernel_fn apply_multi;
+    fir_multi_kernel_fn apply_folded_multi;
+    struct fir_half_kernels fp16;
+    struct fir_half_kernels bf16;
+    struct fir_fixed_kernels fixed[FIR_NUM_FIXED_ORDERS + 1];
+};
+
+static inline int fir_folded_taps(int len) {
+    const int half = (len + 1) / 2;
+    return (half + FIR_COEFF_PADDING - 1) / FIR_COEFF_PADDING * FIR_COEFF_PADDING;
+}
+
+static inline float fir_bf16_to_float(uint16_t value) {
+    union {
+        uint32_t bits;
+        float value;
+    } u = {.bits = (uint32_t) value << 16};
+    return u.value;
+}
+
+static inline float fir_fp16_to_float(uint16_t value) {
+    const uint32_t sign = (uint32_t) (value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    union {
+        uint32_t bits;
+        float value;
+    } u;
+
+    if (exponent == 0x1f) {
+        u.bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent == 0) {
+        /* Subnormal: mantissa * 2^-24, exact in FP32. */
+        u.value = (float) mantissa * (1.0f / 16777216.0f);
+        u.bits |= sign;
+    } else {
+        u.bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    return u.value;
+}
+
+/*
+ * Taps per block, and outputs per tile, for the tap-tiled kernels when streams windows of
+ * samples run against each block: sized so a block of taps and its windows share half the L1
+ * data cache, or the whole filter if all of it fits at once.
+ */
+int fir_tile_taps(int taps, int count, int streams);
+
+extern const struct fir_kernel FIR_KERNEL_SCALAR;
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const struct fir_kernel FIR_KERNEL_SSE;
+extern const struct fir_kernel FIR_KERNEL_AVX2;
+extern const struct fir_kernel FIR_KERNEL_AVX2_BROADCAST;
+extern const struct fir_kernel FIR_KERNEL_AVX2_TILED;
+extern const struct fir_kernel FIR_KERNEL_AVX512;
+extern const struct fir_kernel FIR_KERNEL_AVX512_BROADCAST;
+extern const struct fir_kernel FIR_KERNEL_AVX512_TILED;
+#endif
+
+#if defined(__aarch64__)
+extern const struct fir_kernel FIR_KERNEL_NEON;
+#endif
+
+#endif
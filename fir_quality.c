@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fir_quality.h"
+#include "fft.h"
+
+#define TRUNCATION_TAPER 0.1
+#define CEPSTRUM_OVERSAMPLING 8
+#define MAGNITUDE_FLOOR 1e-5
+#define ERROR_POINTS 256
+#define ERROR_LOW_HZ 20.0
+#define ERROR_HIGH_HZ 20000.0
+
+struct quality_tier {
+    const char *name;
+    struct fir_quality quality;
+};
+
+static const struct quality_tier QUALITY_TIERS[] = {
+    {"full", {FIR_PHASE_LINEAR, 1}},
+    {"high", {FIR_PHASE_LINEAR, 2}},
+    {"medium", {FIR_PHASE_MINIMUM, 4}},
+    {"low", {FIR_PHASE_MINIMUM, 8}},
+    {"minimal", {FIR_PHASE_MINIMUM, 16}},
+};
+
+#define NUM_QUALITY_TIERS ((int) (sizeof(QUALITY_TIERS) / sizeof(QUALITY_TIERS[0])))
+
+int fir_quality_count(void) {
+    return NUM_QUALITY_TIERS;
+}
+
+const char *fir_quality_name_at(int index) {
+    return index >= 0 && index < NUM_QUALITY_TIERS ? QUALITY_TIERS[index].name : NULL;
+}
+
+int fir_quality_from_name(const char *name, struct fir_quality *quality) {
+    for (int i = 0; i < NUM_QUALITY_TIERS; i++) {
+        if (strcmp(name, QUALITY_TIERS[i].name) == 0) {
+            *quality = QUALITY_TIERS[i].quality;
+            return 0;
+        }
+    }
+
+    const char *suffix;
+    if (strncmp(name, "linear", 6) == 0) {
+        quality->phase = FIR_PHASE_LINEAR;
+        suffix = name + 6;
+    } else if (strncmp(name, "minimum", 7) == 0) {
+        quality->phase = FIR_PHASE_MINIMUM;
+        suffix = name + 7;
+    } else {
+        return -1;
+    }
+
+    quality->divisor = 1;
+    if (*suffix == '\0') {
+        return 0;
+    }
+    if (*suffix != '/') {
+        return -1;
+    }
+
+    char *end;
+    const long divisor = strtol(suffix + 1, &end, 10);
+    if (*end != '\0' || divisor < 1 || divisor > FIR_QUALITY_MAX_DIVISOR || (divisor & (divisor - 1)) != 0) {
+        return -1;
+    }
+    quality->divisor = (int) divisor;
+    return 0;
+}
+
+void fir_quality_format(const struct fir_quality *quality, char *buffer, size_t size) {
+    for (int i = 0; i < NUM_QUALITY_TIERS; i++) {
+        if (QUALITY_TIERS[i].quality.phase == quality->phase &&
+            QUALITY_TIERS[i].quality.divisor == quality->divisor) {
+            snprintf(buffer, size, "%s", QUALITY_TIERS[i].name);
+            return;
+        }
+    }
+    snprintf(buffer, size, "%s/%d", quality->phase == FIR_PHASE_MINIMUM ? "minimum" : "linear",
+             quality->divisor);
+}
+
+/* Raised-cosine fade over the last taper taps before an edge, edge counting taps from it. */
+static float edge_gain(int edge, int taper) {
+    return edge < taper ? (float) (0.5 - 0.5 * cos(M_PI * (edge + 0.5) / taper)) : 1.0f;
+}
+
+/* Keeps the centred taps, so the group delay shrinks with the length and stays constant. */
+static float *truncate_linear(const struct fir_filter *src, int order) {
+    float *taps = malloc(sizeof(float) * order);
+    if (!taps) {
+        return NULL;
+    }
+
+    const int first = (src->order - order) / 2;
+    const int taper = (int) (order * TRUNCATION_TAPER / 2);
+
+    for (int k = 0; k < order; k++) {
+        const int edge = k < order - 1 - k ? k : order - 1 - k;
+        taps[k] = src->coeffs[first + k] * edge_gain(edge, taper);
+    }
+    return taps;
+}
+
+/*
+ * Homomorphic minimum-phase conversion: fold the real cepstrum of log |H| onto positive
+ * quefrencies and exponentiate. The transform is oversampled so the cepstrum does not alias,
+ * and the magnitude is floored so deep notches do not blow up the logarithm.
+ */
+static float *convert_minimum_phase(const struct fir_filter *src, int order) {
+    int size = 4;
+    while (size < src->order * CEPSTRUM_OVERSAMPLING) {
+        size <<= 1;
+    }
+
+    const int bins = size / 2 + 1;
+    struct fft_plan *plan = fft_plan_init(size);
+    float *signal = calloc(size, sizeof(float));
+    float *re = malloc(sizeof(float) * bins);
+    float *im = malloc(sizeof(float) * bins);
+    float *taps = malloc(sizeof(float) * order);
+
+    if (!plan || !signal || !re || !im || !taps) {
+        fft_plan_free(plan);
+        free(signal);
+        free(re);
+        free(im);
+        free(taps);
+        return NULL;
+    }
+
+    memcpy(signal, src->coeffs, sizeof(float) * src->order);
+    fft_forward(plan, signal, re, im);
+
+    double peak = 0.0;
+    for (int k = 0; k < bins; k++) {
+        peak = fmax(peak, hypot(re[k], im[k]));
+    }
+    const double floor_magnitude = fmax(peak * MAGNITUDE_FLOOR, 1e-30);
+
+    for (int k = 0; k < bins; k++) {
+        re[k] = (float) log(fmax(hypot(re[k], im[k]), floor_magnitude));
+        im[k] = 0.0f;
+    }
+    fft_inverse(plan, re, im, signal);
+
+    /* Causal part of the cepstrum: double the positive quefrencies, drop the negative ones. */
+    const float scale = 1.0f / size;
+    signal[0] *= scale;
+    for (int n = 1; n < size / 2; n++) {
+        signal[n] *= 2.0f * scale;
+    }
+    signal[size / 2] *= scale;
+    memset(signal + size / 2 + 1, 0, sizeof(float) * (size / 2 - 1));
+
+    fft_forward(plan, signal, re, im);
+    for (int k = 0; k < bins; k++) {
+        const double magnitude = exp(re[k]);
+        const double phase = im[k];
+        re[k] = (float) (magnitude * cos(phase));
+        im[k] = (float) (magnitude * sin(phase));
+    }
+    fft_inverse(plan, re, im, signal);
+
+    /* Coefficients run from the oldest sample, so the response goes in reversed; its energy sits
+     * at the start, so only its tail gets faded. */
+    const int taper = (int) (order * TRUNCATION_TAPER);
+    for (int k = 0; k < order; k++) {
+        taps[order - 1 - k] = signal[k] * scale * edge_gain(order - 1 - k, taper);
+    }
+
+    fft_plan_free(plan);
+    free(signal);
+    free(re);
+    free(im);
+    return taps;
+}
+
+struct fir_filter *fir_filter_reduce(const struct fir_filter *src, const struct fir_quality *quality) {
+    if (!src || !quality || quality->divisor < 1) {
+        fprintf(stderr, "Invalid quality reduction parameters\n");
+        return NULL;
+    }
+
+    int order = src->order / quality->divisor;
+    float *taps;
+
+    if (quality->phase == FIR_PHASE_LINEAR) {
+        if (quality->divisor == 1) {
+            return fir_filter_clone(src);
+        }
+        /* Matching the parity of the source keeps a symmetric filter symmetric about its centre. */
+        if ((order ^ src->order) & 1) {
+            order++;
+        }
+        order = order < src->order ? order : src->order;
+        taps = truncate_linear(src, order);
+    } else {
+        order = order > 0 ? order : 1;
+        taps = convert_minimum_phase(src, order);
+    }
+
+    if (!taps) {
+        fprintf(stderr, "Failed to allocate memory for reduced filter\n");
+        return NULL;
+    }
+
+    const struct fir_filter reduced = {.rate = src->rate, .coeffs = taps, .order = order};
+    struct fir_filter *filter = fir_filter_clone(&reduced);
+    free(taps);
+    return filter;
+}
+
+struct fir_bank *fir_bank_reduce(const struct fir_bank *bank, const struct fir_quality *quality) {
+    struct fir_filter **reduced = calloc(bank->num_filters, sizeof(struct fir_filter *));
+    struct fir_filter *filters = calloc(bank->num_filters, sizeof(struct fir_filter));
+    struct fir_bank *result = NULL;
+    int count = 0;
+
+    if (!reduced || !filters) {
+        fprintf(stderr, "Failed to allocate memory for reduced FIR bank\n");
+        goto out;
+    }
+
+    for (; count < bank->num_filters; count++) {
+        reduced[count] = fir_filter_reduce(&bank->filters[count], quality);
+        if (!reduced[count]) {
+            goto out;
+        }
+        filters[count] = (struct fir_filter) {
+            .rate = reduced[count]->rate,
+            .coeffs = reduced[count]->coeffs,
+            .order = reduced[count]->order,
+        };
+    }
+
+    result = fir_bank_init(filters, count);
+
+out:
+    for (int i = 0; i < count; i++) {
+        fir_filter_free(reduced[i]);
+    }
+    free(reduced);
+    free(filters);
+    return result;
+}
+
+static double magnitude_at(const struct fir_filter *filter, double omega) {
+    const double step_re = cos(omega);
+    const double step_im = -sin(omega);
+    double rot_re = 1.0;
+    double rot_im = 0.0;
+    double sum_re = 0.0;
+    double sum_im = 0.0;
+
+    for (int n = 0; n < filter->order; n++) {
+        sum_re += filter->coeffs[n] * rot_re;
+        sum_im += filter->coeffs[n] * rot_im;
+
+        const double next_re = rot_re * step_re - rot_im * step_im;
+        rot_im = rot_re * step_im + rot_im * step_re;
+        rot_re = next_re;
+    }
+
+    return hypot(sum_re, sum_im);
+}
+
+double fir_filter_response_error(const struct fir_filter *filter, const struct fir_filter *ref) {
+    const double high = fmin(ERROR_HIGH_HZ, 0.45 * ref->rate);
+    double worst = 0.0;
+
+    for (int i = 0; i < ERROR_POINTS; i++) {
+        const double hz = ERROR_LOW_HZ * pow(high / ERROR_LOW_HZ, (double) i / (ERROR_POINTS - 1));
+        const double omega = 2.0 * M_PI * hz / ref->rate;
+        const double got = fmax(magnitude_at(filter, omega), 1e-12);
+        const double want = fmax(magnitude_at(ref, omega), 1e-12);
+
+        worst = fmax(worst, fabs(20.0 * log10(got / want)));
+    }
+
+    return worst;
+}
+
+int fir_filter_peak(const struct fir_filter *filter) {
+    int peak = filter->order - 1;
+
+    for (int n = filter->order - 2; n >= 0; n--) {
+        if (fabsf(filter->coeffs[n]) > fabsf(filter->coeffs[peak])) {
+            peak = n;
+        }
+    }
+    return filter->order - 1 - peak;
+}
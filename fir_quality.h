@@ -0,0 +1,45 @@
+#ifndef FIR_QUALITY_H
+#define FIR_QUALITY_H
+
+#include <stddef.h>
+
+#include "fir.h"
+
+#define FIR_QUALITY_MAX_DIVISOR 64
+
+enum fir_phase {
+    FIR_PHASE_LINEAR,
+    FIR_PHASE_MINIMUM,
+};
+
+/* Keeps 1 / divisor of the stock taps, either centred (linear) or after a minimum-phase conversion. */
+struct fir_quality {
+    enum fir_phase phase;
+    int divisor;
+};
+
+/* Named tiers from best to cheapest, as listed by fir_quality_name_at. */
+int fir_quality_count(void);
+
+const char *fir_quality_name_at(int index);
+
+/*
+ * Accepts a named tier ("full", "high", "medium", "low", "minimal") or PHASE[/DIVISOR] with
+ * PHASE "linear" or "minimum" and a power-of-two DIVISOR up to FIR_QUALITY_MAX_DIVISOR.
+ */
+int fir_quality_from_name(const char *name, struct fir_quality *quality);
+
+void fir_quality_format(const struct fir_quality *quality, char *buffer, size_t size);
+
+/* A shorter filter with about the magnitude response of src; free it with fir_filter_free. */
+struct fir_filter *fir_filter_reduce(const struct fir_filter *src, const struct fir_quality *quality);
+
+struct fir_bank *fir_bank_reduce(const struct fir_bank *bank, const struct fir_quality *quality);
+
+/* Largest magnitude difference in dB from ref over 20 Hz to 20 kHz, or 0.45 of the rate if lower. */
+double fir_filter_response_error(const struct fir_filter *filter, const struct fir_filter *ref);
+
+/* Samples from the newest tap back to the largest one, the delay a listener hears the filter add. */
+int fir_filter_peak(const struct fir_filter *filter);
+
+#endif
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "fir_resample.h"
+
+#define ZERO_CROSSINGS 32
+#define KAISER_BETA 9.0
+#define TRUNCATION_TAPER 0.05
+
+const struct fir_filter *fir_bank_nearest(const struct fir_bank *bank, int rate) {
+    const struct fir_filter *above = NULL;
+    const struct fir_filter *highest = NULL;
+
+    for (int i = 0; i < bank->num_filters; i++) {
+        const struct fir_filter *filter = &bank->filters[i];
+
+        if (filter->rate >= rate && (!above || filter->rate < above->rate)) {
+            above = filter;
+        }
+        if (!highest || filter->rate > highest->rate) {
+            highest = filter;
+        }
+    }
+
+    return above ? above : highest;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 64; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+double fir_kaiser_window(double r, double beta) {
+    return bessel_i0(beta * sqrt(fmax(0.0, 1.0 - r * r)));
+}
+
+/* Bandlimited value of the source response at fractional source position t. */
+static double interpolate(const float *coeffs, int order, double t, double cutoff, double half_width,
+                          double window_norm) {
+    int first = (int) ceil(t - half_width);
+    int last = (int) floor(t + half_width);
+    double acc = 0.0;
+
+    if (first < 0) {
+        first = 0;
+    }
+    if (last > order - 1) {
+        last = order - 1;
+    }
+
+    for (int m = first; m <= last; m++) {
+        const double x = t - m;
+        const double r = x / half_width;
+        const double window = fir_kaiser_window(r, KAISER_BETA) / window_norm;
+        const double arg = M_PI * cutoff * x;
+        const double sinc = fabs(arg) < 1e-12 ? 1.0 : sin(arg) / arg;
+
+        acc += coeffs[m] * cutoff * sinc * window;
+    }
+
+    return acc;
+}
+
+struct fir_filter *fir_filter_resample(const struct fir_filter *src, int rate, int max_order) {
+    if (!src || rate <= 0 || max_order <= 0) {
+        fprintf(stderr, "Invalid resampling parameters\n");
+        return NULL;
+    }
+
+    /* Source samples per target sample; downsampling also lowers the cutoff to the new Nyquist. */
+    const double ratio = (double) src->rate / rate;
+    const double cutoff = ratio > 1.0 ? 1.0 / ratio : 1.0;
+    const double half_width = ZERO_CROSSINGS / cutoff;
+    const double window_norm = fir_kaiser_window(0.0, KAISER_BETA);
+
+    /* An odd length keeps the centre on a tap so linear-phase filters stay linear phase. */
+    const int natural_order = (int) lround(src->order / ratio) | 1;
+    int order = natural_order;
+    if (order > max_order) {
+        order = max_order % 2 ? max_order : max_order - 1;
+    }
+    if (order < 1) {
+        order = 1;
+    }
+
+    float *taps = malloc(sizeof(float) * order);
+    if (!taps) {
+        fprintf(stderr, "Failed to allocate memory for resampled filter\n");
+        return NULL;
+    }
+
+    const double src_center = (src->order - 1) / 2.0;
+    const int center = (order - 1) / 2;
+    const int computed = src->symmetric ? center + 1 : order;
+    const int taper = order < natural_order ? (int) (order * TRUNCATION_TAPER) : 0;
+
+    for (int k = 0; k < computed; k++) {
+        const double t = src_center + (k - center) * ratio;
+        double value = ratio * interpolate(src->coeffs, src->order, t, cutoff, half_width, window_norm);
+
+        const int edge = k < order - 1 - k ? k : order - 1 - k;
+        if (edge < taper) {
+            value *= 0.5 - 0.5 * cos(M_PI * (edge + 0.5) / taper);
+        }
+
+        taps[k] = (float) value;
+        if (src->symmetric) {
+            taps[order - 1 - k] = (float) value;
+        }
+    }
+
+    const struct fir_filter resampled = {.rate = rate, .coeffs = taps, .order = order};
+    struct fir_filter *filter = fir_filter_clone(&resampled);
+    free(taps);
+    return filter;
+}
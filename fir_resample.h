@@ -0,0 +1,19 @@
+#ifndef FIR_RESAMPLE_H
+#define FIR_RESAMPLE_H
+
+#include "fir.h"
+
+/* The lowest-rate filter at or above rate, which still covers the whole target band, else the highest. */
+const struct fir_filter *fir_bank_nearest(const struct fir_bank *bank, int rate);
+
+/* Unnormalized Kaiser window at r in [-1, 1]; divide by the value at 0 for a unit peak. */
+double fir_kaiser_window(double r, double beta);
+
+/*
+ * Resamples the impulse response of src to rate with a Kaiser-windowed sinc, keeping the
+ * response in time and the DC gain. Symmetric sources give exactly symmetric results. The
+ * result is capped at max_order taps with tapered ends; free it with fir_filter_free.
+ */
+struct fir_filter *fir_filter_resample(const struct fir_filter *src, int rate, int max_order);
+
+#endif
@@ -0,0 +1,85 @@
+#include "fir_kernels.h"
+
+static void fir_filter_apply_scalar(int len, const float *coeff, int count,
+                                    const float *samples, float *output) {
+    for (int i = 0; i < count; i++) {
+        float sum = 0.0f;
+        for (int j = 0; j < len; j++) {
+            sum += coeff[j] * samples[i + j];
+        }
+        output[i] = sum;
+    }
+}
+
+static void fir_filter_apply_folded_scalar(int len, const float *coeff, int count,
+                                           const float *samples, float *output) {
+    const int taps = fir_folded_taps(len);
+
+    for (int i = 0; i < count; i++) {
+        const float *window = samples + i;
+        float sum = 0.0f;
+        for (int j = 0; j < taps; j++) {
+            sum += coeff[j] * (window[j] + window[len - 1 - j]);
+        }
+        output[i] = sum;
+    }
+}
+
+static inline float half_to_float(uint16_t value, const int precision) {
+    return precision == FIR_PRECISION_FP16 ? fir_fp16_to_float(value) : fir_bf16_to_float(value);
+}
+
+static inline void apply_half_scalar(int len, const uint16_t *coeff, int count, int num_channels,
+                                     const float *const *samples, float *const *outputs,
+                                     const int folded, const int precision) {
+    const int taps = folded ? fir_folded_taps(len) : len;
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        for (int i = 0; i < count; i++) {
+            const float *window = samples[ch] + i;
+            float sum = 0.0f;
+            for (int j = 0; j < taps; j++) {
+                const float x = folded ? window[j] + window[len - 1 - j] : window[j];
+                sum += half_to_float(coeff[j], precision) * x;
+            }
+            outputs[ch][i] = sum;
+        }
+    }
+}
+
+static void fir_filter_apply_fp16_scalar(int len, const uint16_t *coeff, int count, int num_channels,
+                                         const float *const *samples, float *const *outputs) {
+    apply_half_scalar(len, coeff, count, num_channels, samples, outputs, 0, FIR_PRECISION_FP16);
+}
+
+static void fir_filter_apply_folded_fp16_scalar(int len, const uint16_t *coeff, int count,
+                                                int num_channels, const float *const *samples,
+                                                float *const *outputs) {
+    apply_half_scalar(len, coeff, count, num_channels, samples, outputs, 1, FIR_PRECISION_FP16);
+}
+
+static void fir_filter_apply_bf16_scalar(int len, const uint16_t *coeff, int count, int num_channels,
+                                         const float *const *samples, float *const *outputs) {
+    apply_half_scalar(len, coeff, count, num_channels, samples, outputs, 0, FIR_PRECISION_BF16);
+}
+
+static void fir_filter_apply_folded_bf16_scalar(int len, const uint16_t *coeff, int count,
+                                                int num_channels, const float *const *samples,
+                                                float *const *outputs) {
+    apply_half_scalar(len, coeff, count, num_channels, samples, outputs, 1, FIR_PRECISION_BF16);
+}
+
+const struct fir_kernel FIR_KERNEL_SCALAR = {
+    .name = "scalar",
+    .apply = fir_filter_apply_scalar,
+    .apply_aligned = fir_filter_apply_scalar,
+    .apply_folded = fir_filter_apply_folded_scalar,
+    .fp16 = {
+        .apply = fir_filter_apply_fp16_scalar,
+        .apply_folded = fir_filter_apply_folded_fp16_scalar,
+    },
+    .bf16 = {
+        .apply = fir_filter_apply_bf16_scalar,
+        .apply_folded = fir_filter_apply_folded_bf16_scalar,
+    },
+};
@@ -0,0 +1,149 @@
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#include "fir_kernels.h"
+
+#define SIMD_WIDTH_SSE 4
+
+static inline float reduce_add_sse(__m128 v) {
+    __m128 sum = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum);
+}
+
+static inline __m128 load_coeff_sse(const float *coeff, const int aligned) {
+    return aligned ? _mm_load_ps(coeff) : _mm_loadu_ps(coeff);
+}
+
+static inline void apply_sse(int len, const float *coeff, int count,
+                             const float *samples, float *output, const int aligned) {
+    const int vectorized_len = aligned ? len : (len / SIMD_WIDTH_SSE) * SIMD_WIDTH_SSE;
+    const int vectorized_count = (count / OUTPUT_UNROLL_FACTOR) * OUTPUT_UNROLL_FACTOR;
+
+    for (int i = 0; i < vectorized_count; i += OUTPUT_UNROLL_FACTOR) {
+        __m128 sum_vec0 = _mm_setzero_ps();
+        __m128 sum_vec1 = _mm_setzero_ps();
+        __m128 sum_vec2 = _mm_setzero_ps();
+        __m128 sum_vec3 = _mm_setzero_ps();
+
+        for (int j = 0; j < vectorized_len; j += SIMD_WIDTH_SSE) {
+            __m128 coeff_vec = load_coeff_sse(&coeff[j], aligned);
+
+            __m128 samples_vec0 = _mm_loadu_ps(&samples[i + 0 + j]);
+            __m128 samples_vec1 = _mm_loadu_ps(&samples[i + 1 + j]);
+            __m128 samples_vec2 = _mm_loadu_ps(&samples[i + 2 + j]);
+            __m128 samples_vec3 = _mm_loadu_ps(&samples[i + 3 + j]);
+
+            sum_vec0 = _mm_add_ps(sum_vec0, _mm_mul_ps(coeff_vec, samples_vec0));
+            sum_vec1 = _mm_add_ps(sum_vec1, _mm_mul_ps(coeff_vec, samples_vec1));
+            sum_vec2 = _mm_add_ps(sum_vec2, _mm_mul_ps(coeff_vec, samples_vec2));
+            sum_vec3 = _mm_add_ps(sum_vec3, _mm_mul_ps(coeff_vec, samples_vec3));
+        }
+
+        float sum0 = reduce_add_sse(sum_vec0);
+        float sum1 = reduce_add_sse(sum_vec1);
+        float sum2 = reduce_add_sse(sum_vec2);
+        float sum3 = reduce_add_sse(sum_vec3);
+
+        for (int j = vectorized_len; j < len; j++) {
+            float c = coeff[j];
+            sum0 += c * samples[i + 0 + j];
+            sum1 += c * samples[i + 1 + j];
+            sum2 += c * samples[i + 2 + j];
+            sum3 += c * samples[i + 3 + j];
+        }
+
+        output[i + 0] = sum0;
+        output[i + 1] = sum1;
+        output[i + 2] = sum2;
+        output[i + 3] = sum3;
+    }
+
+    for (int i = vectorized_count; i < count; i++) {
+        __m128 sum_vec = _mm_setzero_ps();
+
+        for (int j = 0; j < vectorized_len; j += SIMD_WIDTH_SSE) {
+            __m128 coeff_vec = load_coeff_sse(&coeff[j], aligned);
+            __m128 samples_vec = _mm_loadu_ps(&samples[i + j]);
+            sum_vec = _mm_add_ps(sum_vec, _mm_mul_ps(coeff_vec, samples_vec));
+        }
+
+        float sum = reduce_add_sse(sum_vec);
+
+        for (int j = vectorized_len; j < len; j++) {
+            sum += coeff[j] * samples[i + j];
+        }
+
+        output[i] = sum;
+    }
+}
+
+static void fir_filter_apply_sse(int len, const float *coeff, int count,
+                                 const float *samples, float *output) {
+    apply_sse(len, coeff, count, samples, output, 0);
+}
+
+static void fir_filter_apply_aligned_sse(int len, const float *coeff, int count,
+                                         const float *samples, float *output) {
+    apply_sse(len, coeff, count, samples, output, 1);
+}
+
+static inline __m128 fold_pair_sse(const float *window, int len, int j) {
+    __m128 forward = _mm_loadu_ps(&window[j]);
+    __m128 mirror = _mm_loadu_ps(&window[len - SIMD_WIDTH_SSE - j]);
+    return _mm_add_ps(forward, _mm_shuffle_ps(mirror, mirror, _MM_SHUFFLE(0, 1, 2, 3)));
+}
+
+static void fir_filter_apply_folded_sse(int len, const float *coeff, int count,
+                                        const float *samples, float *output) {
+    const int taps = fir_folded_taps(len);
+    const int vectorized_count = (count / OUTPUT_UNROLL_FACTOR) * OUTPUT_UNROLL_FACTOR;
+
+    for (int i = 0; i < vectorized_count; i += OUTPUT_UNROLL_FACTOR) {
+        const float *window0 = samples + i + 0;
+        const float *window1 = samples + i + 1;
+        const float *window2 = samples + i + 2;
+        const float *window3 = samples + i + 3;
+
+        __m128 sum_vec0 = _mm_setzero_ps();
+        __m128 sum_vec1 = _mm_setzero_ps();
+        __m128 sum_vec2 = _mm_setzero_ps();
+        __m128 sum_vec3 = _mm_setzero_ps();
+
+        for (int j = 0; j < taps; j += SIMD_WIDTH_SSE) {
+            __m128 coeff_vec = _mm_load_ps(&coeff[j]);
+
+            sum_vec0 = _mm_add_ps(sum_vec0, _mm_mul_ps(coeff_vec, fold_pair_sse(window0, len, j)));
+            sum_vec1 = _mm_add_ps(sum_vec1, _mm_mul_ps(coeff_vec, fold_pair_sse(window1, len, j)));
+            sum_vec2 = _mm_add_ps(sum_vec2, _mm_mul_ps(coeff_vec, fold_pair_sse(window2, len, j)));
+            sum_vec3 = _mm_add_ps(sum_vec3, _mm_mul_ps(coeff_vec, fold_pair_sse(window3, len, j)));
+        }
+
+        output[i + 0] = reduce_add_sse(sum_vec0);
+        output[i + 1] = reduce_add_sse(sum_vec1);
+        output[i + 2] = reduce_add_sse(sum_vec2);
+        output[i + 3] = reduce_add_sse(sum_vec3);
+    }
+
+    for (int i = vectorized_count; i < count; i++) {
+        const float *window = samples + i;
+        __m128 sum_vec = _mm_setzero_ps();
+
+        for (int j = 0; j < taps; j += SIMD_WIDTH_SSE) {
+            __m128 coeff_vec = _mm_load_ps(&coeff[j]);
+            sum_vec = _mm_add_ps(sum_vec, _mm_mul_ps(coeff_vec, fold_pair_sse(window, len, j)));
+        }
+
+        output[i] = reduce_add_sse(sum_vec);
+    }
+}
+
+const struct fir_kernel FIR_KERNEL_SSE = {
+    .name = "sse",
+    .apply = fir_filter_apply_sse,
+    .apply_aligned = fir_filter_apply_aligned_sse,
+    .apply_folded = fir_filter_apply_folded_sse,
+};
+
+#endif
@@ -1,46 +1,222 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <errno.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <stdatomic.h>
 #include <pipewire/pipewire.h>
 #include <pipewire/filter.h>
 #include <spa/param/audio/format-utils.h>
 #include <spa/param/props.h>
+#include <spa/pod/parser.h>
 #include <spa/utils/result.h>
 
 #include "fir.h"
+#include "convolver.h"
+#include "worker_pool.h"
+#include "autotune.h"
+#include "stats.h"
+#include "fir_resample.h"
+#include "fir_quality.h"
+#include "multirate.h"
 
 #define MAX_FILTER_ORDER 16383
-#define NUM_CHANNELS 2
-#define CHANNEL_LEFT 0
-#define CHANNEL_RIGHT 1
+#define FFT_BLOCK_SIZE 64
+#define DEFAULT_QUANTUM 1024
+#define MAX_QUANTUM 8192
+#define DEFAULT_CHANNELS 2
+#define MAX_CHANNELS CONVOLVER_MAX_CHANNELS
+#define CHANNELS_PER_TASK 2
+#define MAX_TASKS ((MAX_CHANNELS + CHANNELS_PER_TASK - 1) / CHANNELS_PER_TASK)
+#define INGEST_BATCH 8
+#define DEFAULT_WORKER_PRIORITY 80
+#define MAX_NAME_LENGTH 32
+#define MAX_FILTERS AUTOTUNE_MAX_RATES
+#define MAX_DERIVED_FILTERS 8
+#define DEFAULT_STATS_INTERVAL_MS 1000
+#define STATS_SHM_PREFIX "/speaker-compensation-filter-"
+#define STACK_PREFAULT_BYTES (256 << 10)
+#define PROFILE_FADE_MS 50
+#define PROFILE_PARAM "fir.profile"
+#define BUILTIN_PROFILE "builtin"
+#define MAX_TIERS 8
+#define GOVERNOR_HIGH_LOAD 80.0
+#define GOVERNOR_LOW_LOAD 35.0
+#define GOVERNOR_RESTORE_INTERVALS 10
+#define GOVERNOR_HOLD_INTERVALS 3
 
 struct channel {
     struct pw_filter_port *in_port;
     struct pw_filter_port *out_port;
-    struct delay_line *delay_line;
-    const struct fir_filter *current;
+    int silent;
+};
+
+/* One delay line per channel, each holding history and span samples; replaced as a whole. */
+struct delay_set {
+    int history;
+    int span;
+    struct delay_line *lines[MAX_CHANNELS];
 };
 
 struct channel_config {
-    const char *input_name;
-    const char *output_name;
-    const char *channel_name;
+    char input_name[MAX_NAME_LENGTH];
+    char output_name[MAX_NAME_LENGTH];
+    char channel_name[MAX_NAME_LENGTH];
+};
+
+struct options {
+    int num_channels;
+    const char *positions;
+    int num_workers;
+    int worker_cpus[MAX_CHANNELS];
+    int num_worker_cpus;
+    int worker_priority;
+    const char *kernel;
+    int quantum;
+    int tune;
+    int retune;
+    int stats_interval;
+    int realtime_memory;
+    int data_cpus[MAX_CHANNELS];
+    int num_data_cpus;
+    const char *coefficients;
+    struct fir_quality quality;
+    enum fir_precision precision;
+    int multirate_rates[MAX_FILTERS];
+    int num_multirate_rates;
+    int multirate_all;
+    int pipelined;
+    int governor;
+    const char *shared_dir;
+};
+
+struct process_job {
+    const struct rate_slot *slot;
+    int n_samples;
+    float *inputs[MAX_CHANNELS];
+    float *outputs[MAX_CHANNELS];
+    const struct delay_line *delay_lines[MAX_CHANNELS];
+    bool silent[MAX_CHANNELS];
+    bool ingest;
+    uint64_t ingest_ticks[MAX_TASKS];
+};
+
+/* Exactly one of conv and multirate is set. */
+struct rate_slot {
+    const struct fir_filter *filter;
+    struct convolver *conv;
+    struct multirate *multirate;
+};
+
+/* How a profile reduces its bank besides the precision; the governor steps through these. */
+struct tier {
+    struct fir_quality quality;
+    int multirate_all;
+};
+
+/*
+ * Every rate of one coefficient bank, built on the main loop at one tier. Derived slots are added
+ * by the main loop to the newest profile only and stay until the profile is freed.
+ */
+struct profile {
+    char name[PATH_MAX];
+    int builtin;
+    struct tier tier;
+    char quality_name[MAX_NAME_LENGTH];
+    struct fir_bank *bank;
+    struct rate_slot slots[MAX_FILTERS];
+    int num_slots;
+    struct rate_slot *fallback;
+    struct rate_slot derived[MAX_DERIVED_FILTERS];
+    atomic_int num_derived;
+    atomic_uint derived_generation;
+};
+
+/*
+ * Main loop only. Steps one tier down when an interval's p99 load passes GOVERNOR_HIGH_LOAD or the
+ * data thread overran, and back up after GOVERNOR_RESTORE_INTERVALS below GOVERNOR_LOW_LOAD. After
+ * each switch it waits for the fade to finish and GOVERNOR_HOLD_INTERVALS more before judging again.
+ */
+struct governor {
+    int enabled;
+    struct tier tiers[MAX_TIERS];
+    int num_tiers;
+    int level;
+    int switching;
+    int hold;
+    int calm;
+    uint64_t xruns;
+    unsigned int switches;
+};
+
+struct rate_report {
+    int requested_rate;
+    int rate;
+    int order;
+    enum convolver_engine engine;
+    int base_rate;
+    int factor;
 };
 
 struct data {
     struct pw_main_loop *loop;
     struct pw_filter *filter;
 
-    struct channel channels[NUM_CHANNELS];
+    int num_channels;
+    struct channel *channels;
+    struct channel_config *channel_configs;
 
+    const struct options *options;
+    struct governor governor;
+
+    /* The main loop builds profiles, latest being the newest, and publishes them in pending_profile.
+     * The data thread plays profile, takes a pending one as incoming and, once it switches, fades
+     * out of the old one in fading through fade_buffers. */
+    struct profile *latest;
+    _Atomic(struct profile *) pending_profile;
+    struct profile *profile;
+    struct profile *incoming;
+    struct profile *fading;
+    const struct rate_slot *fade_slot;
+    int fade_warmup;
+    int fade_length;
+    int fade_position;
+    float *fade_buffers[MAX_CHANNELS];
+    unsigned int seen_generation;
+    _Atomic(struct rate_slot *) active;
+    atomic_int format_rate;
     int current_rate;
+
+    /* The data thread owns delays and adopts pending_delays, which the main loop builds. */
+    struct delay_set *delays;
+    _Atomic(struct delay_set *) pending_delays;
+    int delay_history;
+    int delay_span;
+    int requested_history;
+    int requested_span;
+
+    struct worker_pool *pool;
+    struct process_job job;
+
+    struct stats *stats;
+    char stats_shm_name[64];
+
+    /* Set up by the data thread itself on its first cycle, then cleared. */
+    int setup_data_thread;
+    int realtime_memory;
+    cpu_set_t data_cpus;
 };
 
-static const struct channel_config channel_configs[NUM_CHANNELS] = {
-    {"input_FL", "output_FL", "FL"},
-    {"input_FR", "output_FR", "FR"}
+static const char *const default_positions[] = {
+    "FL", "FR", "FC", "LFE", "RL", "RR", "SL", "SR"
 };
 
 static void do_quit(void *userdata, int signal_number) {
@@ -48,127 +224,840 @@ static void do_quit(void *userdata, int signal_number) {
     pw_main_loop_quit(data->loop);
 }
 
-static int init_channel(struct channel *channel, int delay_size) {
-    channel->delay_line = delay_line_init(delay_size);
-    if (!channel->delay_line) {
-        fprintf(stderr, "Failed to initialize delay line\n");
+static void delay_set_free(struct delay_set *set, int num_channels) {
+    if (!set) {
+        return;
+    }
+    for (int ch = 0; ch < num_channels; ch++) {
+        delay_line_free(set->lines[ch]);
+    }
+    free(set);
+}
+
+static struct delay_set *delay_set_init(int history, int span, int num_channels) {
+    struct delay_set *set = calloc(1, sizeof(struct delay_set));
+    if (!set) {
+        fprintf(stderr, "Failed to allocate memory for delay lines\n");
+        return NULL;
+    }
+
+    set->history = history;
+    set->span = span;
+    for (int ch = 0; ch < num_channels; ch++) {
+        set->lines[ch] = delay_line_init((size_t) history + span);
+        if (!set->lines[ch]) {
+            fprintf(stderr, "Failed to initialize delay line\n");
+            delay_set_free(set, num_channels);
+            return NULL;
+        }
+    }
+    return set;
+}
+
+static int slot_history(const struct rate_slot *slot) {
+    return slot->multirate ? multirate_history(slot->multirate) : convolver_history(slot->conv);
+}
+
+/* Samples of silence after which the filter output is silent too. */
+static int slot_memory(const struct rate_slot *slot) {
+    return slot->multirate ? multirate_memory(slot->multirate) : slot->filter->order;
+}
+
+static void profile_free(struct profile *profile) {
+    if (!profile) {
+        return;
+    }
+    for (int i = 0; i < profile->num_slots; i++) {
+        convolver_free(profile->slots[i].conv);
+        multirate_free(profile->slots[i].multirate);
+    }
+    for (int i = 0; i < atomic_load(&profile->num_derived); i++) {
+        convolver_free(profile->derived[i].conv);
+        fir_filter_free(profile->derived[i].filter);
+    }
+    fir_bank_free(profile->bank);
+    free(profile);
+}
+
+static void cleanup_fir_filters(struct data *data) {
+    atomic_store(&data->active, NULL);
+    data->fade_slot = NULL;
+    profile_free(data->profile);
+    profile_free(data->incoming);
+    profile_free(data->fading);
+    profile_free(atomic_exchange(&data->pending_profile, NULL));
+    data->profile = data->incoming = data->fading = data->latest = NULL;
+    for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+        free(data->fade_buffers[ch]);
+        data->fade_buffers[ch] = NULL;
+    }
+    delay_set_free(data->delays, data->num_channels);
+    delay_set_free(atomic_exchange(&data->pending_delays, NULL), data->num_channels);
+    data->delays = NULL;
+}
+
+/* Only the first profile may run the tuner; later ones reuse a saved tuning profile or none. */
+static int init_tuning(struct data *data, const struct fir_bank *bank, int may_run,
+                       struct autotune_profile *profile) {
+    const struct options *options = data->options;
+    char *path = autotune_profile_path(options->quantum);
+
+    if (!options->retune && !options->kernel &&
+        autotune_load(path, bank, options->quantum, profile) == 0) {
+        printf("Loaded tuning profile %s\n", path);
+        free(path);
+        return 0;
+    }
+    if (!may_run) {
+        free(path);
         return -1;
     }
 
-    channel->current = fir_filter_clone(&FIR_FILTERS[0]);
-    if (!channel->current) {
-        fprintf(stderr, "Failed to clone initial FIR filter\n");
-        delay_line_free(channel->delay_line);
-        channel->delay_line = NULL;
+    printf("Tuning FIR kernels for a %d sample quantum...\n", options->quantum);
+    if (autotune_run(bank, options->quantum, data->num_channels, options->kernel, profile) != 0) {
+        free(path);
         return -1;
     }
 
+    /* A profile limited to a forced kernel would mislead later runs without --kernel. */
+    if (path && !options->kernel && autotune_save(path, profile) == 0) {
+        printf("Saved tuning profile %s\n", path);
+    }
+    free(path);
     return 0;
 }
 
-static int init_fir_filters(struct data *data) {
-    const int delay_size = MAX_FILTER_ORDER * 4;
+/* Swaps the stock bank for a reduced one; the tuning profile then follows the shorter filters. */
+static int init_quality(struct profile *profile) {
+    const struct fir_quality *quality = &profile->tier.quality;
+    if (quality->phase == FIR_PHASE_LINEAR && quality->divisor == 1) {
+        return 0;
+    }
 
-    for (int ch = 0; ch < NUM_CHANNELS; ch++) {
-        if (init_channel(&data->channels[ch], delay_size) != 0) {
-            for (int i = 0; i < ch; i++) {
-                if (data->channels[i].current) {
-                    fir_filter_free(data->channels[i].current);
-                }
-                if (data->channels[i].delay_line) {
-                    delay_line_free(data->channels[i].delay_line);
-                }
-            }
-            return -1;
-        }
+    struct fir_bank *reduced = fir_bank_reduce(profile->bank, quality);
+    if (!reduced) {
+        fprintf(stderr, "Failed to build %s quality filters\n", profile->quality_name);
+        return -1;
     }
 
-    data->current_rate = 44100;
-    printf("FIR filters initialized for %d channels\n", NUM_CHANNELS);
+    for (int i = 0; i < reduced->num_filters; i++) {
+        const struct fir_filter *filter = &reduced->filters[i];
+        const struct fir_filter *stock = &profile->bank->filters[i];
+
+        printf("Quality %s: %d Hz uses %d of %d taps, %.2f dB max deviation, %.2f ms delay\n",
+               profile->quality_name, filter->rate, filter->order, stock->order,
+               fir_filter_response_error(filter, stock), 1e3 * fir_filter_peak(filter) / filter->rate);
+    }
+
+    fir_bank_free(profile->bank);
+    profile->bank = reduced;
     return 0;
 }
 
-static void cleanup_channel(struct channel *channel) {
-    if (channel->current) {
-        fir_filter_free(channel->current);
-        channel->current = NULL;
+static int multirate_selected(const struct options *options, int rate) {
+    if (options->multirate_all) {
+        return 1;
     }
-    if (channel->delay_line) {
-        delay_line_free(channel->delay_line);
-        channel->delay_line = NULL;
+    for (int i = 0; i < options->num_multirate_rates; i++) {
+        if (options->multirate_rates[i] == rate) {
+            return 1;
+        }
     }
+    return 0;
 }
 
-static void cleanup_fir_filters(struct data *data) {
-    for (int ch = 0; ch < NUM_CHANNELS; ch++) {
-        cleanup_channel(&data->channels[ch]);
+/* Leaves the slot to the full-rate convolver when no filter in the bank divides its rate. */
+static int init_multirate_slot(struct data *data, const struct profile *profile, struct rate_slot *slot) {
+    const struct fir_filter *base = multirate_find_base(profile->bank, slot->filter->rate);
+    if (!base) {
+        printf("No filter divides %d Hz, filtering it at the full rate\n", slot->filter->rate);
+        return 0;
+    }
+
+    slot->multirate = multirate_init(base, slot->filter->rate, FFT_BLOCK_SIZE, data->num_channels);
+    if (!slot->multirate) {
+        return -1;
     }
+
+    printf("Filtering %d Hz through the %d Hz filter at 1/%d rate (%.2f ms delay)\n", slot->filter->rate,
+           base->rate, multirate_factor(slot->multirate),
+           1e3 * multirate_latency(slot->multirate) / slot->filter->rate);
+    return 0;
 }
 
-static int update_channel_filter(struct channel *channel, int rate) {
-    const struct fir_filter *new_filter = NULL;
+/*
+ * Builds every rate of the bank at path, or of the compiled-in filters without one. The first
+ * profile selects the kernel; later ones are built while the data thread filters with it, so they
+ * keep it and take engines from a saved tuning profile or the cost model.
+ */
+static struct profile *profile_init(struct data *data, const char *path, const struct tier *tier, int first) {
+    const struct options *options = data->options;
+    struct profile *profile = calloc(1, sizeof(struct profile));
+    if (!profile) {
+        fprintf(stderr, "Failed to allocate memory for profile\n");
+        return NULL;
+    }
+    snprintf(profile->name, sizeof(profile->name), "%s", path ? path : BUILTIN_PROFILE);
+    profile->builtin = !path;
+    profile->tier = *tier;
+    fir_quality_format(&tier->quality, profile->quality_name, sizeof(profile->quality_name));
 
-    for (int i = 0; i < 6; i++) {
-        if (rate == FIR_FILTERS[i].rate) {
-            new_filter = fir_filter_clone(&FIR_FILTERS[i]);
-            break;
+    profile->bank = fir_bank_load(path);
+    if (!profile->bank) {
+        fprintf(stderr, "Failed to build FIR coefficient bank\n");
+        profile_free(profile);
+        return NULL;
+    }
+
+    if (profile->bank->num_filters > MAX_FILTERS) {
+        fprintf(stderr, "Too many filters in the coefficient bank (%d, max %d)\n",
+                profile->bank->num_filters, MAX_FILTERS);
+        profile_free(profile);
+        return NULL;
+    }
+    for (int i = 0; i < profile->bank->num_filters; i++) {
+        if (profile->bank->filters[i].order > MAX_FILTER_ORDER) {
+            fprintf(stderr, "Filter for rate %d has %d taps, max %d\n", profile->bank->filters[i].rate,
+                    profile->bank->filters[i].order, MAX_FILTER_ORDER);
+            profile_free(profile);
+            return NULL;
+        }
+    }
+
+    if (init_quality(profile) != 0 || fir_bank_set_precision(profile->bank, options->precision) != 0) {
+        profile_free(profile);
+        return NULL;
+    }
+
+    /* The engines the tuner only tries out would litter the shared directory. */
+    struct autotune_profile tuning;
+    convolver_set_shared_spectra(0);
+    const int tuned = options->tune && init_tuning(data, profile->bank, first, &tuning) == 0;
+    convolver_set_shared_spectra(1);
+
+    if (tuned && first && fir_kernel_select(tuning.kernel) != 0) {
+        profile_free(profile);
+        return NULL;
+    }
+
+    for (int i = 0; i < profile->bank->num_filters; i++) {
+        struct rate_slot *slot = &profile->slots[i];
+        const struct fir_filter *filter = &profile->bank->filters[i];
+        const struct autotune_rate *choice = tuned ? autotune_find_rate(&tuning, filter->rate) : NULL;
+
+        profile->num_slots = i + 1;
+        slot->filter = filter;
+        if ((tier->multirate_all || multirate_selected(options, filter->rate)) &&
+            init_multirate_slot(data, profile, slot) != 0) {
+            profile_free(profile);
+            return NULL;
+        }
+        /* A multirate slot runs its base filter with the default engine, the profile is for the full rate. */
+        if (!slot->multirate && options->pipelined) {
+            slot->conv = convolver_init_engine(slot->filter, FFT_BLOCK_SIZE, data->num_channels,
+                                               CONVOLVER_ENGINE_PIPELINED);
+        } else if (!slot->multirate && choice) {
+            slot->conv = convolver_init_engine(slot->filter, choice->block_size, data->num_channels,
+                                               choice->engine);
+        } else if (!slot->multirate) {
+            slot->conv = convolver_init(slot->filter, FFT_BLOCK_SIZE, data->num_channels);
+        }
+        if (!slot->conv && !slot->multirate) {
+            fprintf(stderr, "Failed to initialize convolver for rate %d\n", filter->rate);
+            profile_free(profile);
+            return NULL;
+        }
+
+        /* Unsupported rates fall back to the highest-rate filter. */
+        if (!profile->fallback || filter->rate > profile->fallback->filter->rate) {
+            profile->fallback = slot;
         }
     }
+    return profile;
+}
+
+static int init_fir_filters(struct data *data, const struct options *options) {
+    data->options = options;
+    if (options->precision != FIR_PRECISION_FP32) {
+        printf("Storing direct-form coefficients as %s\n", fir_precision_name(options->precision));
+    }
+
+    data->profile = profile_init(data, options->coefficients, &data->governor.tiers[0], 1);
+    if (!data->profile) {
+        return -1;
+    }
+    data->latest = data->profile;
 
-    if (!new_filter) {
-        new_filter = fir_filter_clone(&FIR_FILTERS[5]);
+    /* Allocated up front so a later profile switch can fade on the data thread without allocating. */
+    for (int ch = 0; ch < data->num_channels; ch++) {
+        data->fade_buffers[ch] = fir_memory_alloc(MAX_QUANTUM * sizeof(float));
+        if (!data->fade_buffers[ch]) {
+            fprintf(stderr, "Failed to allocate memory for profile fades\n");
+            cleanup_fir_filters(data);
+            return -1;
+        }
     }
 
-    if (!new_filter) {
-        fprintf(stderr, "Failed to clone filter for rate %d\n", rate);
+    /* The delay lines start out sized for the first rate and the quantum the engines were tuned for. */
+    struct rate_slot *first = &data->profile->slots[0];
+    data->delay_history = slot_history(first);
+    data->delay_span = options->quantum;
+    data->requested_history = data->delay_history;
+    data->requested_span = data->delay_span;
+    data->delays = delay_set_init(data->delay_history, data->delay_span, data->num_channels);
+    if (!data->delays) {
+        cleanup_fir_filters(data);
         return -1;
     }
 
-    const struct fir_filter *old_filter = channel->current;
-    channel->current = new_filter;
-    fir_filter_free(old_filter);
+    atomic_store(&data->active, first);
+    data->current_rate = first->filter->rate;
+    atomic_store(&data->format_rate, data->current_rate);
+    printf("FIR filters initialized for %d channels (kernel: %s)\n", data->num_channels, fir_kernel_name());
+    return 0;
+}
+
+static struct rate_slot *find_slot(struct profile *profile, int rate) {
+    for (int i = 0; i < profile->num_slots; i++) {
+        if (profile->slots[i].filter->rate == rate) {
+            return &profile->slots[i];
+        }
+    }
+
+    const int num_derived = atomic_load_explicit(&profile->num_derived, memory_order_acquire);
+    for (int i = 0; i < num_derived; i++) {
+        if (profile->derived[i].filter->rate == rate) {
+            return &profile->derived[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Main loop only; the data thread reads the derived slots of a profile the main loop may extend. */
+static void derive_filter(struct data *data, struct profile *profile, int rate) {
+    const int num_derived = atomic_load_explicit(&profile->num_derived, memory_order_relaxed);
+
+    if (rate <= 0 || find_slot(profile, rate)) {
+        return;
+    }
+    if (num_derived >= MAX_DERIVED_FILTERS) {
+        fprintf(stderr, "Too many derived filters, keeping the %d Hz filter for %d Hz\n",
+                profile->fallback->filter->rate, rate);
+        return;
+    }
+
+    const struct fir_filter *source = fir_bank_nearest(profile->bank, rate);
+    struct fir_filter *filter = fir_filter_resample(source, rate, MAX_FILTER_ORDER);
+    if (!filter) {
+        return;
+    }
+
+    struct convolver *conv = data->options->pipelined ?
+        convolver_init_engine(filter, FFT_BLOCK_SIZE, data->num_channels, CONVOLVER_ENGINE_PIPELINED) :
+        convolver_init(filter, FFT_BLOCK_SIZE, data->num_channels);
+    if (!conv) {
+        fir_filter_free(filter);
+        return;
+    }
+
+    struct rate_slot *slot = &profile->derived[num_derived];
+    slot->filter = filter;
+    slot->conv = conv;
+    atomic_store_explicit(&profile->num_derived, num_derived + 1, memory_order_release);
+    atomic_fetch_add_explicit(&profile->derived_generation, 1, memory_order_release);
+
+    printf("Derived a %d-tap filter for %d Hz from the %d Hz filter\n", filter->order, rate, source->rate);
+}
+
+static int request_derived_filter(struct spa_loop *loop, bool async, uint32_t seq,
+                                  const void *message, size_t size, void *user_data) {
+    struct data *data = user_data;
+    derive_filter(data, data->latest, *(const int *) message);
+    return 0;
+}
+
+static int report_rate_change(struct spa_loop *loop, bool async, uint32_t seq,
+                              const void *message, size_t size, void *user_data) {
+    const struct rate_report *report = message;
+
+    if (report->rate != report->requested_rate) {
+        printf("No FIR filter for rate=%d Hz yet, using the %d Hz filter until one is derived\n",
+               report->requested_rate, report->rate);
+    }
+    if (report->factor > 1) {
+        printf("Selected FIR filter for rate=%d Hz (multirate through %d Hz at 1/%d rate)\n",
+               report->rate, report->base_rate, report->factor);
+    } else {
+        printf("Selected FIR filter for rate=%d Hz (order=%d, engine=%s)\n",
+               report->rate, report->order, convolver_engine_name(report->engine));
+    }
+    return 0;
+}
+
+static int report_data_thread(struct spa_loop *loop, bool async, uint32_t seq,
+                              const void *message, size_t size, void *user_data) {
+    const int error = *(const int *) message;
+
+    if (error != 0) {
+        fprintf(stderr, "Failed to pin the data thread: %s\n", strerror(error));
+    } else {
+        printf("Data thread pinned\n");
+    }
+    return 0;
+}
+
+/* Touches the stack the data thread may grow into, so even a deep first cycle does not fault. */
+static void __attribute__((noinline)) prefault_stack(void) {
+    volatile char stack[STACK_PREFAULT_BYTES];
+
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+/* First cycle only; pinning here is the one way to reach PipeWire's data thread. */
+static void setup_data_thread(struct data *data) {
+    data->setup_data_thread = 0;
+
+    if (data->realtime_memory) {
+        prefault_stack();
+    }
+    if (CPU_COUNT(&data->data_cpus) > 0) {
+        const int error = pthread_setaffinity_np(pthread_self(), sizeof(data->data_cpus), &data->data_cpus);
+        pw_loop_invoke(pw_main_loop_get_loop(data->loop), report_data_thread, 0,
+                       &error, sizeof(error), false, data);
+    }
+}
+
+static int report_oversized_quantum(struct spa_loop *loop, bool async, uint32_t seq,
+                                    const void *message, size_t size, void *user_data) {
+    printf("Warning: too many samples (%d) in one process call\n", *(const int *) message);
+    return 0;
+}
+
+/* Main loop only; the data thread picks the new lines up at the start of its next cycle. */
+static void resize_delay_lines(struct data *data, int history, int span) {
+    span = span < MAX_QUANTUM ? span : MAX_QUANTUM;
+    if (history == data->delay_history && span <= data->delay_span) {
+        return;
+    }
+    span = span > data->delay_span ? span : data->delay_span;
+
+    struct delay_set *set = delay_set_init(history, span, data->num_channels);
+    if (!set) {
+        return;
+    }
+
+    data->delay_history = history;
+    data->delay_span = span;
+    set = atomic_exchange_explicit(&data->pending_delays, set, memory_order_acq_rel);
+    delay_set_free(set, data->num_channels);
+    printf("Delay lines resized to %d samples (%d of history, quanta up to %d)\n", history + span, history,
+           span);
+}
+
+struct delay_request {
+    int history;
+    int span;
+};
+
+static int request_delay_lines(struct spa_loop *loop, bool async, uint32_t seq,
+                               const void *message, size_t size, void *user_data) {
+    const struct delay_request *request = message;
+    resize_delay_lines(user_data, request->history, request->span);
+    return 0;
+}
+
+static int release_delay_lines(struct spa_loop *loop, bool async, uint32_t seq,
+                               const void *message, size_t size, void *user_data) {
+    struct data *data = user_data;
+    delay_set_free(*(struct delay_set *const *) message, data->num_channels);
+    return 0;
+}
+
+/* Data thread: switches to lines built by the main loop, carrying the newest samples over. */
+static void adopt_delay_lines(struct data *data) {
+    struct delay_set *set = atomic_exchange_explicit(&data->pending_delays, NULL, memory_order_acquire);
+    if (!set) {
+        return;
+    }
+
+    struct delay_set *old = data->delays;
+    for (int ch = 0; ch < data->num_channels; ch++) {
+        const struct delay_line *from = old->lines[ch];
+        const size_t keep = from->size < set->lines[ch]->size ? from->size : set->lines[ch]->size;
+
+        delay_line_append_samples(set->lines[ch], from->buffer + from->index - keep, (int) keep);
+    }
+    data->delays = set;
+    /* Lines resized for another profile or rate than the one playing are asked for again. */
+    data->requested_history = set->history;
+    data->requested_span = set->span;
+    pw_loop_invoke(pw_main_loop_get_loop(data->loop), release_delay_lines, 0,
+                   &old, sizeof(old), false, data);
+}
+
+/* History the slots filtering this cycle read: the active one and, during a fade, the old one. */
+static int playing_history(const struct data *data) {
+    const int history = slot_history(data->job.slot);
+
+    if (data->fade_slot && slot_history(data->fade_slot) > history) {
+        return slot_history(data->fade_slot);
+    }
+    return history;
+}
+
+static struct rate_slot *profile_slot(struct profile *profile, int rate) {
+    struct rate_slot *slot = find_slot(profile, rate);
+    return slot ? slot : profile->fallback;
+}
+
+/* Data thread: asks once for lines that fit the playing filters, the next profile's and the largest
+ * quantum seen. */
+static void check_delay_lines(struct data *data, int n_samples) {
+    int history = playing_history(data);
+
+    if (data->incoming && slot_history(profile_slot(data->incoming, data->current_rate)) > history) {
+        history = slot_history(profile_slot(data->incoming, data->current_rate));
+    }
+
+    const struct delay_request request = {
+        .history = history,
+        .span = n_samples > data->requested_span ? n_samples : data->requested_span,
+    };
+
+    if (request.history == data->requested_history && request.span == data->requested_span) {
+        return;
+    }
+    data->requested_history = request.history;
+    data->requested_span = request.span;
+    pw_loop_invoke(pw_main_loop_get_loop(data->loop), request_delay_lines, 0,
+                   &request, sizeof(request), false, data);
+}
+
+static void reset_slot(struct rate_slot *slot) {
+    if (slot->multirate) {
+        multirate_reset(slot->multirate);
+    } else {
+        convolver_reset(slot->conv);
+    }
+}
+
+struct profile_switch {
+    struct profile *old;
+    const struct profile *current;
+};
 
+static int release_profile(struct spa_loop *loop, bool async, uint32_t seq,
+                           const void *message, size_t size, void *user_data) {
+    struct data *data = user_data;
+    const struct profile_switch *report = message;
+    const struct spa_dict_item items[] = {
+        SPA_DICT_ITEM_INIT(PROFILE_PARAM, report->current->name),
+        SPA_DICT_ITEM_INIT("fir.quality", report->current->quality_name),
+    };
+    const struct spa_dict dict = SPA_DICT_INIT_ARRAY(items);
+
+    /* The data thread releases current only after this message, so its name is still there. */
+    pw_filter_update_properties(data->filter, NULL, &dict);
+    printf("Switched to profile %s (quality %s)\n", report->current->name, report->current->quality_name);
+    if (report->current == data->latest && data->governor.switching) {
+        data->governor.switching = 0;
+        data->governor.hold = GOVERNOR_HOLD_INTERVALS;
+    }
+    profile_free(report->old);
     return 0;
 }
 
+/* Data thread: hands the profile faded out of back to the main loop. */
+static void finish_fade(struct data *data) {
+    const struct profile_switch report = {data->fading, data->profile};
+
+    data->fading = NULL;
+    data->fade_slot = NULL;
+    pw_loop_invoke(pw_main_loop_get_loop(data->loop), release_profile, 0,
+                   &report, sizeof(report), false, data);
+}
+
+/*
+ * Data thread: takes over a profile the main loop published and switches to it once the delay
+ * lines hold enough history for it. The old filter keeps playing while the new one warms up over
+ * its memory, then the two are crossfaded.
+ */
+static void adopt_profile(struct data *data) {
+    if (!data->incoming && !data->fading) {
+        data->incoming = atomic_exchange_explicit(&data->pending_profile, NULL, memory_order_acquire);
+    }
+    if (!data->incoming) {
+        return;
+    }
+
+    struct rate_slot *slot = profile_slot(data->incoming, data->current_rate);
+    if (slot_history(slot) > data->delays->history) {
+        return;
+    }
+
+    data->fading = data->profile;
+    data->fade_slot = atomic_load_explicit(&data->active, memory_order_relaxed);
+    data->profile = data->incoming;
+    data->incoming = NULL;
+    data->seen_generation = atomic_load_explicit(&data->profile->derived_generation, memory_order_acquire);
+
+    reset_slot(slot);
+    atomic_store_explicit(&data->active, slot, memory_order_release);
+    data->fade_warmup = slot_memory(slot);
+    data->fade_length = data->current_rate * PROFILE_FADE_MS / 1000;
+    data->fade_position = 0;
+}
+
+/* Runs on the data thread: every rate is prepared up front, so switching is a pointer swap. */
 static void select_filter_for_rate(struct data *data, int rate) {
-    int actual_rate = rate;
+    struct rate_slot *slot = find_slot(data->profile, rate);
+
+    if (!slot) {
+        slot = data->profile->fallback;
+        pw_loop_invoke(pw_main_loop_get_loop(data->loop), request_derived_filter, 0,
+                       &rate, sizeof(rate), false, data);
+    }
+
+    if (slot != atomic_load_explicit(&data->active, memory_order_relaxed)) {
+        /* The old profile has nothing to fade from at the new rate. */
+        if (data->fading) {
+            finish_fade(data);
+        }
+        reset_slot(slot);
+        atomic_store_explicit(&data->active, slot, memory_order_release);
+    }
+    data->current_rate = rate;
+
+    const struct rate_report report = {
+        .requested_rate = rate,
+        .rate = slot->filter->rate,
+        .order = slot->filter->order,
+        .engine = slot->conv ? convolver_get_engine(slot->conv) : CONVOLVER_ENGINE_DIRECT,
+        .base_rate = slot->multirate ? slot->filter->rate / multirate_factor(slot->multirate) : 0,
+        .factor = slot->multirate ? multirate_factor(slot->multirate) : 1,
+    };
+    pw_loop_invoke(pw_main_loop_get_loop(data->loop), report_rate_change, 0,
+                   &report, sizeof(report), false, data);
+}
+
+static int trailing_zeros(const float *samples, int count) {
+    int zeros = 0;
+    while (zeros < count && samples[count - 1 - zeros] == 0.0f) {
+        zeros++;
+    }
+    return zeros;
+}
+
+/*
+ * Returns how many channels can skip filtering: their whole window is zeros, so is the output.
+ * Only looks at the inputs; ingest_channels moves them into the delay lines later.
+ */
+static int scan_inputs(struct data *data) {
+    struct process_job *job = &data->job;
+    const int memory = slot_memory(job->slot);
+    const int fade_memory = data->fade_slot ? slot_memory(data->fade_slot) : 0;
+    const int window = (memory > fade_memory ? memory : fade_memory) + job->n_samples;
+    int num_silent = 0;
+
+    for (int ch = 0; ch < data->num_channels; ch++) {
+        struct channel *channel = &data->channels[ch];
+        const int zeros = trailing_zeros(job->inputs[ch], job->n_samples);
+
+        job->delay_lines[ch] = data->delays->lines[ch];
+
+        if (zeros < job->n_samples) {
+            channel->silent = zeros;
+        } else if (channel->silent < INT_MAX - zeros) {
+            channel->silent += zeros;
+        }
+        job->silent[ch] = channel->silent >= window;
+        num_silent += job->silent[ch];
+    }
+    return num_silent;
+}
+
+/*
+ * Copies the inputs into the delay lines right before the same channels are filtered, on the
+ * thread filtering them, so the kernels read the quantum back from cache instead of memory.
+ * Returns the ticks it took.
+ */
+static uint64_t ingest_channels(struct data *data, int first, int count) {
+    struct process_job *job = &data->job;
+    const uint64_t start = stats_now();
+
+    for (int ch = first; ch < first + count; ch++) {
+        delay_line_append_samples(data->delays->lines[ch], job->inputs[ch], job->n_samples);
+    }
+    return stats_now() - start;
+}
+
+static void skip_channels(struct data *data, int first, int count) {
+    struct process_job *job = &data->job;
+    const struct rate_slot *slot = job->slot;
 
-    for (int ch = 0; ch < NUM_CHANNELS; ch++) {
-        if (update_channel_filter(&data->channels[ch], rate) != 0) {
-            update_channel_filter(&data->channels[ch], FIR_FILTERS[5].rate);
-            actual_rate = FIR_FILTERS[5].rate;
+    for (int ch = first; ch < first + count; ch++) {
+        memset(job->outputs[ch], 0, job->n_samples * sizeof(float));
+    }
+    if (slot->multirate) {
+        multirate_skip_channels(slot->multirate, first, count, job->n_samples);
+    } else {
+        convolver_skip_channels(slot->conv, first, count, job->n_samples);
+    }
+}
+
+static void apply_channels(struct data *data, int first, int count) {
+    struct process_job *job = &data->job;
+    const struct rate_slot *slot = job->slot;
+
+    if (slot->multirate) {
+        multirate_apply_channels(slot->multirate, first, count, &job->delay_lines[first],
+                                 job->n_samples, &job->outputs[first]);
+    } else {
+        convolver_apply_channels(slot->conv, first, count, &job->delay_lines[first],
+                                 job->n_samples, &job->outputs[first]);
+    }
+}
+
+/* Filters runs of channels together and skips the silent runs between them. */
+static void process_channels(struct data *data, int first, int count) {
+    const bool *silent = data->job.silent;
+    const int end = first + count;
+
+    for (int from = first; from < end;) {
+        int to = from + 1;
+        while (to < end && silent[to] == silent[from]) {
+            to++;
+        }
+
+        if (silent[from]) {
+            skip_channels(data, from, to - from);
+        } else {
+            apply_channels(data, from, to - from);
+        }
+        from = to;
+    }
+}
+
+static void process_channel_group(void *userdata, int task) {
+    struct data *data = userdata;
+    const int first = task * CHANNELS_PER_TASK;
+    int count = data->num_channels - first;
+
+    if (count > CHANNELS_PER_TASK) {
+        count = CHANNELS_PER_TASK;
+    }
+
+    fir_flush_denormals();
+    data->job.ingest_ticks[task] = data->job.ingest ? ingest_channels(data, first, count) : 0;
+    process_channels(data, first, count);
+}
+
+/*
+ * Returns the ticks the ingest added to the wall time: the slowest worker's share when the
+ * groups run in parallel, all of it otherwise.
+ */
+static uint64_t run_job(struct data *data, int num_silent) {
+    uint64_t ingest_ticks = 0;
+
+    if (worker_pool_size(data->pool) > 0 && num_silent < data->num_channels) {
+        const int num_tasks = (data->num_channels + CHANNELS_PER_TASK - 1) / CHANNELS_PER_TASK;
+        worker_pool_run(data->pool, process_channel_group, data, num_tasks);
+        for (int task = 0; task < num_tasks; task++) {
+            if (data->job.ingest_ticks[task] > ingest_ticks) {
+                ingest_ticks = data->job.ingest_ticks[task];
+            }
+        }
+        return ingest_ticks;
+    }
+
+    /* Batches as wide as the multi-channel kernels, small enough to stay in cache once appended. */
+    for (int first = 0; first < data->num_channels; first += INGEST_BATCH) {
+        const int count = data->num_channels - first < INGEST_BATCH ? data->num_channels - first : INGEST_BATCH;
+
+        if (data->job.ingest) {
+            ingest_ticks += ingest_channels(data, first, count);
+        }
+        process_channels(data, first, count);
+    }
+    return ingest_ticks;
+}
+
+/* Runs the old profile into the fade buffers and ramps linearly from it to the new output. */
+static void fade_chunk(struct data *data, int num_silent) {
+    struct process_job *job = &data->job;
+    const struct rate_slot *slot = job->slot;
+    float *outputs[MAX_CHANNELS];
+
+    memcpy(outputs, job->outputs, sizeof(outputs));
+    job->slot = data->fade_slot;
+    memcpy(job->outputs, data->fade_buffers, sizeof(job->outputs));
+    run_job(data, num_silent);
+    job->slot = slot;
+    memcpy(job->outputs, outputs, sizeof(job->outputs));
+
+    const int start = data->fade_position - data->fade_warmup;
+    for (int ch = 0; ch < data->num_channels; ch++) {
+        const float *old = data->fade_buffers[ch];
+        float *out = job->outputs[ch];
+
+        for (int i = 0; i < job->n_samples; i++) {
+            const int t = start + i;
+            const float gain = t <= 0 ? 0.0f : t >= data->fade_length ? 1.0f : (float) t / data->fade_length;
+            out[i] = old[i] + gain * (out[i] - old[i]);
         }
     }
 
-    data->current_rate = actual_rate;
-    printf("Selected FIR filter for rate=%d Hz (order=%d)\n",
-           data->current_rate, data->channels[0].current->order);
+    data->fade_position += job->n_samples;
+    if (data->fade_position >= data->fade_warmup + data->fade_length) {
+        finish_fade(data);
+    }
 }
 
 static void on_filter_process(void *userdata, struct spa_io_position *position) {
     struct data *data = userdata;
+    const uint64_t start = stats_now();
 
     if (position == NULL) {
         return;
     }
 
+    /* Decaying filter tails would otherwise run into denormal slow paths. */
+    fir_flush_denormals();
+
+    if (data->setup_data_thread) {
+        setup_data_thread(data);
+    }
+
     int n_samples = (int) position->clock.duration;
 
     if (position->clock.duration ^ n_samples) {
-        printf("Warning: too many samples (%d) in one process call\n", n_samples);
+        pw_loop_invoke(pw_main_loop_get_loop(data->loop), report_oversized_quantum, 0,
+                       &n_samples, sizeof(n_samples), false, data);
     }
 
     int rate = position->clock.rate.denom;
-    if (rate > 0 && rate != data->current_rate) {
+    if (rate <= 0) {
+        rate = atomic_load_explicit(&data->format_rate, memory_order_relaxed);
+    }
+    /* A filter derived for the current rate replaces the fallback as soon as it is published. */
+    const unsigned int generation = atomic_load_explicit(&data->profile->derived_generation,
+                                                         memory_order_acquire);
+    const struct rate_slot *active = atomic_load_explicit(&data->active, memory_order_relaxed);
+
+    if (rate > 0 && (rate != data->current_rate ||
+                     (generation != data->seen_generation && active->filter->rate != rate))) {
+        data->seen_generation = generation;
         select_filter_for_rate(data, rate);
     }
 
-    float *input_buffers[NUM_CHANNELS];
-    float *output_buffers[NUM_CHANNELS];
+    float *input_buffers[MAX_CHANNELS];
+    float *output_buffers[MAX_CHANNELS];
     bool all_buffers_valid = true;
 
-    for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+    for (int ch = 0; ch < data->num_channels; ch++) {
         input_buffers[ch] = pw_filter_get_dsp_buffer(data->channels[ch].in_port, n_samples);
         output_buffers[ch] = pw_filter_get_dsp_buffer(data->channels[ch].out_port, n_samples);
 
@@ -178,7 +1067,7 @@ static void on_filter_process(void *userdata, struct spa_io_position *position)
     }
 
     if (!all_buffers_valid) {
-        for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+        for (int ch = 0; ch < data->num_channels; ch++) {
             if (output_buffers[ch]) {
                 memset(output_buffers[ch], 0, n_samples * sizeof(float));
             }
@@ -186,15 +1075,251 @@ static void on_filter_process(void *userdata, struct spa_io_position *position)
         return;
     }
 
-    for (int ch = 0; ch < NUM_CHANNELS; ch++) {
-        struct channel *channel = &data->channels[ch];
+    struct process_job *job = &data->job;
+    adopt_delay_lines(data);
+    adopt_profile(data);
+    job->slot = atomic_load_explicit(&data->active, memory_order_acquire);
+    check_delay_lines(data, n_samples);
+
+    /* Quanta larger than the lines hold are filtered in pieces; until lines long enough for a
+     * new filter arrive, the output stays silent. A fade also works in pieces its buffers hold. */
+    int room = (int) data->delays->lines[0]->size - playing_history(data);
+    if (data->fade_slot && room > MAX_QUANTUM) {
+        room = MAX_QUANTUM;
+    }
+    /* The append phase is the silence scan plus the copies into the lines, wherever they run. */
+    uint64_t append_ticks = 0;
+
+    for (int done = 0; done < n_samples; done += job->n_samples) {
+        const uint64_t chunk_start = stats_now();
+
+        job->n_samples = room > 0 && room < n_samples - done ? room : n_samples - done;
+        for (int ch = 0; ch < data->num_channels; ch++) {
+            job->inputs[ch] = input_buffers[ch] + done;
+            job->outputs[ch] = output_buffers[ch] + done;
+        }
+
+        const int num_silent = scan_inputs(data);
+        append_ticks += stats_now() - chunk_start;
+
+        if (room <= 0) {
+            append_ticks += ingest_channels(data, 0, data->num_channels);
+            for (int ch = 0; ch < data->num_channels; ch++) {
+                memset(job->outputs[ch], 0, job->n_samples * sizeof(float));
+            }
+        } else {
+            /* The old profile of a fade reads the lines the new one already filled. */
+            job->ingest = true;
+            append_ticks += run_job(data, num_silent);
+            job->ingest = false;
+            if (data->fade_slot) {
+                fade_chunk(data, num_silent);
+            }
+        }
+    }
+
+    if (data->stats) {
+        const uint64_t end = stats_now();
+        const struct stats_record record = {
+            .ticks = {
+                [STATS_PHASE_APPEND] = append_ticks,
+                [STATS_PHASE_CONVOLVE] = end - start - append_ticks,
+                [STATS_PHASE_TOTAL] = end - start,
+            },
+            .n_samples = (uint32_t) n_samples,
+            .rate = (uint32_t) rate,
+        };
+        stats_push(data->stats, &record);
+    }
+}
+
+/* Main loop: builds the profile at path, or the compiled-in one, and hands it to the data thread. */
+static int load_profile(struct data *data, const char *path, const struct tier *tier) {
+    printf("Loading profile %s\n", path ? path : BUILTIN_PROFILE);
 
-        delay_line_append_samples(channel->current, channel->delay_line,
-                                  input_buffers[ch], n_samples);
+    struct profile *profile = profile_init(data, path, tier, 0);
+    if (!profile) {
+        fprintf(stderr, "Keeping profile %s\n", data->latest->name);
+        return -1;
+    }
+
+    /* The data thread switches once the lines hold the new filter's history as well as the old one's. */
+    const int rate = atomic_load(&data->format_rate);
+    derive_filter(data, profile, rate);
+
+    const int history = slot_history(profile_slot(profile, rate));
+    if (history > data->delay_history) {
+        resize_delay_lines(data, history, data->delay_span);
+    }
+
+    data->latest = profile;
+    data->governor.switching = 1;
+    profile_free(atomic_exchange_explicit(&data->pending_profile, profile, memory_order_acq_rel));
+    return 0;
+}
+
+static void format_tier(const struct tier *tier, char *buffer, size_t size) {
+    char quality[MAX_NAME_LENGTH];
+
+    fir_quality_format(&tier->quality, quality, sizeof(quality));
+    snprintf(buffer, size, "%s%s", quality, tier->multirate_all ? " multirate" : "");
+}
+
+/* Every tier below the configured one is multirate, then each named quality cheaper than it. */
+static void init_governor(struct data *data, const struct options *options) {
+    struct governor *governor = &data->governor;
+
+    governor->tiers[0] = (struct tier) {options->quality, options->multirate_all};
+    governor->num_tiers = 1;
+    if (!options->governor) {
+        return;
+    }
+    if (options->stats_interval <= 0) {
+        fprintf(stderr, "The load governor needs DSP statistics, leaving it off\n");
+        return;
+    }
+
+    if (!options->multirate_all) {
+        governor->tiers[governor->num_tiers++] = (struct tier) {options->quality, 1};
+    }
+    for (int i = 0; i < fir_quality_count() && governor->num_tiers < MAX_TIERS; i++) {
+        struct fir_quality quality;
+        if (fir_quality_from_name(fir_quality_name_at(i), &quality) == 0 &&
+            quality.divisor > options->quality.divisor) {
+            governor->tiers[governor->num_tiers++] = (struct tier) {quality, 1};
+        }
+    }
+    governor->enabled = 1;
+
+    char name[2 * MAX_NAME_LENGTH];
+    format_tier(&governor->tiers[governor->num_tiers - 1], name, sizeof(name));
+    printf("Load governor on, %d tiers down to %s\n", governor->num_tiers, name);
+}
+
+/* Main loop, once per stats interval. */
+static void govern_load(struct data *data, const struct stats_summary *summary) {
+    struct governor *governor = &data->governor;
+    const int overran = summary->total_xruns > governor->xruns;
+
+    governor->xruns = summary->total_xruns;
+    if (!governor->enabled || governor->switching) {
+        return;
+    }
+    if (governor->hold > 0) {
+        governor->hold--;
+        return;
+    }
+
+    int level = governor->level;
+    governor->calm = summary->load_p99 < GOVERNOR_LOW_LOAD ? governor->calm + 1 : 0;
+    if ((overran || summary->load_p99 > GOVERNOR_HIGH_LOAD) && level + 1 < governor->num_tiers) {
+        level++;
+    } else if (governor->calm >= GOVERNOR_RESTORE_INTERVALS && level > 0) {
+        level--;
+    }
+    if (level == governor->level) {
+        return;
+    }
+
+    char name[2 * MAX_NAME_LENGTH];
+    format_tier(&governor->tiers[level], name, sizeof(name));
+    printf("Load governor: p99 load %.1f%%%s, switching to %s\n", summary->load_p99,
+           overran ? " with overruns" : "", name);
+
+    governor->calm = 0;
+    if (load_profile(data, data->latest->builtin ? NULL : data->latest->name, &governor->tiers[level]) != 0) {
+        return;
+    }
+    governor->level = level;
+    governor->switches++;
+
+    char values[2][16];
+    snprintf(values[0], sizeof(values[0]), "%d", level);
+    snprintf(values[1], sizeof(values[1]), "%u", governor->switches);
+
+    const struct spa_dict_item items[] = {
+        SPA_DICT_ITEM_INIT("fir.stats.governor.tier", name),
+        SPA_DICT_ITEM_INIT("fir.stats.governor.level", values[0]),
+        SPA_DICT_ITEM_INIT("fir.stats.governor.switches", values[1]),
+    };
+    const struct spa_dict dict = SPA_DICT_INIT_ARRAY(items);
+    pw_filter_update_properties(data->filter, NULL, &dict);
+}
+
+/* Runs on the main loop with a copy of the summary made by the stats thread. */
+static int publish_stats(struct spa_loop *loop, bool async, uint32_t seq,
+                         const void *message, size_t size, void *user_data) {
+    struct data *data = user_data;
+    const struct stats_summary *summary = message;
+    const struct stats_phase_summary *append = &summary->phases[STATS_PHASE_APPEND];
+    const struct stats_phase_summary *convolve = &summary->phases[STATS_PHASE_CONVOLVE];
+    const struct stats_phase_summary *total = &summary->phases[STATS_PHASE_TOTAL];
+    char values[13][32];
+
+    snprintf(values[0], sizeof(values[0]), "%.1f", append->avg_us);
+    snprintf(values[1], sizeof(values[1]), "%.1f", append->p99_us);
+    snprintf(values[2], sizeof(values[2]), "%.1f", convolve->avg_us);
+    snprintf(values[3], sizeof(values[3]), "%.1f", convolve->p99_us);
+    snprintf(values[4], sizeof(values[4]), "%.1f", total->min_us);
+    snprintf(values[5], sizeof(values[5]), "%.1f", total->avg_us);
+    snprintf(values[6], sizeof(values[6]), "%.1f", total->p99_us);
+    snprintf(values[7], sizeof(values[7]), "%.1f", total->max_us);
+    snprintf(values[8], sizeof(values[8]), "%.1f", summary->load_avg);
+    snprintf(values[9], sizeof(values[9]), "%.1f", summary->load_p99);
+    snprintf(values[10], sizeof(values[10]), "%.1f", summary->load_max);
+    snprintf(values[11], sizeof(values[11]), "%llu", (unsigned long long) summary->total_xruns);
+    snprintf(values[12], sizeof(values[12]), "%llu", (unsigned long long) summary->total_dropped);
 
-        fir_filter_apply(channel->current, channel->delay_line,
-                         n_samples, output_buffers[ch]);
+    const struct spa_dict_item items[] = {
+        SPA_DICT_ITEM_INIT("fir.stats.append.avg-us", values[0]),
+        SPA_DICT_ITEM_INIT("fir.stats.append.p99-us", values[1]),
+        SPA_DICT_ITEM_INIT("fir.stats.convolve.avg-us", values[2]),
+        SPA_DICT_ITEM_INIT("fir.stats.convolve.p99-us", values[3]),
+        SPA_DICT_ITEM_INIT("fir.stats.total.min-us", values[4]),
+        SPA_DICT_ITEM_INIT("fir.stats.total.avg-us", values[5]),
+        SPA_DICT_ITEM_INIT("fir.stats.total.p99-us", values[6]),
+        SPA_DICT_ITEM_INIT("fir.stats.total.max-us", values[7]),
+        SPA_DICT_ITEM_INIT("fir.stats.load.avg", values[8]),
+        SPA_DICT_ITEM_INIT("fir.stats.load.p99", values[9]),
+        SPA_DICT_ITEM_INIT("fir.stats.load.max", values[10]),
+        SPA_DICT_ITEM_INIT("fir.stats.xruns", values[11]),
+        SPA_DICT_ITEM_INIT("fir.stats.dropped", values[12]),
+    };
+    const struct spa_dict dict = SPA_DICT_INIT_ARRAY(items);
+
+    pw_filter_update_properties(data->filter, NULL, &dict);
+    govern_load(data, summary);
+    return 0;
+}
+
+/* Called on the stats thread, which must not touch the filter itself. */
+static void on_stats_report(void *userdata, const struct stats_summary *summary) {
+    struct data *data = userdata;
+
+    pw_loop_invoke(pw_main_loop_get_loop(data->loop), publish_stats, 0,
+                   summary, sizeof(*summary), false, data);
+}
+
+static int init_stats(struct data *data, const struct options *options) {
+    if (options->stats_interval <= 0) {
+        return 0;
+    }
+
+    snprintf(data->stats_shm_name, sizeof(data->stats_shm_name), "%s%d", STATS_SHM_PREFIX, (int) getpid());
+    data->stats = stats_init(data->stats_shm_name, options->stats_interval, on_stats_report, data);
+    if (!data->stats) {
+        return -1;
     }
+
+    const struct spa_dict_item items[] = {
+        SPA_DICT_ITEM_INIT("fir.stats.shm", data->stats_shm_name),
+    };
+    const struct spa_dict dict = SPA_DICT_INIT_ARRAY(items);
+    pw_filter_update_properties(data->filter, NULL, &dict);
+
+    printf("Publishing DSP statistics every %d ms in /dev/shm%s\n", options->stats_interval,
+           data->stats_shm_name);
+    return 0;
 }
 
 static void on_filter_state_changed(void *userdata, enum pw_filter_state old,
@@ -212,9 +1337,40 @@ static void on_filter_state_changed(void *userdata, enum pw_filter_state old,
     }
 }
 
+/* Set with: pw-cli set-param <node> Props '{ params = [ "fir.profile" "<file or builtin>" ] }' */
+static void on_props_changed(struct data *data, const struct spa_pod *param) {
+    const struct spa_pod *params = NULL;
+    struct spa_pod_parser parser;
+    struct spa_pod_frame frame;
+
+    if (spa_pod_parse_object(param, SPA_TYPE_OBJECT_Props, NULL,
+                             SPA_PROP_params, SPA_POD_OPT_Pod(&params)) < 0 || !params) {
+        return;
+    }
+
+    spa_pod_parser_pod(&parser, params);
+    if (spa_pod_parser_push_struct(&parser, &frame) < 0) {
+        return;
+    }
+
+    const char *key;
+    struct spa_pod *value;
+    while (spa_pod_parser_get_string(&parser, &key) >= 0 && spa_pod_parser_get_pod(&parser, &value) >= 0) {
+        const char *path;
+        if (strcmp(key, PROFILE_PARAM) == 0 && spa_pod_get_string(value, &path) >= 0) {
+            load_profile(data, strcmp(path, BUILTIN_PROFILE) == 0 ? NULL : path,
+                         &data->governor.tiers[data->governor.level]);
+        }
+    }
+}
+
 static void on_filter_param_changed(void *userdata, void *user_data, uint32_t id, const struct spa_pod *param) {
     struct data *data = userdata;
 
+    if (param != NULL && id == SPA_PARAM_Props) {
+        on_props_changed(data, param);
+        return;
+    }
     if (param == NULL || id != SPA_PARAM_Format)
         return;
 
@@ -226,8 +1382,13 @@ static void on_filter_param_changed(void *userdata, void *user_data, uint32_t id
     if (spa_format_audio_raw_parse(param, &info.info.raw) < 0)
         return;
 
-    int rate = info.info.raw.rate;
-    select_filter_for_rate(data, rate);
+    /* The switch itself happens on the data thread at the start of the next cycle. */
+    atomic_store(&data->format_rate, (int) info.info.raw.rate);
+    derive_filter(data, data->latest, (int) info.info.raw.rate);
+
+    /* Lines for the new filter are usually ready before the data thread switches to it. */
+    resize_delay_lines(data, slot_history(profile_slot(data->latest, (int) info.info.raw.rate)),
+                       data->delay_span);
 }
 
 static const struct pw_filter_events filter_events = {
@@ -238,7 +1399,7 @@ static const struct pw_filter_events filter_events = {
 };
 
 static int create_channel_ports(struct data *data, int channel_idx) {
-    const struct channel_config *config = &channel_configs[channel_idx];
+    const struct channel_config *config = &data->channel_configs[channel_idx];
     struct channel *channel = &data->channels[channel_idx];
 
     channel->in_port = pw_filter_add_port(data->filter,
@@ -271,21 +1432,395 @@ static int create_channel_ports(struct data *data, int channel_idx) {
     return 0;
 }
 
+static int init_channel_configs(struct data *data, const char *positions) {
+    data->channel_configs = calloc(data->num_channels, sizeof(struct channel_config));
+    data->channels = calloc(data->num_channels, sizeof(struct channel));
+    if (!data->channel_configs || !data->channels) {
+        fprintf(stderr, "Failed to allocate memory for channels\n");
+        return -1;
+    }
+
+    char *list = positions ? strdup(positions) : NULL;
+    char *save = NULL;
+    char *token = list ? strtok_r(list, ",", &save) : NULL;
+
+    for (int ch = 0; ch < data->num_channels; ch++) {
+        struct channel_config *config = &data->channel_configs[ch];
+        const int num_defaults = sizeof(default_positions) / sizeof(default_positions[0]);
+
+        if (token) {
+            snprintf(config->channel_name, MAX_NAME_LENGTH, "%s", token);
+            token = strtok_r(NULL, ",", &save);
+        } else if (ch < num_defaults) {
+            snprintf(config->channel_name, MAX_NAME_LENGTH, "%s", default_positions[ch]);
+        } else {
+            snprintf(config->channel_name, MAX_NAME_LENGTH, "AUX%d", ch - num_defaults);
+        }
+
+        snprintf(config->input_name, MAX_NAME_LENGTH, "input_%s", config->channel_name);
+        snprintf(config->output_name, MAX_NAME_LENGTH, "output_%s", config->channel_name);
+    }
+
+    free(list);
+    return 0;
+}
+
+/* Everything built from here on is locked; with no lock limit, so is the rest of the process. */
+static void init_realtime_memory(void) {
+    struct rlimit limit;
+
+    fir_memory_set_realtime(1);
+
+    /* Locking future mappings makes them fail once past a limit, so only do it without one. */
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            fprintf(stderr, "Failed to lock process memory: %s\n", strerror(errno));
+        }
+    } else {
+        printf("RLIMIT_MEMLOCK is limited, locking only the filter buffers\n");
+    }
+}
+
+static void init_data_thread(struct data *data, const struct options *options) {
+    CPU_ZERO(&data->data_cpus);
+    for (int i = 0; i < options->num_data_cpus; i++) {
+        CPU_SET(options->data_cpus[i], &data->data_cpus);
+    }
+    data->realtime_memory = options->realtime_memory;
+    data->setup_data_thread = data->realtime_memory || options->num_data_cpus > 0;
+}
+
+static int init_worker_pool(struct data *data, const struct options *options) {
+    const int num_tasks = (data->num_channels + CHANNELS_PER_TASK - 1) / CHANNELS_PER_TASK;
+    int num_workers = options->num_workers;
+    int cpus[MAX_CHANNELS];
+    int num_cpus = 0;
+
+    cpu_set_t online;
+    if (sched_getaffinity(0, sizeof(online), &online) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE && num_cpus < MAX_CHANNELS; cpu++) {
+            if (CPU_ISSET(cpu, &online)) {
+                cpus[num_cpus++] = cpu;
+            }
+        }
+    }
+
+    if (num_workers < 0) {
+        num_workers = num_cpus - 1;
+        if (num_workers > num_tasks - 1) {
+            num_workers = num_tasks - 1;
+        }
+    }
+    if (num_workers <= 0) {
+        return 0;
+    }
+
+    /* Leave the first allowed CPU to the PipeWire data thread unless told otherwise. */
+    const int *worker_cpus = options->num_worker_cpus > 0 ? options->worker_cpus : cpus + 1;
+    const int num_worker_cpus = options->num_worker_cpus > 0 ? options->num_worker_cpus : num_cpus - 1;
+
+    data->pool = worker_pool_init(num_workers, num_worker_cpus > 0 ? worker_cpus : NULL,
+                                  num_worker_cpus, options->worker_priority);
+    if (!data->pool) {
+        fprintf(stderr, "Failed to start worker pool\n");
+        return -1;
+    }
+
+    printf("Worker pool started with %d threads\n", worker_pool_size(data->pool));
+    return 0;
+}
+
+static void print_usage(const char *name) {
+    printf("Usage: %s [options]\n"
+           "  -c, --channels N          number of channels (default %d, max %d)\n"
+           "  -p, --positions LIST      comma separated channel positions (e.g. FL,FR,FC,LFE)\n"
+           "  -w, --workers N           worker threads for channel processing (default: auto)\n"
+           "      --worker-cpus LIST    comma separated CPUs to pin workers to\n"
+           "      --worker-priority N   SCHED_FIFO priority of the workers, 0 to disable (default %d)\n"
+           "      --data-cpus LIST      comma separated CPUs to pin the PipeWire data thread to\n"
+           "      --rt-memory           pre-fault and lock filter memory, on huge pages where possible\n"
+           "  -k, --kernel NAME         FIR kernel to use instead of the detected one\n"
+           "  -q, --quantum N           quantum to tune the engines for (default %d)\n"
+           "      --retune              ignore the cached tuning profile\n"
+           "      --no-tune             skip tuning and use the built-in cost model\n"
+           "      --stats-interval MS   publish DSP load statistics every MS ms (default %d)\n"
+           "      --no-stats            disable DSP load statistics\n"
+           "      --coefficients FILE   load filters from a coefficient file (see fir_export); a running\n"
+           "                            node switches files through its \"" PROFILE_PARAM "\" Props param\n"
+           "      --quality TIER        full, high, medium, low, minimal, or linear|minimum[/DIVISOR]\n"
+           "                            for shorter filters on slow hosts (default full)\n"
+           "      --precision NAME      fp32, fp16 or bf16 storage for direct-form coefficients\n"
+           "                            (default fp32)\n"
+           "      --multirate LIST      comma separated rates, or \"all\", to filter below half of a\n"
+           "                            lower rate they are a multiple of, at that rate\n"
+           "      --governor            step down through multirate and cheaper quality tiers while\n"
+           "                            the DSP load is high, and back up once it settles\n"
+           "      --pipelined           compute the long filter tails on helper threads ahead of time,\n"
+           "                            for small quanta (at the worker priority, which must be above\n"
+           "                            0 and granted)\n"
+           "      --shared-dir DIR      share the built-in coefficients and the FFT spectra with other\n"
+           "                            instances through files in DIR, e.g. /dev/shm/fir_filter\n"
+           "  -h, --help                show this help\n",
+           name, DEFAULT_CHANNELS, MAX_CHANNELS, DEFAULT_WORKER_PRIORITY, DEFAULT_QUANTUM,
+           DEFAULT_STATS_INTERVAL_MS);
+}
+
+static int parse_cpu_list(const char *arg, int *cpus, int *num_cpus) {
+    char *end = NULL;
+
+    *num_cpus = 0;
+    while (*arg) {
+        const long cpu = strtol(arg, &end, 10);
+        if (end == arg || cpu < 0 || cpu >= CPU_SETSIZE || *num_cpus >= MAX_CHANNELS) {
+            return -1;
+        }
+        cpus[(*num_cpus)++] = (int) cpu;
+        arg = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            return -1;
+        }
+    }
+
+    return *num_cpus > 0 ? 0 : -1;
+}
+
+static int parse_rate_list(const char *arg, struct options *options) {
+    char *end = NULL;
+
+    options->num_multirate_rates = 0;
+    options->multirate_all = strcmp(arg, "all") == 0;
+    if (options->multirate_all) {
+        return 0;
+    }
+
+    while (*arg) {
+        const long rate = strtol(arg, &end, 10);
+        if (end == arg || rate <= 0 || rate > INT32_MAX || options->num_multirate_rates >= MAX_FILTERS) {
+            return -1;
+        }
+        options->multirate_rates[options->num_multirate_rates++] = (int) rate;
+        arg = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            return -1;
+        }
+    }
+
+    return options->num_multirate_rates > 0 ? 0 : -1;
+}
+
+static int parse_options(int argc, char *argv[], struct options *options) {
+    enum { OPT_WORKER_CPUS = 256, OPT_WORKER_PRIORITY, OPT_DATA_CPUS, OPT_RT_MEMORY, OPT_RETUNE, OPT_NO_TUNE,
+           OPT_STATS_INTERVAL, OPT_NO_STATS, OPT_COEFFICIENTS, OPT_QUALITY,
+           OPT_PRECISION, OPT_MULTIRATE, OPT_PIPELINED,
+           OPT_GOVERNOR, OPT_SHARED_DIR };
+    static const struct option long_options[] = {
+        {"channels", required_argument, NULL, 'c'},
+        {"positions", required_argument, NULL, 'p'},
+        {"workers", required_argument, NULL, 'w'},
+        {"worker-cpus", required_argument, NULL, OPT_WORKER_CPUS},
+        {"worker-priority", required_argument, NULL, OPT_WORKER_PRIORITY},
+        {"data-cpus", required_argument, NULL, OPT_DATA_CPUS},
+        {"rt-memory", no_argument, NULL, OPT_RT_MEMORY},
+        {"kernel", required_argument, NULL, 'k'},
+        {"quantum", required_argument, NULL, 'q'},
+        {"retune", no_argument, NULL, OPT_RETUNE},
+        {"no-tune", no_argument, NULL, OPT_NO_TUNE},
+        {"stats-interval", required_argument, NULL, OPT_STATS_INTERVAL},
+        {"no-stats", no_argument, NULL, OPT_NO_STATS},
+        {"coefficients", required_argument, NULL, OPT_COEFFICIENTS},
+        {"quality", required_argument, NULL, OPT_QUALITY},
+        {"precision", required_argument, NULL, OPT_PRECISION},
+        {"multirate", required_argument, NULL, OPT_MULTIRATE},
+        {"pipelined", no_argument, NULL, OPT_PIPELINED},
+        {"governor", no_argument, NULL, OPT_GOVERNOR},
+        {"shared-dir", required_argument, NULL, OPT_SHARED_DIR},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    options->num_channels = DEFAULT_CHANNELS;
+    options->positions = NULL;
+    options->num_workers = -1;
+    options->num_worker_cpus = 0;
+    options->num_data_cpus = 0;
+    options->realtime_memory = 0;
+    options->worker_priority = DEFAULT_WORKER_PRIORITY;
+    options->kernel = NULL;
+    options->quantum = DEFAULT_QUANTUM;
+    options->tune = 1;
+    options->retune = 0;
+    options->stats_interval = DEFAULT_STATS_INTERVAL_MS;
+    options->coefficients = NULL;
+    options->quality = (struct fir_quality) {FIR_PHASE_LINEAR, 1};
+    options->precision = FIR_PRECISION_FP32;
+    options->num_multirate_rates = 0;
+    options->multirate_all = 0;
+    options->pipelined = 0;
+    options->governor = 0;
+    options->shared_dir = NULL;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "c:p:w:k:q:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'c':
+                options->num_channels = atoi(optarg);
+                if (options->num_channels < 1 || options->num_channels > MAX_CHANNELS) {
+                    fprintf(stderr, "Invalid channel count: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'p':
+                options->positions = optarg;
+                break;
+            case 'w':
+                options->num_workers = atoi(optarg);
+                if (options->num_workers < 0 || options->num_workers > MAX_CHANNELS) {
+                    fprintf(stderr, "Invalid worker count: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_WORKER_CPUS:
+                if (parse_cpu_list(optarg, options->worker_cpus, &options->num_worker_cpus) != 0) {
+                    fprintf(stderr, "Invalid CPU list: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_WORKER_PRIORITY:
+                options->worker_priority = atoi(optarg);
+                break;
+            case OPT_DATA_CPUS:
+                if (parse_cpu_list(optarg, options->data_cpus, &options->num_data_cpus) != 0) {
+                    fprintf(stderr, "Invalid CPU list: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_RT_MEMORY:
+                options->realtime_memory = 1;
+                break;
+            case 'k':
+                options->kernel = optarg;
+                break;
+            case 'q':
+                options->quantum = atoi(optarg);
+                if (options->quantum < 1 || options->quantum > MAX_QUANTUM) {
+                    fprintf(stderr, "Invalid quantum: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_RETUNE:
+                options->retune = 1;
+                break;
+            case OPT_NO_TUNE:
+                options->tune = 0;
+                break;
+            case OPT_STATS_INTERVAL:
+                options->stats_interval = atoi(optarg);
+                if (options->stats_interval < 1) {
+                    fprintf(stderr, "Invalid stats interval: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_NO_STATS:
+                options->stats_interval = 0;
+                break;
+            case OPT_COEFFICIENTS:
+                options->coefficients = optarg;
+                break;
+            case OPT_QUALITY:
+                if (fir_quality_from_name(optarg, &options->quality) != 0) {
+                    fprintf(stderr, "Invalid quality tier: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_PRECISION:
+                if (fir_precision_from_name(optarg, &options->precision) != 0) {
+                    fprintf(stderr, "Invalid coefficient precision: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_MULTIRATE:
+                if (parse_rate_list(optarg, options) != 0) {
+                    fprintf(stderr, "Invalid rate list: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPT_PIPELINED:
+                options->pipelined = 1;
+                break;
+            case OPT_GOVERNOR:
+                options->governor = 1;
+                break;
+            case OPT_SHARED_DIR:
+                options->shared_dir = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    /* The data thread covers for a helper that falls behind, so one without RT priority
+     * would only move the spikes back into the callback. */
+    if (options->pipelined && options->worker_priority <= 0) {
+        fprintf(stderr, "--pipelined needs a real-time helper; set --worker-priority above 0\n");
+        return -1;
+    }
+
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     struct data data = {0};
+    struct options options;
 
     pw_init(&argc, &argv);
 
+    if (parse_options(argc, argv, &options) != 0) {
+        return -1;
+    }
+
+    if (options.kernel && fir_kernel_select(options.kernel) != 0) {
+        fprintf(stderr, "Available kernels:");
+        for (int i = 0; i < fir_kernel_count(); i++) {
+            fprintf(stderr, " %s", fir_kernel_name_at(i));
+        }
+        fprintf(stderr, "\n");
+        return -1;
+    }
+
+    if (options.realtime_memory) {
+        init_realtime_memory();
+    }
+    if (options.shared_dir && fir_share_set_dir(options.shared_dir) != 0) {
+        return -1;
+    }
+    init_data_thread(&data, &options);
+    convolver_set_pipeline_priority(options.worker_priority);
+    init_governor(&data, &options);
+
+    data.num_channels = options.num_channels;
+    if (init_channel_configs(&data, options.positions) != 0) {
+        return -1;
+    }
+
     data.loop = pw_main_loop_new(NULL);
 
     pw_loop_add_signal(pw_main_loop_get_loop(data.loop), SIGINT, do_quit, &data);
     pw_loop_add_signal(pw_main_loop_get_loop(data.loop), SIGTERM, do_quit, &data);
 
-    if (init_fir_filters(&data) != 0) {
+    if (init_fir_filters(&data, &options) != 0) {
         fprintf(stderr, "Failed to load FIR coefficients\n");
         return -1;
     }
 
+    if (init_worker_pool(&data, &options) != 0) {
+        cleanup_fir_filters(&data);
+        return -1;
+    }
+
     data.filter = pw_filter_new_simple(
         pw_main_loop_get_loop(data.loop),
         "JRX215 Comp Filter",
@@ -294,21 +1829,29 @@ int main(int argc, char *argv[]) {
             PW_KEY_MEDIA_CATEGORY, "Filter",
             PW_KEY_MEDIA_ROLE, "DSP",
             PW_KEY_NODE_DESCRIPTION, "FIR JRX215 Compensation Filter",
+            "fir.quality", data.profile->quality_name,
+            "fir.precision", fir_precision_name(options.precision),
+            PROFILE_PARAM, data.profile->name,
             NULL),
         &filter_events,
         &data);
 
-    for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+    for (int ch = 0; ch < data.num_channels; ch++) {
         if (create_channel_ports(&data, ch) != 0) {
             fprintf(stderr, "Failed to create ports for channel %d\n", ch);
             pw_filter_destroy(data.filter);
             pw_main_loop_destroy(data.loop);
+            worker_pool_free(data.pool);
             cleanup_fir_filters(&data);
             pw_deinit();
             return -1;
         }
     }
 
+    if (init_stats(&data, &options) != 0) {
+        fprintf(stderr, "Continuing without DSP statistics\n");
+    }
+
     if (pw_filter_connect(data.filter,
                           PW_FILTER_FLAG_RT_PROCESS,
                           NULL, 0) < 0) {
@@ -321,9 +1864,13 @@ int main(int argc, char *argv[]) {
 
     pw_main_loop_run(data.loop);
 
+    stats_free(data.stats);
     pw_filter_destroy(data.filter);
     pw_main_loop_destroy(data.loop);
+    worker_pool_free(data.pool);
     cleanup_fir_filters(&data);
+    free(data.channels);
+    free(data.channel_configs);
     pw_deinit();
 
     return 0;
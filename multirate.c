@@ -0,0 +1,451 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "multirate.h"
+#include "convolver.h"
+#include "fir_quality.h"
+#include "fir_resample.h"
+
+#define MULTIRATE_CHUNK 1024
+#define PASSBAND_EDGE 0.46
+#define STOPBAND_EDGE 0.54
+#define STOPBAND_ATTENUATION_DB 80.0
+
+/*
+ * Phase q of the input holds the samples at times m * factor - q, so the decimated sample m
+ * is the sum of one short filter per phase, each run at the base rate by the FIR kernels.
+ */
+struct multirate_channel {
+    struct delay_line *phases[MULTIRATE_MAX_FACTOR];
+    struct delay_line *decimated;
+    struct delay_line *correction;
+    float *gathered[MULTIRATE_MAX_FACTOR];
+    float *filtered;
+    float *scratch;
+    float *partial;
+    unsigned long long position;
+    int idle;
+};
+
+struct multirate {
+    const struct fir_filter *base;
+    struct convolver *conv;
+    int factor;
+    float gain;
+    int base_delay;
+    int latency;
+
+    struct fir_filter *decimators[MULTIRATE_MAX_FACTOR];
+    struct fir_filter *interpolators[MULTIRATE_MAX_FACTOR];
+    int phase_taps;
+
+    struct multirate_channel *channels;
+    int num_channels;
+};
+
+const struct fir_filter *multirate_find_base(const struct fir_bank *bank, int rate) {
+    const struct fir_filter *base = NULL;
+
+    for (int i = 0; i < bank->num_filters; i++) {
+        const struct fir_filter *filter = &bank->filters[i];
+        const int factor = filter->rate > 0 && rate % filter->rate == 0 ? rate / filter->rate : 0;
+
+        if (factor >= 2 && factor <= MULTIRATE_MAX_FACTOR && (!base || filter->rate < base->rate)) {
+            base = filter;
+        }
+    }
+
+    return base;
+}
+
+/* Amplitude at hz with the delay removed, signed so a phase flip at the crossover is kept. */
+static double amplitude_at(const struct fir_filter *filter, int delay, double hz) {
+    const double omega = 2.0 * M_PI * hz / filter->rate;
+    double sum = 0.0;
+
+    /* Coefficients run from the oldest sample, so tap k is the response at order - 1 - k. */
+    for (int k = 0; k < filter->order; k++) {
+        sum += filter->coeffs[k] * cos(omega * (filter->order - 1 - k - delay));
+    }
+    return sum;
+}
+
+/*
+ * Kaiser-windowed lowpass at the full rate, flat to PASSBAND_EDGE of the base rate. It only
+ * stops at STOPBAND_EDGE: what aliases lands above the passband, and the correction path
+ * scales it by the small difference between the base filter and the high-band gain there.
+ */
+static int design_lowpass(struct multirate *mr, int rate) {
+    const double base_rate = (double) rate / mr->factor;
+    const double transition = (STOPBAND_EDGE - PASSBAND_EDGE) * base_rate / rate;
+    const double cutoff = (PASSBAND_EDGE + STOPBAND_EDGE) / 2.0 * base_rate / rate;
+    const double beta = 0.1102 * (STOPBAND_ATTENUATION_DB - 8.7);
+    const int taps = (int) ceil((STOPBAND_ATTENUATION_DB - 8.0) / (2.285 * 2.0 * M_PI * transition)) | 1;
+    const double center = (taps - 1) / 2.0;
+    const double window_norm = fir_kaiser_window(0.0, beta);
+    const int factor = mr->factor;
+
+    mr->phase_taps = (taps + factor - 1) / factor;
+
+    double *impulse = calloc((size_t) mr->phase_taps * factor, sizeof(double));
+    float *taps_d = calloc(mr->phase_taps, sizeof(float));
+    float *taps_i = calloc(mr->phase_taps, sizeof(float));
+    int ret = -1;
+
+    if (!impulse || !taps_d || !taps_i) {
+        goto out;
+    }
+
+    double sum = 0.0;
+    for (int k = 0; k < taps; k++) {
+        const double x = k - center;
+        const double arg = 2.0 * M_PI * cutoff * x;
+        const double sinc = fabs(arg) < 1e-12 ? 1.0 : sin(arg) / arg;
+
+        impulse[k] = sinc * fir_kaiser_window(x / center, beta) / window_norm;
+        sum += impulse[k];
+    }
+
+    /* Tap j of phase p is impulse[p + j * factor]; coefficients run from the oldest sample. The
+     * interpolator is scaled by factor to make up for the zeros it stuffs in. */
+    for (int p = 0; p < factor; p++) {
+        for (int j = 0; j < mr->phase_taps; j++) {
+            const double value = impulse[p + j * factor] / sum;
+
+            taps_d[mr->phase_taps - 1 - j] = (float) value;
+            taps_i[mr->phase_taps - 1 - j] = (float) (factor * value);
+        }
+
+        const struct fir_filter decimator = {.rate = mr->base->rate, .coeffs = taps_d, .order = mr->phase_taps};
+        const struct fir_filter interpolator = {.rate = mr->base->rate, .coeffs = taps_i, .order = mr->phase_taps};
+
+        mr->decimators[p] = fir_filter_clone(&decimator);
+        mr->interpolators[p] = fir_filter_clone(&interpolator);
+        if (!mr->decimators[p] || !mr->interpolators[p]) {
+            goto out;
+        }
+    }
+
+    /* Both lowpasses, then the base filter and the one sample its convolver lags by. */
+    mr->latency = taps - 1 + factor * (1 + mr->base_delay);
+    ret = 0;
+
+out:
+    free(impulse);
+    free(taps_d);
+    free(taps_i);
+    return ret;
+}
+
+static void clear_line(struct delay_line *line) {
+    memset(line->buffer, 0, sizeof(float) * (line->mapped ? line->size : line->size * 2));
+}
+
+/* A window onto line whose newest sample is the one behind samples before its real newest. */
+static struct delay_line window_ending(const struct delay_line *line, int behind) {
+    struct delay_line window = *line;
+
+    /* fir_filter_apply leaves out the newest sample, so the window ends one past it. */
+    window.index = line->index + 1 - behind;
+    return window;
+}
+
+static int init_channel(struct multirate *mr, struct multirate_channel *channel) {
+    const int base_chunk = MULTIRATE_CHUNK / mr->factor + 1;
+
+    channel->decimated = delay_line_init((size_t) (mr->base->order + 1 + base_chunk) * 2);
+    channel->correction = delay_line_init((size_t) (mr->phase_taps + base_chunk) * 2);
+    channel->filtered = fir_memory_alloc(sizeof(float) * base_chunk);
+    channel->scratch = fir_memory_alloc(sizeof(float) * base_chunk);
+    channel->partial = fir_memory_alloc(sizeof(float) * base_chunk);
+    if (!channel->decimated || !channel->correction || !channel->filtered || !channel->scratch ||
+        !channel->partial) {
+        return -1;
+    }
+
+    for (int q = 0; q < mr->factor; q++) {
+        channel->phases[q] = delay_line_init((size_t) (mr->phase_taps + 1 + base_chunk) * 2);
+        channel->gathered[q] = fir_memory_alloc(sizeof(float) * base_chunk);
+        if (!channel->phases[q] || !channel->gathered[q]) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+struct multirate *multirate_init(const struct fir_filter *base, int rate, int block_size, int num_channels) {
+    if (!base || base->rate <= 0 || rate % base->rate != 0 || rate / base->rate < 2 ||
+        rate / base->rate > MULTIRATE_MAX_FACTOR || block_size <= 0 || num_channels <= 0 ||
+        num_channels > CONVOLVER_MAX_CHANNELS) {
+        fprintf(stderr, "Invalid multirate parameters\n");
+        return NULL;
+    }
+
+    struct multirate *mr = calloc(1, sizeof(struct multirate));
+    if (!mr) {
+        fprintf(stderr, "Failed to allocate memory for multirate filter\n");
+        return NULL;
+    }
+
+    mr->base = base;
+    mr->factor = rate / base->rate;
+    mr->base_delay = base->symmetric ? (base->order - 1) / 2 : fir_filter_peak(base);
+    mr->gain = (float) amplitude_at(base, mr->base_delay, PASSBAND_EDGE * base->rate);
+
+    if (design_lowpass(mr, rate) != 0) {
+        fprintf(stderr, "Failed to allocate memory for multirate lowpass\n");
+        multirate_free(mr);
+        return NULL;
+    }
+
+    const int base_block = block_size / mr->factor > 0 ? block_size / mr->factor : 1;
+    mr->conv = convolver_init(base, base_block, num_channels);
+    mr->channels = calloc(num_channels, sizeof(struct multirate_channel));
+    if (!mr->conv || !mr->channels) {
+        fprintf(stderr, "Failed to initialize multirate filter\n");
+        multirate_free(mr);
+        return NULL;
+    }
+    mr->num_channels = num_channels;
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        if (init_channel(mr, &mr->channels[ch]) != 0) {
+            fprintf(stderr, "Failed to allocate memory for multirate channel\n");
+            multirate_free(mr);
+            return NULL;
+        }
+    }
+
+    return mr;
+}
+
+void multirate_free(struct multirate *mr) {
+    if (!mr) {
+        return;
+    }
+
+    if (mr->channels) {
+        for (int ch = 0; ch < mr->num_channels; ch++) {
+            struct multirate_channel *channel = &mr->channels[ch];
+
+            for (int q = 0; q < mr->factor; q++) {
+                delay_line_free(channel->phases[q]);
+                free(channel->gathered[q]);
+            }
+            delay_line_free(channel->decimated);
+            delay_line_free(channel->correction);
+            free(channel->filtered);
+            free(channel->scratch);
+            free(channel->partial);
+        }
+        free(mr->channels);
+    }
+    for (int p = 0; p < mr->factor; p++) {
+        fir_filter_free(mr->decimators[p]);
+        fir_filter_free(mr->interpolators[p]);
+    }
+    convolver_free(mr->conv);
+    free(mr);
+}
+
+/* Index of the last base-rate sample at or before time t; t may be one before the start. */
+static long long base_index(long long t, int factor) {
+    return t >= 0 ? t / factor : -((-t + factor - 1) / factor);
+}
+
+/* Splits input[start, start + count) into its phases and appends the base-rate samples due. */
+static int decimate(const struct multirate *mr, struct multirate_channel *channel, const float *input,
+                    int start, int count) {
+    const int factor = mr->factor;
+    const long long first = (long long) (channel->position + start);
+    const long long last = first + count - 1;
+    int gathered[MULTIRATE_MAX_FACTOR] = {0};
+
+    int q = (int) ((factor - first % factor) % factor);
+    for (int i = 0; i < count; i++) {
+        channel->gathered[q][gathered[q]++] = input[start + i];
+        q = q > 0 ? q - 1 : factor - 1;
+    }
+    for (int q = 0; q < factor; q++) {
+        delay_line_append_samples(channel->phases[q], channel->gathered[q], gathered[q]);
+    }
+
+    /* Samples m * factor falling in this chunk; phase q may already hold the next one. */
+    const long long newest = base_index(last, factor);
+    const int produced = (int) (newest - base_index(first - 1, factor));
+    if (produced <= 0) {
+        return 0;
+    }
+
+    for (int q = 0; q < factor; q++) {
+        const struct delay_line window = window_ending(channel->phases[q],
+                                                       (int) (base_index(last + q, factor) - newest));
+        float *output = q == 0 ? channel->scratch : channel->partial;
+
+        fir_filter_apply(mr->decimators[q], &window, produced, output);
+        if (q > 0) {
+            for (int j = 0; j < produced; j++) {
+                channel->scratch[j] += channel->partial[j];
+            }
+        }
+    }
+
+    delay_line_append_samples(channel->decimated, channel->scratch, produced);
+    return produced;
+}
+
+/* The base filter minus the gain passed at full rate, so only the difference gets interpolated. */
+static void correct(const struct multirate *mr, struct multirate_channel *channel, int produced) {
+    const struct delay_line *line = channel->decimated;
+    const float *delayed = line->buffer + line->index - produced - 1 - mr->base_delay;
+
+    for (int j = 0; j < produced; j++) {
+        channel->scratch[j] = channel->filtered[j] - mr->gain * delayed[j];
+    }
+    delay_line_append_samples(channel->correction, channel->scratch, produced);
+}
+
+static void interpolate(const struct multirate *mr, struct multirate_channel *channel, const float *input,
+                        int start, int count, float *output) {
+    const int factor = mr->factor;
+    const long long first = (long long) (channel->position + start);
+    const long long newest = base_index(first + count - 1, factor);
+
+    for (int p = 0; p < factor; p++) {
+        /* Outputs at m * factor + p in this chunk use the correction up to and including m. */
+        const long long low = base_index(first - p - 1, factor) + 1;
+        const long long high = base_index(first + count - 1 - p, factor);
+        const int n = (int) (high - low + 1);
+        if (n <= 0) {
+            continue;
+        }
+
+        const struct delay_line window = window_ending(channel->correction, (int) (newest - high));
+        fir_filter_apply(mr->interpolators[p], &window, n, channel->partial);
+
+        float *out = output + start + (low * factor + p - first);
+        for (int j = 0; j < n; j++) {
+            out[j * factor] = channel->partial[j];
+        }
+    }
+
+    for (int i = start; i < start + count; i++) {
+        output[i] += mr->gain * input[i - mr->latency];
+    }
+}
+
+void multirate_apply_channels(struct multirate *mr, int first_channel, int num_channels,
+                              const struct delay_line *const *delay_lines, int count,
+                              float *const *outputs) {
+    if (!mr || !delay_lines || !outputs || count <= 0 || first_channel < 0 || num_channels <= 0 ||
+        first_channel + num_channels > mr->num_channels) {
+        return;
+    }
+
+    struct multirate_channel *channels = mr->channels + first_channel;
+    const struct delay_line *base_lines[CONVOLVER_MAX_CHANNELS];
+    float *filtered[CONVOLVER_MAX_CHANNELS];
+    const float *inputs[CONVOLVER_MAX_CHANNELS];
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        channels[ch].idle = 0;
+        base_lines[ch] = channels[ch].decimated;
+        filtered[ch] = channels[ch].filtered;
+        inputs[ch] = delay_lines[ch]->buffer + delay_lines[ch]->index - count;
+    }
+
+    for (int start = 0; start < count; start += MULTIRATE_CHUNK) {
+        const int chunk = count - start < MULTIRATE_CHUNK ? count - start : MULTIRATE_CHUNK;
+        int produced = 0;
+
+        for (int ch = 0; ch < num_channels; ch++) {
+            produced = decimate(mr, &channels[ch], inputs[ch], start, chunk);
+        }
+
+        if (produced > 0) {
+            convolver_apply_channels(mr->conv, first_channel, num_channels, base_lines, produced, filtered);
+            for (int ch = 0; ch < num_channels; ch++) {
+                correct(mr, &channels[ch], produced);
+            }
+        }
+
+        for (int ch = 0; ch < num_channels; ch++) {
+            interpolate(mr, &channels[ch], inputs[ch], start, chunk, outputs[ch]);
+        }
+    }
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        channels[ch].position += count;
+    }
+}
+
+void multirate_apply(struct multirate *mr, const struct delay_line *const *delay_lines, int count,
+                     float *const *outputs) {
+    if (mr) {
+        multirate_apply_channels(mr, 0, mr->num_channels, delay_lines, count, outputs);
+    }
+}
+
+void multirate_skip_channels(struct multirate *mr, int first_channel, int num_channels, int count) {
+    if (!mr || count <= 0 || first_channel < 0 || num_channels <= 0 ||
+        first_channel + num_channels > mr->num_channels) {
+        return;
+    }
+
+    /* Every channel in a group shares the phase, so the base-rate samples skipped are the same. */
+    const long long first = (long long) mr->channels[first_channel].position;
+    const int produced = (int) (base_index(first + count - 1, mr->factor) - base_index(first - 1, mr->factor));
+
+    for (int ch = first_channel; ch < first_channel + num_channels; ch++) {
+        struct multirate_channel *channel = &mr->channels[ch];
+
+        if (!channel->idle) {
+            for (int q = 0; q < mr->factor; q++) {
+                clear_line(channel->phases[q]);
+            }
+            clear_line(channel->decimated);
+            clear_line(channel->correction);
+            channel->idle = 1;
+        }
+        channel->position += count;
+    }
+    convolver_skip_channels(mr->conv, first_channel, num_channels, produced);
+}
+
+void multirate_reset(struct multirate *mr) {
+    if (!mr) {
+        return;
+    }
+
+    convolver_reset(mr->conv);
+    for (int ch = 0; ch < mr->num_channels; ch++) {
+        struct multirate_channel *channel = &mr->channels[ch];
+
+        for (int q = 0; q < mr->factor; q++) {
+            clear_line(channel->phases[q]);
+        }
+        clear_line(channel->decimated);
+        clear_line(channel->correction);
+        channel->position = 0;
+    }
+}
+
+int multirate_factor(const struct multirate *mr) {
+    return mr->factor;
+}
+
+int multirate_history(const struct multirate *mr) {
+    return mr->latency;
+}
+
+/* The decimator, the base filter and the interpolator each reach back by their length. */
+int multirate_memory(const struct multirate *mr) {
+    return mr->factor * (2 * mr->phase_taps + mr->base->order + 3);
+}
+
+int multirate_latency(const struct multirate *mr) {
+    return mr->latency;
+}
@@ -0,0 +1,46 @@
+#ifndef MULTIRATE_H
+#define MULTIRATE_H
+
+#include "fir.h"
+
+#define MULTIRATE_MAX_FACTOR 8
+
+struct multirate;
+
+/* The lowest-rate filter of bank whose rate divides rate by 2 to MULTIRATE_MAX_FACTOR, or NULL. */
+const struct fir_filter *multirate_find_base(const struct fir_bank *bank, int rate);
+
+/*
+ * Filters at rate by splitting the band at half of base->rate: the low band is decimated, run
+ * through base with its own convolver and interpolated back, the high band passes with the gain
+ * base has at the top of its band. rate must be a multiple of base->rate.
+ */
+struct multirate *multirate_init(const struct fir_filter *base, int rate, int block_size, int num_channels);
+
+void multirate_free(struct multirate *mr);
+
+/* Same contract as convolver_apply_channels; the delay lines need count + multirate_history() samples. */
+void multirate_apply_channels(struct multirate *mr, int first_channel, int num_channels,
+                              const struct delay_line *const *delay_lines, int count,
+                              float *const *outputs);
+
+void multirate_apply(struct multirate *mr, const struct delay_line *const *delay_lines, int count,
+                     float *const *outputs);
+
+/* Same contract as convolver_skip_channels, with the lines silent over multirate_memory(). */
+void multirate_skip_channels(struct multirate *mr, int first_channel, int num_channels, int count);
+
+void multirate_reset(struct multirate *mr);
+
+int multirate_factor(const struct multirate *mr);
+
+/* Input samples read behind the newest one. */
+int multirate_history(const struct multirate *mr);
+
+/* Full-rate samples an input keeps reaching the output for, through the internal state. */
+int multirate_memory(const struct multirate *mr);
+
+/* Delay from input to output in samples at the full rate. */
+int multirate_latency(const struct multirate *mr);
+
+#endif
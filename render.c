@@ -0,0 +1,427 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <limits.h>
+#include <libgen.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fir.h"
+#include "convolver.h"
+#include "worker_pool.h"
+#include "fir_resample.h"
+#include "fir_quality.h"
+#include "wav.h"
+
+#define RENDER_BLOCK_SIZE 8192
+
+struct render_options {
+    const char *output_dir;
+    const char *kernel;
+    enum wav_sample_format format;
+    int keep_format;
+    int align;
+    int jobs;
+    const char *coefficients;
+    struct fir_quality quality;
+};
+
+struct render_context {
+    const struct render_options *options;
+    const struct fir_bank *bank;
+    char **inputs;
+    int num_inputs;
+    int *status;
+    double *seconds;
+};
+
+struct render_buffers {
+    struct delay_line **delay_lines;
+    float **inputs;
+    float **outputs;
+    const float **segments;
+    int num_channels;
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const struct fir_filter *find_filter(const struct fir_bank *bank, int rate) {
+    for (int i = 0; i < bank->num_filters; i++) {
+        if (bank->filters[i].rate == rate) {
+            return &bank->filters[i];
+        }
+    }
+    return NULL;
+}
+
+static void free_buffers(struct render_buffers *buffers) {
+    for (int ch = 0; ch < buffers->num_channels; ch++) {
+        if (buffers->delay_lines) {
+            delay_line_free(buffers->delay_lines[ch]);
+        }
+        if (buffers->inputs) {
+            free(buffers->inputs[ch]);
+        }
+        if (buffers->outputs) {
+            free(buffers->outputs[ch]);
+        }
+    }
+    free(buffers->delay_lines);
+    free(buffers->inputs);
+    free(buffers->outputs);
+    free(buffers->segments);
+}
+
+static int init_buffers(struct render_buffers *buffers, int num_channels, int order) {
+    buffers->num_channels = num_channels;
+    buffers->delay_lines = calloc(num_channels, sizeof(struct delay_line *));
+    buffers->inputs = calloc(num_channels, sizeof(float *));
+    buffers->outputs = calloc(num_channels, sizeof(float *));
+    buffers->segments = calloc(num_channels, sizeof(float *));
+
+    if (!buffers->delay_lines || !buffers->inputs || !buffers->outputs || !buffers->segments) {
+        return -1;
+    }
+
+    for (int ch = 0; ch < num_channels; ch++) {
+        buffers->delay_lines[ch] = delay_line_init((size_t) (order + RENDER_BLOCK_SIZE) * 2);
+        buffers->inputs[ch] = calloc(RENDER_BLOCK_SIZE, sizeof(float));
+        buffers->outputs[ch] = calloc(RENDER_BLOCK_SIZE, sizeof(float));
+        if (!buffers->delay_lines[ch] || !buffers->inputs[ch] || !buffers->outputs[ch]) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Streams the file through the engine in RENDER_BLOCK_SIZE blocks. The tail is
+ * padded with silence so every block takes the same path through the
+ * convolver. With align, the filter's delay (the centre of a symmetric filter,
+ * the largest tap otherwise) plus the one sample lag of the delay line is
+ * dropped from the start and made up with silence at the end.
+ */
+static int render_stream(struct wav_file *in, struct wav_file *out, const struct fir_filter *filter,
+                         int align) {
+    const int num_channels = in->channels;
+    struct render_buffers buffers = {0};
+    struct convolver *conv = NULL;
+    int ret = -1;
+
+    if (init_buffers(&buffers, num_channels, filter->order) != 0) {
+        fprintf(stderr, "Failed to allocate memory for render buffers\n");
+        goto out;
+    }
+
+    conv = convolver_init(filter, RENDER_BLOCK_SIZE, num_channels);
+    if (!conv) {
+        goto out;
+    }
+
+    const struct delay_line *const *lines = (const struct delay_line *const *) buffers.delay_lines;
+    const long delay = filter->symmetric ? (filter->order - 1) / 2 : fir_filter_peak(filter);
+    long skip = align ? 1 + delay : 0;
+    uint64_t remaining = in->frames;
+
+    while (remaining > 0) {
+        const long got = wav_read(in, buffers.inputs, RENDER_BLOCK_SIZE);
+        if (got < 0) {
+            fprintf(stderr, "Failed to read input\n");
+            goto out;
+        }
+
+        for (int ch = 0; ch < num_channels; ch++) {
+            memset(buffers.inputs[ch] + got, 0, sizeof(float) * (RENDER_BLOCK_SIZE - got));
+            delay_line_append_samples(buffers.delay_lines[ch], buffers.inputs[ch], RENDER_BLOCK_SIZE);
+        }
+        convolver_apply(conv, lines, RENDER_BLOCK_SIZE, buffers.outputs);
+
+        const long start = skip < RENDER_BLOCK_SIZE ? skip : RENDER_BLOCK_SIZE;
+        long frames = RENDER_BLOCK_SIZE - start;
+        skip -= start;
+
+        if ((uint64_t) frames > remaining) {
+            frames = (long) remaining;
+        }
+        if (frames == 0) {
+            continue;
+        }
+
+        for (int ch = 0; ch < num_channels; ch++) {
+            buffers.segments[ch] = buffers.outputs[ch] + start;
+        }
+        if (wav_write(out, buffers.segments, frames) != 0) {
+            fprintf(stderr, "Failed to write output\n");
+            goto out;
+        }
+        remaining -= frames;
+    }
+
+    ret = 0;
+
+out:
+    convolver_free(conv);
+    free_buffers(&buffers);
+    return ret;
+}
+
+static int render_file(const struct render_context *ctx, const char *input) {
+    const struct render_options *options = ctx->options;
+    char *name = strdup(input);
+    char *output = NULL;
+    int ret = -1;
+
+    if (!name || asprintf(&output, "%s/%s", options->output_dir, basename(name)) < 0) {
+        fprintf(stderr, "Failed to allocate memory for output path\n");
+        free(name);
+        return -1;
+    }
+
+    char *input_path = realpath(input, NULL);
+    char *output_path = realpath(output, NULL);
+    const int same = input_path && output_path && strcmp(input_path, output_path) == 0;
+    free(input_path);
+    free(output_path);
+
+    if (same) {
+        fprintf(stderr, "%s: refusing to overwrite the input\n", input);
+        goto out;
+    }
+
+    struct wav_file *in = wav_open_read(input);
+    if (!in) {
+        goto out;
+    }
+
+    const struct fir_filter *filter = find_filter(ctx->bank, in->rate);
+    struct fir_filter *derived = NULL;
+    if (!filter) {
+        const struct fir_filter *source = fir_bank_nearest(ctx->bank, in->rate);
+
+        derived = fir_filter_resample(source, in->rate, INT_MAX);
+        if (!derived) {
+            wav_close(in);
+            goto out;
+        }
+        printf("%s: derived a %d-tap filter for %d Hz from the %d Hz filter\n", input, derived->order,
+               in->rate, source->rate);
+        filter = derived;
+    }
+
+    const enum wav_sample_format format = options->keep_format ? in->format : options->format;
+    struct wav_file *out = wav_open_write(output, in->rate, in->channels, format);
+    if (!out) {
+        fir_filter_free(derived);
+        wav_close(in);
+        goto out;
+    }
+
+    ret = render_stream(in, out, filter, options->align);
+    fir_filter_free(derived);
+
+    if (wav_close(out) != 0) {
+        fprintf(stderr, "Failed to finish %s\n", output);
+        ret = -1;
+    }
+    if (ret != 0) {
+        remove(output);
+    }
+    wav_close(in);
+
+out:
+    free(output);
+    free(name);
+    return ret;
+}
+
+static void render_task(void *userdata, int task) {
+    struct render_context *ctx = userdata;
+    const char *input = ctx->inputs[task];
+    const double start = now_seconds();
+
+    ctx->status[task] = render_file(ctx, input);
+    ctx->seconds[task] = now_seconds() - start;
+}
+
+static int media_seconds(const char *path, double *seconds) {
+    struct wav_file *wav = wav_open_read(path);
+    if (!wav) {
+        return -1;
+    }
+    *seconds = (double) wav->frames / wav->rate;
+    wav_close(wav);
+    return 0;
+}
+
+static void print_usage(const char *name) {
+    printf("Usage: %s [options] -o DIR FILE...\n"
+           "  -o, --output DIR      directory for the rendered files\n"
+           "  -f, --format FORMAT   u8, s16, s24, s32, f32 or f64 (default: f32, \"input\" keeps it)\n"
+           "  -a, --align           remove the filter delay so output lines up with the input\n"
+           "  -j, --jobs N          files rendered in parallel (default: online CPUs)\n"
+           "  -k, --kernel NAME     FIR kernel to use instead of the detected one\n"
+           "      --coefficients FILE  load filters from a coefficient file\n"
+           "      --quality TIER        render with a reduced filter, as fir_filter --quality\n"
+           "  -h, --help            show this help\n",
+           name);
+}
+
+static int parse_options(int argc, char **argv, struct render_options *options) {
+    enum { OPT_COEFFICIENTS = 256, OPT_QUALITY };
+    static const struct option long_options[] = {
+        {"output", required_argument, NULL, 'o'},
+        {"format", required_argument, NULL, 'f'},
+        {"align", no_argument, NULL, 'a'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"kernel", required_argument, NULL, 'k'},
+        {"coefficients", required_argument, NULL, OPT_COEFFICIENTS},
+        {"quality", required_argument, NULL, OPT_QUALITY},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    memset(options, 0, sizeof(*options));
+    options->format = WAV_FORMAT_F32;
+    options->jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    options->quality = (struct fir_quality) {FIR_PHASE_LINEAR, 1};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:f:aj:k:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'o':
+                options->output_dir = optarg;
+                break;
+            case 'f':
+                if (strcmp(optarg, "input") == 0) {
+                    options->keep_format = 1;
+                } else if (wav_format_from_name(optarg, &options->format) != 0) {
+                    fprintf(stderr, "Unknown sample format: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'a':
+                options->align = 1;
+                break;
+            case 'j':
+                options->jobs = atoi(optarg);
+                if (options->jobs < 1) {
+                    fprintf(stderr, "Invalid job count: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'k':
+                options->kernel = optarg;
+                break;
+            case OPT_COEFFICIENTS:
+                options->coefficients = optarg;
+                break;
+            case OPT_QUALITY:
+                if (fir_quality_from_name(optarg, &options->quality) != 0) {
+                    fprintf(stderr, "Invalid quality tier: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (!options->output_dir || optind >= argc) {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->jobs < 1) {
+        options->jobs = 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    struct render_options options;
+
+    if (parse_options(argc, argv, &options) != 0) {
+        return 1;
+    }
+
+    if (options.kernel && fir_kernel_select(options.kernel) != 0) {
+        fprintf(stderr, "Unknown or unsupported kernel: %s\n", options.kernel);
+        return 1;
+    }
+
+    struct render_context ctx = {
+        .options = &options,
+        .inputs = argv + optind,
+        .num_inputs = argc - optind,
+    };
+
+    if (ctx.num_inputs > WORKER_POOL_MAX_TASKS) {
+        fprintf(stderr, "Too many input files\n");
+        return 1;
+    }
+
+    struct fir_bank *bank = fir_bank_load(options.coefficients);
+    if (bank && (options.quality.phase != FIR_PHASE_LINEAR || options.quality.divisor != 1)) {
+        struct fir_bank *reduced = fir_bank_reduce(bank, &options.quality);
+        fir_bank_free(bank);
+        bank = reduced;
+    }
+    ctx.bank = bank;
+    ctx.status = calloc(ctx.num_inputs, sizeof(int));
+    ctx.seconds = calloc(ctx.num_inputs, sizeof(double));
+
+    const int workers = options.jobs < ctx.num_inputs ? options.jobs - 1 : ctx.num_inputs - 1;
+    struct worker_pool *pool = worker_pool_init(workers, NULL, 0, 0);
+
+    if (!bank || !ctx.status || !ctx.seconds || !pool) {
+        fprintf(stderr, "Failed to initialize renderer\n");
+        worker_pool_free(pool);
+        fir_bank_free(bank);
+        free(ctx.status);
+        free(ctx.seconds);
+        return 1;
+    }
+
+    printf("Rendering %d file(s) with %d job(s) (kernel: %s)\n", ctx.num_inputs, workers + 1,
+           fir_kernel_name());
+    fflush(stdout);
+
+    const double start = now_seconds();
+    worker_pool_run(pool, render_task, &ctx, ctx.num_inputs);
+    const double elapsed = now_seconds() - start;
+
+    double audio = 0.0;
+    int failed = 0;
+
+    for (int i = 0; i < ctx.num_inputs; i++) {
+        double seconds;
+        if (ctx.status[i] != 0 || media_seconds(ctx.inputs[i], &seconds) != 0) {
+            printf("%s: failed\n", ctx.inputs[i]);
+            failed++;
+            continue;
+        }
+        printf("%s: %.1f s of audio in %.2f s (%.0fx real time)\n", ctx.inputs[i], seconds,
+               ctx.seconds[i], seconds / ctx.seconds[i]);
+        audio += seconds;
+    }
+
+    printf("Rendered %.1f s of audio in %.2f s (%.0fx real time)\n", audio, elapsed, audio / elapsed);
+
+    worker_pool_free(pool);
+    fir_bank_free(bank);
+    free(ctx.status);
+    free(ctx.seconds);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fir.h"
+
+/* Checks that files in the shared directory which do not match what was asked for are never used. */
+
+#define TEST_KEY 0x1234abcdull
+#define TEST_ORDER 1000
+#define TEST_FLOATS 4096
+#define HEADER_SIZE FIR_COEFF_ALIGNMENT
+
+static int failures;
+static int fills;
+
+static void check(int ok, const char *what) {
+    printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+    failures += !ok;
+}
+
+static int fill_pattern(void *data, void *context) {
+    float *values = data;
+
+    (void) context;
+    for (int i = 0; i < TEST_FLOATS; i++) {
+        values[i] = 0.5f * (float) i;
+    }
+    fills++;
+    return 0;
+}
+
+static int has_pattern(const float *values) {
+    for (int i = 0; values && i < TEST_FLOATS; i++) {
+        if (values[i] != 0.5f * (float) i) {
+            return 0;
+        }
+    }
+    return values != NULL;
+}
+
+/* Maps the test file and reports whether fill had to run to get the right data. */
+static int map_refilled(enum fir_precision precision, int order, int *correct) {
+    const int before = fills;
+    const float *values = fir_share_map("test", TEST_KEY, precision, order, sizeof(float) * TEST_FLOATS,
+                                        fill_pattern, NULL);
+
+    *correct = has_pattern(values);
+    fir_share_unmap(values, sizeof(float) * TEST_FLOATS);
+    return fills > before;
+}
+
+static int patch_file(const char *path, off_t offset, const void *bytes, size_t size) {
+    const int fd = open(path, O_WRONLY);
+    const int ok = fd >= 0 && pwrite(fd, bytes, size, offset) == (ssize_t) size;
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    return ok ? 0 : -1;
+}
+
+static void check_rejected(const char *path, const char *what) {
+    int correct;
+    const int refilled = map_refilled(FIR_PRECISION_FP32, TEST_ORDER, &correct);
+    char label[128];
+
+    snprintf(label, sizeof(label), "%s is rejected", what);
+    check(refilled && correct, label);
+
+    struct stat st;
+    snprintf(label, sizeof(label), "%s is replaced by a good file", what);
+    check(!map_refilled(FIR_PRECISION_FP32, TEST_ORDER, &correct) && correct && stat(path, &st) == 0 &&
+          (st.st_mode & 0777) == 0600, label);
+}
+
+static void test_shared_file(const char *dir) {
+    char path[256];
+    int correct;
+
+    snprintf(path, sizeof(path), "%s/test", dir);
+    check(map_refilled(FIR_PRECISION_FP32, TEST_ORDER, &correct) && correct, "first map fills the file");
+
+    struct stat st;
+    check(stat(path, &st) == 0 && (st.st_mode & 0777) == 0600, "shared file is created with mode 0600");
+    check(!map_refilled(FIR_PRECISION_FP32, TEST_ORDER, &correct) && correct, "second map reuses the file");
+
+    check(map_refilled(FIR_PRECISION_BF16, TEST_ORDER, &correct) && correct, "other precision is rejected");
+    check(!map_refilled(FIR_PRECISION_BF16, TEST_ORDER, &correct) && correct, "file is replaced for it");
+    check(map_refilled(FIR_PRECISION_BF16, TEST_ORDER + 1, &correct) && correct, "other order is rejected");
+    check(map_refilled(FIR_PRECISION_FP32, TEST_ORDER, &correct) && correct, "original parameters refill");
+
+    const float wrong = -1.0f;
+    check(patch_file(path, HEADER_SIZE + sizeof(float) * 100, &wrong, sizeof(wrong)) == 0, "data is corrupted");
+    check_rejected(path, "corrupted data");
+
+    check(truncate(path, HEADER_SIZE + sizeof(float) * TEST_FLOATS / 2) == 0, "file is truncated");
+    check_rejected(path, "truncated file");
+
+    check(patch_file(path, 0, "NOTSHARE", 8) == 0, "magic is overwritten");
+    check_rejected(path, "file with the wrong magic");
+
+    const uint32_t version = 1;
+    check(patch_file(path, 8, &version, sizeof(version)) == 0, "version is overwritten");
+    check_rejected(path, "file of an older version");
+}
+
+/* Finds the bank file fir_bank_share wrote in dir. */
+static int find_bank_file(const char *dir, char *path, size_t size) {
+    DIR *entries = opendir(dir);
+    struct dirent *entry;
+    int found = 0;
+
+    while (entries && !found && (entry = readdir(entries))) {
+        if (strncmp(entry->d_name, "bank-", 5) == 0) {
+            snprintf(path, size, "%s/%s", dir, entry->d_name);
+            found = 1;
+        }
+    }
+    if (entries) {
+        closedir(entries);
+    }
+    return found;
+}
+
+static int bank_matches(const struct fir_bank *bank, const struct fir_filter *filters, int num_filters) {
+    if (!bank || bank->num_filters != num_filters) {
+        return 0;
+    }
+    for (int i = 0; i < num_filters; i++) {
+        if (bank->filters[i].rate != filters[i].rate || bank->filters[i].order != filters[i].order ||
+            memcmp(bank->filters[i].coeffs, filters[i].coeffs, sizeof(float) * filters[i].order) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void test_shared_bank(const char *dir) {
+    static float symmetric[301], plain[100];
+
+    for (int i = 0; i < 301; i++) {
+        symmetric[i] = symmetric[300 - i] = 1.0f / (float) (1 + (i < 150 ? i : 300 - i));
+    }
+    for (int i = 0; i < 100; i++) {
+        plain[i] = (float) i / 100.0f;
+    }
+    const struct fir_filter filters[] = {
+        {.rate = 48000, .order = 301, .coeffs = symmetric},
+        {.rate = 96000, .order = 100, .coeffs = plain},
+    };
+
+    struct fir_bank *bank = fir_bank_share(filters, 2);
+    check(bank_matches(bank, filters, 2), "shared bank holds the filters");
+    fir_bank_free(bank);
+
+    char path[512];
+    if (!find_bank_file(dir, path, sizeof(path))) {
+        check(0, "shared bank file exists");
+        return;
+    }
+
+    /* A tap of the second filter, which starts on the second page of the image. */
+    const float wrong = 7.0f;
+    check(patch_file(path, HEADER_SIZE + 2 * 4096 + sizeof(float) * 40, &wrong, sizeof(wrong)) == 0,
+          "bank taps are corrupted");
+    bank = fir_bank_share(filters, 2);
+    check(bank_matches(bank, filters, 2), "corrupted bank file is rejected");
+    fir_bank_free(bank);
+
+    check(truncate(path, 100) == 0, "bank file is truncated");
+    bank = fir_bank_share(filters, 2);
+    check(bank_matches(bank, filters, 2), "truncated bank file is rejected");
+    fir_bank_free(bank);
+}
+
+static void remove_dir(const char *dir) {
+    DIR *entries = opendir(dir);
+    struct dirent *entry;
+    char path[512];
+
+    while (entries && (entry = readdir(entries))) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    if (entries) {
+        closedir(entries);
+    }
+    rmdir(dir);
+}
+
+int main(void) {
+    char dir[] = "/tmp/fir_share_test.XXXXXX";
+
+    if (!mkdtemp(dir) || fir_share_set_dir(dir) != 0) {
+        fprintf(stderr, "Failed to create a shared directory\n");
+        return 1;
+    }
+
+    test_shared_file(dir);
+    test_shared_bank(dir);
+
+    fir_share_set_dir(NULL);
+    remove_dir(dir);
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,285 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "stats.h"
+
+#define RING_MASK (STATS_RING_SIZE - 1)
+#define CALIBRATION_NS 20000000L
+
+_Static_assert((STATS_RING_SIZE & RING_MASK) == 0, "STATS_RING_SIZE must be a power of two");
+
+struct stats {
+    struct stats_record records[STATS_RING_SIZE];
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+    _Atomic uint64_t dropped;
+
+    double ticks_per_us;
+    int interval_ms;
+    stats_report_fn report;
+    void *userdata;
+
+    struct stats_summary summary;
+    double window[STATS_NUM_PHASES + 1][STATS_RING_SIZE];
+
+    char *shm_name;
+    struct stats_shm *shm;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+};
+
+void stats_push(struct stats *stats, const struct stats_record *record) {
+    const uint64_t head = atomic_load_explicit(&stats->head, memory_order_relaxed);
+    const uint64_t tail = atomic_load_explicit(&stats->tail, memory_order_acquire);
+
+    if (head - tail >= STATS_RING_SIZE) {
+        atomic_fetch_add_explicit(&stats->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    stats->records[head & RING_MASK] = *record;
+    atomic_store_explicit(&stats->head, head + 1, memory_order_release);
+}
+
+static double monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double calibrate_ticks_per_us(void) {
+    const struct timespec pause = {.tv_sec = 0, .tv_nsec = CALIBRATION_NS};
+    const double start_ns = monotonic_ns();
+    const uint64_t start = stats_now();
+
+    nanosleep(&pause, NULL);
+
+    const uint64_t end = stats_now();
+    const double elapsed_ns = monotonic_ns() - start_ns;
+    return (double) (end - start) / (elapsed_ns / 1e3);
+}
+
+static int compare_double(const void *a, const void *b) {
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static void summarize(double *values, size_t count, double *min, double *avg, double *p99, double *max) {
+    double sum = 0.0;
+
+    qsort(values, count, sizeof(double), compare_double);
+    for (size_t i = 0; i < count; i++) {
+        sum += values[i];
+    }
+
+    *min = values[0];
+    *max = values[count - 1];
+    *avg = sum / count;
+    *p99 = values[(size_t) ceil(0.99 * count) - 1];
+}
+
+static void collect(struct stats *stats) {
+    const uint64_t tail = atomic_load_explicit(&stats->tail, memory_order_relaxed);
+    const uint64_t head = atomic_load_explicit(&stats->head, memory_order_acquire);
+    double *loads = stats->window[STATS_NUM_PHASES];
+    struct stats_summary *summary = &stats->summary;
+    const size_t count = head - tail;
+
+    for (size_t i = 0; i < count; i++) {
+        const struct stats_record *record = &stats->records[(tail + i) & RING_MASK];
+
+        for (int phase = 0; phase < STATS_NUM_PHASES; phase++) {
+            stats->window[phase][i] = record->ticks[phase] / stats->ticks_per_us;
+        }
+
+        const double quantum_us = record->rate > 0 ? record->n_samples * 1e6 / record->rate : 0.0;
+        loads[i] = quantum_us > 0.0 ? stats->window[STATS_PHASE_TOTAL][i] / quantum_us * 100.0 : 0.0;
+
+        int bucket = (int) (loads[i] / 10.0);
+        if (bucket >= STATS_LOAD_BUCKETS - 1 || loads[i] >= 100.0) {
+            bucket = STATS_LOAD_BUCKETS - 1;
+            summary->total_xruns++;
+        }
+        summary->load_histogram[bucket]++;
+    }
+
+    atomic_store_explicit(&stats->tail, head, memory_order_release);
+
+    summary->callbacks = count;
+    summary->total_callbacks += count;
+    summary->total_dropped = atomic_load_explicit(&stats->dropped, memory_order_relaxed);
+
+    if (count == 0) {
+        memset(summary->phases, 0, sizeof(summary->phases));
+        summary->load_avg = summary->load_p99 = summary->load_max = 0.0;
+        return;
+    }
+
+    for (int phase = 0; phase < STATS_NUM_PHASES; phase++) {
+        struct stats_phase_summary *out = &summary->phases[phase];
+        summarize(stats->window[phase], count, &out->min_us, &out->avg_us, &out->p99_us, &out->max_us);
+    }
+
+    double load_min;
+    summarize(loads, count, &load_min, &summary->load_avg, &summary->load_p99, &summary->load_max);
+}
+
+static void publish(struct stats *stats) {
+    if (stats->shm) {
+        atomic_fetch_add_explicit(&stats->shm->seq, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        stats->shm->summary = stats->summary;
+        atomic_fetch_add_explicit(&stats->shm->seq, 1, memory_order_release);
+    }
+
+    if (stats->report) {
+        stats->report(stats->userdata, &stats->summary);
+    }
+}
+
+static void *collector_main(void *arg) {
+    struct stats *stats = arg;
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    pthread_mutex_lock(&stats->lock);
+
+    while (!stats->stop) {
+        deadline.tv_sec += stats->interval_ms / 1000;
+        deadline.tv_nsec += (stats->interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (!stats->stop &&
+               pthread_cond_timedwait(&stats->cond, &stats->lock, &deadline) != ETIMEDOUT) {
+        }
+        if (stats->stop) {
+            break;
+        }
+
+        pthread_mutex_unlock(&stats->lock);
+        collect(stats);
+        publish(stats);
+        pthread_mutex_lock(&stats->lock);
+    }
+
+    pthread_mutex_unlock(&stats->lock);
+    return NULL;
+}
+
+static int init_shm(struct stats *stats, const char *name) {
+    const int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create stats segment %s: %s\n", name, strerror(errno));
+        return -1;
+    }
+
+    if (ftruncate(fd, sizeof(struct stats_shm)) != 0) {
+        fprintf(stderr, "Failed to size stats segment %s: %s\n", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    void *map = mmap(NULL, sizeof(struct stats_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map stats segment %s: %s\n", name, strerror(errno));
+        shm_unlink(name);
+        return -1;
+    }
+
+    stats->shm = map;
+    stats->shm_name = strdup(name);
+    stats->shm->magic = STATS_SHM_MAGIC;
+    stats->shm->version = STATS_SHM_VERSION;
+    stats->shm->interval_ms = (uint32_t) stats->interval_ms;
+    atomic_init(&stats->shm->seq, 0);
+    return 0;
+}
+
+static void free_shm(struct stats *stats) {
+    if (stats->shm) {
+        munmap(stats->shm, sizeof(struct stats_shm));
+        stats->shm = NULL;
+    }
+    if (stats->shm_name) {
+        shm_unlink(stats->shm_name);
+        free(stats->shm_name);
+        stats->shm_name = NULL;
+    }
+}
+
+struct stats *stats_init(const char *shm_name, int interval_ms, stats_report_fn report, void *userdata) {
+    if (interval_ms <= 0) {
+        fprintf(stderr, "Invalid stats interval: %d\n", interval_ms);
+        return NULL;
+    }
+
+    struct stats *stats = calloc(1, sizeof(struct stats));
+    if (!stats) {
+        fprintf(stderr, "Failed to allocate memory for stats\n");
+        return NULL;
+    }
+
+    atomic_init(&stats->head, 0);
+    atomic_init(&stats->tail, 0);
+    atomic_init(&stats->dropped, 0);
+    stats->interval_ms = interval_ms;
+    stats->report = report;
+    stats->userdata = userdata;
+    stats->ticks_per_us = calibrate_ticks_per_us();
+
+    if (shm_name && init_shm(stats, shm_name) != 0) {
+        free(stats);
+        return NULL;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&stats->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&stats->lock, NULL);
+
+    const int err = pthread_create(&stats->thread, NULL, collector_main, stats);
+    if (err != 0) {
+        fprintf(stderr, "Failed to create stats thread: %s\n", strerror(err));
+        pthread_cond_destroy(&stats->cond);
+        pthread_mutex_destroy(&stats->lock);
+        free_shm(stats);
+        free(stats);
+        return NULL;
+    }
+
+    return stats;
+}
+
+void stats_free(struct stats *stats) {
+    if (stats) {
+        pthread_mutex_lock(&stats->lock);
+        stats->stop = 1;
+        pthread_cond_signal(&stats->cond);
+        pthread_mutex_unlock(&stats->lock);
+        pthread_join(stats->thread, NULL);
+
+        pthread_cond_destroy(&stats->cond);
+        pthread_mutex_destroy(&stats->lock);
+        free_shm(stats);
+        free(stats);
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define STATS_RING_SIZE 4096
+#define STATS_LOAD_BUCKETS 11
+#define STATS_SHM_MAGIC 0x53434653u
+#define STATS_SHM_VERSION 1
+
+enum stats_phase {
+    STATS_PHASE_APPEND,
+    STATS_PHASE_CONVOLVE,
+    STATS_PHASE_TOTAL,
+    STATS_NUM_PHASES,
+};
+
+/* Raw timestamp deltas for one process callback, in stats_now() ticks. */
+struct stats_record {
+    uint64_t ticks[STATS_NUM_PHASES];
+    uint32_t n_samples;
+    uint32_t rate;
+};
+
+struct stats_phase_summary {
+    double min_us;
+    double avg_us;
+    double p99_us;
+    double max_us;
+};
+
+/* The last reporting interval, followed by totals since start. Loads are percent of the quantum. */
+struct stats_summary {
+    uint64_t callbacks;
+    struct stats_phase_summary phases[STATS_NUM_PHASES];
+    double load_avg;
+    double load_p99;
+    double load_max;
+    uint64_t total_callbacks;
+    uint64_t total_xruns;
+    uint64_t total_dropped;
+    uint64_t load_histogram[STATS_LOAD_BUCKETS];
+};
+
+/*
+ * Layout of the shared-memory segment. The writer makes seq odd while it
+ * updates the summary; readers copy the summary and retry if seq was odd or
+ * changed in between.
+ */
+struct stats_shm {
+    uint32_t magic;
+    uint32_t version;
+    atomic_uint seq;
+    uint32_t interval_ms;
+    struct stats_summary summary;
+};
+
+typedef void (*stats_report_fn)(void *userdata, const struct stats_summary *summary);
+
+struct stats;
+
+/* TSC on x86, the virtual counter on aarch64, CLOCK_MONOTONIC elsewhere. */
+static inline uint64_t stats_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+/* Starts the collector thread; shm_name may be NULL to skip the shared-memory segment. */
+struct stats *stats_init(const char *shm_name, int interval_ms, stats_report_fn report, void *userdata);
+
+void stats_free(struct stats *stats);
+
+/* Wait-free; only one thread may push. Records are dropped and counted when the ring is full. */
+void stats_push(struct stats *stats, const struct stats_record *record);
+
+#endif
@@ -0,0 +1,417 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "wav.h"
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xfffe
+#define PLAIN_HEADER_SIZE 44
+#define EXTENSIBLE_HEADER_SIZE 68
+#define MAX_DATA_SIZE 0xffffffffULL
+
+static const unsigned char SUBFORMAT_SUFFIX[14] = {
+    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71,
+};
+
+static const struct {
+    const char *name;
+    int bits;
+    int is_float;
+} FORMATS[] = {
+    [WAV_FORMAT_U8] = {"u8", 8, 0},
+    [WAV_FORMAT_S16] = {"s16", 16, 0},
+    [WAV_FORMAT_S24] = {"s24", 24, 0},
+    [WAV_FORMAT_S32] = {"s32", 32, 0},
+    [WAV_FORMAT_F32] = {"f32", 32, 1},
+    [WAV_FORMAT_F64] = {"f64", 64, 1},
+};
+
+#define NUM_FORMATS ((int) (sizeof(FORMATS) / sizeof(FORMATS[0])))
+
+static uint16_t get_u16(const unsigned char *p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static void put_u16(unsigned char *p, uint16_t value) {
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+}
+
+static void put_u32(unsigned char *p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (value >> (8 * i)) & 0xff;
+    }
+}
+
+static int bytes_per_sample(enum wav_sample_format format) {
+    return FORMATS[format].bits / 8;
+}
+
+static int lookup_format(int tag, int bits, enum wav_sample_format *format) {
+    for (int i = 0; i < NUM_FORMATS; i++) {
+        if (FORMATS[i].bits == bits && FORMATS[i].is_float == (tag == WAVE_FORMAT_IEEE_FLOAT)) {
+            *format = (enum wav_sample_format) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int reserve_scratch(struct wav_file *wav, long frames) {
+    const size_t size = (size_t) frames * wav->block_align;
+    if (size <= wav->scratch_size) {
+        return 0;
+    }
+
+    unsigned char *scratch = realloc(wav->scratch, size);
+    if (!scratch) {
+        return -1;
+    }
+    wav->scratch = scratch;
+    wav->scratch_size = size;
+    return 0;
+}
+
+static int parse_fmt(struct wav_file *wav, const unsigned char *fmt, uint32_t size) {
+    if (size < 16) {
+        return -1;
+    }
+
+    int tag = get_u16(fmt);
+    const int bits = get_u16(fmt + 14);
+
+    if (tag == WAVE_FORMAT_EXTENSIBLE) {
+        if (size < 40 || memcmp(fmt + 26, SUBFORMAT_SUFFIX, sizeof(SUBFORMAT_SUFFIX)) != 0) {
+            return -1;
+        }
+        tag = get_u16(fmt + 24);
+    }
+
+    if ((tag != WAVE_FORMAT_PCM && tag != WAVE_FORMAT_IEEE_FLOAT) ||
+        lookup_format(tag, bits, &wav->format) != 0) {
+        return -1;
+    }
+
+    wav->channels = get_u16(fmt + 2);
+    wav->rate = (int) get_u32(fmt + 4);
+    wav->block_align = get_u16(fmt + 12);
+
+    if (wav->channels <= 0 || wav->rate <= 0 ||
+        wav->block_align != wav->channels * bytes_per_sample(wav->format)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+struct wav_file *wav_open_read(const char *path) {
+    struct wav_file *wav = calloc(1, sizeof(struct wav_file));
+    if (!wav) {
+        fprintf(stderr, "Failed to allocate memory for WAV file\n");
+        return NULL;
+    }
+
+    wav->file = fopen(path, "rb");
+    if (!wav->file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        free(wav);
+        return NULL;
+    }
+
+    unsigned char header[12];
+    int have_fmt = 0;
+
+    if (fread(header, 1, sizeof(header), wav->file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s is not a WAV file\n", path);
+        goto fail;
+    }
+
+    for (;;) {
+        unsigned char chunk[8];
+        if (fread(chunk, 1, sizeof(chunk), wav->file) != sizeof(chunk)) {
+            fprintf(stderr, "%s has no data chunk\n", path);
+            goto fail;
+        }
+
+        const uint32_t size = get_u32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            unsigned char fmt[64] = {0};
+            const uint32_t keep = size < sizeof(fmt) ? size : sizeof(fmt);
+
+            if (fread(fmt, 1, keep, wav->file) != keep || parse_fmt(wav, fmt, size) != 0) {
+                fprintf(stderr, "%s has an unsupported sample format\n", path);
+                goto fail;
+            }
+            if (fseek(wav->file, (long) (size - keep + (size & 1)), SEEK_CUR) != 0) {
+                goto fail;
+            }
+            have_fmt = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) {
+                fprintf(stderr, "%s has data before its format chunk\n", path);
+                goto fail;
+            }
+            wav->frames = size / wav->block_align;
+            return wav;
+        } else if (fseek(wav->file, (long) size + (size & 1), SEEK_CUR) != 0) {
+            goto fail;
+        }
+    }
+
+fail:
+    fclose(wav->file);
+    free(wav);
+    return NULL;
+}
+
+/* Plain PCM up to 16-bit stereo, extensible otherwise with a zero (unassigned) channel mask. */
+static int use_extensible(const struct wav_file *wav) {
+    return wav->channels > 2 || FORMATS[wav->format].bits > 16;
+}
+
+static int write_header(struct wav_file *wav) {
+    const int bits = FORMATS[wav->format].bits;
+    const int tag = FORMATS[wav->format].is_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    const int extensible = use_extensible(wav);
+    const size_t header_size = extensible ? EXTENSIBLE_HEADER_SIZE : PLAIN_HEADER_SIZE;
+    const uint64_t data_size = wav->position * wav->block_align;
+    unsigned char header[EXTENSIBLE_HEADER_SIZE] = {0};
+
+    memcpy(header, "RIFF", 4);
+    put_u32(header + 4, (uint32_t) (header_size - 8 + data_size + (data_size & 1)));
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_u32(header + 16, extensible ? 40 : 16);
+    put_u16(header + 20, extensible ? WAVE_FORMAT_EXTENSIBLE : tag);
+    put_u16(header + 22, (uint16_t) wav->channels);
+    put_u32(header + 24, (uint32_t) wav->rate);
+    put_u32(header + 28, (uint32_t) (wav->rate * wav->block_align));
+    put_u16(header + 32, (uint16_t) wav->block_align);
+    put_u16(header + 34, (uint16_t) bits);
+
+    unsigned char *data = header + 36;
+    if (extensible) {
+        put_u16(header + 36, 22);
+        put_u16(header + 38, (uint16_t) bits);
+        put_u32(header + 40, 0);
+        put_u16(header + 44, (uint16_t) tag);
+        memcpy(header + 46, SUBFORMAT_SUFFIX, sizeof(SUBFORMAT_SUFFIX));
+        data = header + 60;
+    }
+    memcpy(data, "data", 4);
+    put_u32(data + 4, (uint32_t) data_size);
+
+    return fwrite(header, 1, header_size, wav->file) == header_size ? 0 : -1;
+}
+
+struct wav_file *wav_open_write(const char *path, int rate, int channels, enum wav_sample_format format) {
+    if (rate <= 0 || channels <= 0 || channels > 0xffff || format < 0 || format >= NUM_FORMATS) {
+        fprintf(stderr, "Invalid WAV parameters\n");
+        return NULL;
+    }
+
+    struct wav_file *wav = calloc(1, sizeof(struct wav_file));
+    if (!wav) {
+        fprintf(stderr, "Failed to allocate memory for WAV file\n");
+        return NULL;
+    }
+
+    wav->file = fopen(path, "wb");
+    if (!wav->file) {
+        fprintf(stderr, "Failed to create %s\n", path);
+        free(wav);
+        return NULL;
+    }
+
+    wav->rate = rate;
+    wav->channels = channels;
+    wav->format = format;
+    wav->block_align = channels * bytes_per_sample(format);
+    wav->writing = 1;
+
+    if (write_header(wav) != 0) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        fclose(wav->file);
+        free(wav);
+        return NULL;
+    }
+
+    return wav;
+}
+
+static float decode_sample(const unsigned char *p, enum wav_sample_format format) {
+    switch (format) {
+        case WAV_FORMAT_U8:
+            return (p[0] - 128) * (1.0f / 128.0f);
+        case WAV_FORMAT_S16:
+            return (int16_t) get_u16(p) * (1.0f / 32768.0f);
+        case WAV_FORMAT_S24:
+            return (int32_t) ((uint32_t) p[0] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 24) *
+                   (1.0f / 2147483648.0f);
+        case WAV_FORMAT_S32:
+            return (int32_t) get_u32(p) * (1.0f / 2147483648.0f);
+        case WAV_FORMAT_F32: {
+            const uint32_t bits = get_u32(p);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        case WAV_FORMAT_F64: {
+            const uint64_t bits = get_u32(p) | (uint64_t) get_u32(p + 4) << 32;
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return (float) value;
+        }
+    }
+    return 0.0f;
+}
+
+static long quantize(float sample, double scale, double min, double max) {
+    const double value = sample * scale;
+    if (value <= min) {
+        return (long) min;
+    }
+    if (value >= max) {
+        return (long) max;
+    }
+    return lrint(value);
+}
+
+static void encode_sample(unsigned char *p, float sample, enum wav_sample_format format) {
+    switch (format) {
+        case WAV_FORMAT_U8:
+            p[0] = (unsigned char) (quantize(sample, 128.0, -128.0, 127.0) + 128);
+            break;
+        case WAV_FORMAT_S16:
+            put_u16(p, (uint16_t) quantize(sample, 32768.0, -32768.0, 32767.0));
+            break;
+        case WAV_FORMAT_S24: {
+            const uint32_t value = (uint32_t) quantize(sample, 8388608.0, -8388608.0, 8388607.0);
+            p[0] = value & 0xff;
+            p[1] = (value >> 8) & 0xff;
+            p[2] = (value >> 16) & 0xff;
+            break;
+        }
+        case WAV_FORMAT_S32:
+            put_u32(p, (uint32_t) quantize(sample, 2147483648.0, -2147483648.0, 2147483647.0));
+            break;
+        case WAV_FORMAT_F32: {
+            uint32_t bits;
+            memcpy(&bits, &sample, sizeof(bits));
+            put_u32(p, bits);
+            break;
+        }
+        case WAV_FORMAT_F64: {
+            const double value = sample;
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            put_u32(p, (uint32_t) bits);
+            put_u32(p + 4, (uint32_t) (bits >> 32));
+            break;
+        }
+    }
+}
+
+long wav_read(struct wav_file *wav, float *const *channels, long frames) {
+    if (wav->writing || frames < 0) {
+        return -1;
+    }
+
+    if ((uint64_t) frames > wav->frames - wav->position) {
+        frames = (long) (wav->frames - wav->position);
+    }
+    if (frames == 0) {
+        return 0;
+    }
+    if (reserve_scratch(wav, frames) != 0) {
+        return -1;
+    }
+
+    const size_t got = fread(wav->scratch, wav->block_align, (size_t) frames, wav->file);
+    const int width = bytes_per_sample(wav->format);
+
+    for (size_t i = 0; i < got; i++) {
+        const unsigned char *frame = wav->scratch + i * wav->block_align;
+        for (int ch = 0; ch < wav->channels; ch++) {
+            channels[ch][i] = decode_sample(frame + ch * width, wav->format);
+        }
+    }
+
+    wav->position += got;
+    return got > 0 || !ferror(wav->file) ? (long) got : -1;
+}
+
+int wav_write(struct wav_file *wav, const float *const *channels, long frames) {
+    if (!wav->writing || frames < 0 || (wav->position + frames) * wav->block_align > MAX_DATA_SIZE) {
+        return -1;
+    }
+    if (frames == 0) {
+        return 0;
+    }
+    if (reserve_scratch(wav, frames) != 0) {
+        return -1;
+    }
+
+    const int width = bytes_per_sample(wav->format);
+
+    for (long i = 0; i < frames; i++) {
+        unsigned char *frame = wav->scratch + i * wav->block_align;
+        for (int ch = 0; ch < wav->channels; ch++) {
+            encode_sample(frame + ch * width, channels[ch][i], wav->format);
+        }
+    }
+
+    if (fwrite(wav->scratch, wav->block_align, (size_t) frames, wav->file) != (size_t) frames) {
+        return -1;
+    }
+
+    wav->position += frames;
+    return 0;
+}
+
+int wav_close(struct wav_file *wav) {
+    if (!wav) {
+        return 0;
+    }
+
+    int ret = 0;
+
+    if (wav->writing) {
+        const uint64_t data_size = wav->position * wav->block_align;
+        if ((data_size & 1) && fputc(0, wav->file) == EOF) {
+            ret = -1;
+        }
+        if (fseek(wav->file, 0, SEEK_SET) != 0 || write_header(wav) != 0) {
+            ret = -1;
+        }
+    }
+
+    if (fclose(wav->file) != 0) {
+        ret = -1;
+    }
+
+    free(wav->scratch);
+    free(wav);
+    return ret;
+}
+
+int wav_format_from_name(const char *name, enum wav_sample_format *format) {
+    for (int i = 0; i < NUM_FORMATS; i++) {
+        if (strcmp(FORMATS[i].name, name) == 0) {
+            *format = (enum wav_sample_format) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *wav_format_name(enum wav_sample_format format) {
+    return format >= 0 && format < NUM_FORMATS ? FORMATS[format].name : "unknown";
+}
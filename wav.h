@@ -0,0 +1,47 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum wav_sample_format {
+    WAV_FORMAT_U8,
+    WAV_FORMAT_S16,
+    WAV_FORMAT_S24,
+    WAV_FORMAT_S32,
+    WAV_FORMAT_F32,
+    WAV_FORMAT_F64,
+};
+
+struct wav_file {
+    FILE *file;
+    int rate;
+    int channels;
+    enum wav_sample_format format;
+    int block_align;
+    uint64_t frames;
+    uint64_t position;
+    int writing;
+    unsigned char *scratch;
+    size_t scratch_size;
+};
+
+/* Reads 8/16/24/32-bit PCM and 32/64-bit float files, including WAVE_FORMAT_EXTENSIBLE. */
+struct wav_file *wav_open_read(const char *path);
+
+struct wav_file *wav_open_write(const char *path, int rate, int channels, enum wav_sample_format format);
+
+/* Deinterleaves up to frames frames; returns the number read, 0 at the end of data, or -1. */
+long wav_read(struct wav_file *wav, float *const *channels, long frames);
+
+/* Interleaves and converts with clipping for integer formats. */
+int wav_write(struct wav_file *wav, const float *const *channels, long frames);
+
+/* Finishes the header of a written file; returns -1 if any write failed. */
+int wav_close(struct wav_file *wav);
+
+int wav_format_from_name(const char *name, enum wav_sample_format *format);
+
+const char *wav_format_name(enum wav_sample_format format);
+
+#endif
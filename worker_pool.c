@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "worker_pool.h"
+
+/*
+ * The work word packs generation, task count and the next unclaimed task so a
+ * single CAS both claims a task and proves it belongs to the current batch.
+ */
+#define WORK_GENERATION(word) ((uint32_t) ((word) >> 32))
+#define WORK_TASKS(word) ((int) (((word) >> 16) & 0xffff))
+#define WORK_NEXT(word) ((int) ((word) & 0xffff))
+#define WORK_PACK(generation, tasks, next) \
+    (((uint64_t) (generation) << 32) | ((uint64_t) (tasks) << 16) | (uint64_t) (next))
+
+struct worker_pool {
+    pthread_t *threads;
+    int num_workers;
+    int num_started;
+    worker_task_fn fn;
+    void *userdata;
+    _Atomic uint64_t work;
+    atomic_int pending;
+    atomic_uint wake_seq;
+    atomic_int stop;
+};
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static void futex_wait(atomic_uint *addr, unsigned int expected) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake_all(atomic_uint *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static void run_tasks(struct worker_pool *pool) {
+    uint64_t word = atomic_load_explicit(&pool->work, memory_order_acquire);
+
+    for (;;) {
+        if (WORK_NEXT(word) >= WORK_TASKS(word)) {
+            return;
+        }
+        if (!atomic_compare_exchange_weak_explicit(&pool->work, &word, word + 1,
+                                                   memory_order_acq_rel, memory_order_acquire)) {
+            continue;
+        }
+
+        pool->fn(pool->userdata, WORK_NEXT(word));
+        atomic_fetch_sub_explicit(&pool->pending, 1, memory_order_release);
+        word++;
+    }
+}
+
+static void *worker_main(void *arg) {
+    struct worker_pool *pool = arg;
+    unsigned int seq = atomic_load_explicit(&pool->wake_seq, memory_order_acquire);
+
+    while (!atomic_load_explicit(&pool->stop, memory_order_acquire)) {
+        run_tasks(pool);
+        futex_wait(&pool->wake_seq, seq);
+        seq = atomic_load_explicit(&pool->wake_seq, memory_order_acquire);
+    }
+
+    return NULL;
+}
+
+void worker_pool_run(struct worker_pool *pool, worker_task_fn fn, void *userdata, int num_tasks) {
+    if (num_tasks <= 0) {
+        return;
+    }
+
+    if (pool->num_started == 0 || num_tasks == 1) {
+        for (int i = 0; i < num_tasks; i++) {
+            fn(userdata, i);
+        }
+        return;
+    }
+
+    const uint64_t previous = atomic_load_explicit(&pool->work, memory_order_relaxed);
+
+    pool->fn = fn;
+    pool->userdata = userdata;
+    atomic_store_explicit(&pool->pending, num_tasks, memory_order_relaxed);
+    atomic_store_explicit(&pool->work, WORK_PACK(WORK_GENERATION(previous) + 1, num_tasks, 0),
+                          memory_order_release);
+    atomic_fetch_add_explicit(&pool->wake_seq, 1, memory_order_release);
+    futex_wake_all(&pool->wake_seq);
+
+    run_tasks(pool);
+
+    while (atomic_load_explicit(&pool->pending, memory_order_acquire) > 0) {
+        cpu_relax();
+    }
+}
+
+int worker_pool_size(const struct worker_pool *pool) {
+    return pool ? pool->num_started : 0;
+}
+
+void worker_pool_free(struct worker_pool *pool) {
+    if (pool) {
+        atomic_store_explicit(&pool->stop, 1, memory_order_release);
+        atomic_fetch_add_explicit(&pool->wake_seq, 1, memory_order_release);
+        futex_wake_all(&pool->wake_seq);
+
+        for (int i = 0; i < pool->num_started; i++) {
+            pthread_join(pool->threads[i], NULL);
+        }
+
+        free(pool->threads);
+        free(pool);
+    }
+}
+
+static int start_worker(struct worker_pool *pool, pthread_t *thread, int cpu, int rt_priority) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+
+    if (rt_priority > 0) {
+        struct sched_param param = {.sched_priority = rt_priority};
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+    }
+
+    int err = pthread_create(thread, &attr, worker_main, pool);
+    if (err == EPERM && rt_priority > 0) {
+        fprintf(stderr, "Cannot use SCHED_FIFO for worker threads, falling back to SCHED_OTHER\n");
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        err = pthread_create(thread, &attr, worker_main, pool);
+    }
+
+    pthread_attr_destroy(&attr);
+
+    if (err != 0) {
+        fprintf(stderr, "Failed to create worker thread: %s\n", strerror(err));
+        return -1;
+    }
+
+    return 0;
+}
+
+struct worker_pool *worker_pool_init(int num_workers, const int *cpus, int num_cpus, int rt_priority) {
+    if (num_workers < 0) {
+        fprintf(stderr, "Invalid worker count: %d\n", num_workers);
+        return NULL;
+    }
+
+    struct worker_pool *pool = calloc(1, sizeof(struct worker_pool));
+    if (!pool) {
+        fprintf(stderr, "Failed to allocate memory for worker pool\n");
+        return NULL;
+    }
+
+    pool->threads = calloc(num_workers > 0 ? num_workers : 1, sizeof(pthread_t));
+    if (!pool->threads) {
+        fprintf(stderr, "Failed to allocate memory for worker threads\n");
+        free(pool);
+        return NULL;
+    }
+
+    pool->num_workers = num_workers;
+    atomic_init(&pool->work, 0);
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->wake_seq, 0);
+    atomic_init(&pool->stop, 0);
+
+    for (int i = 0; i < num_workers; i++) {
+        const int cpu = (cpus && num_cpus > 0) ? cpus[i % num_cpus] : -1;
+
+        if (start_worker(pool, &pool->threads[i], cpu, rt_priority) < 0) {
+            worker_pool_free(pool);
+            return NULL;
+        }
+        pool->num_started++;
+    }
+
+    return pool;
+}
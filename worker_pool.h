@@ -0,0 +1,20 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#define WORKER_POOL_MAX_TASKS 0xffff
+
+typedef void (*worker_task_fn)(void *userdata, int task);
+
+struct worker_pool;
+
+/* cpus may be NULL to leave the workers unpinned; rt_priority <= 0 keeps SCHED_OTHER. */
+struct worker_pool *worker_pool_init(int num_workers, const int *cpus, int num_cpus, int rt_priority);
+
+void worker_pool_free(struct worker_pool *pool);
+
+/* Runs fn for every task in [0, num_tasks) and returns once all are done; the caller helps too. */
+void worker_pool_run(struct worker_pool *pool, worker_task_fn fn, void *userdata, int num_tasks);
+
+int worker_pool_size(const struct worker_pool *pool);
+
+#endif